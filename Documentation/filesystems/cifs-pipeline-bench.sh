@@ -0,0 +1,75 @@
+#! /bin/sh
+# Sequential CIFS read and write throughput for each pipeline= setting,
+# against a Samba share with latency added by netem.
+#
+# Usage: cifs-pipeline-bench.sh //server/share [mountpoint]
+#
+# Environment:
+#   CIFS_OPTS	extra mount options, e.g. "user=bench,pass=bench"
+#   DELAY	one-way delay in ms added with netem (default 10, 0 for none)
+#   DEV		interface the delay goes on (default lo, for a local Samba)
+#   SIZE	file size in MB (default 32)
+#   PIPELINES	settings to try (default "1 2 4 8 16")
+#
+# With the server on lo the delay hits both directions, so the round trip
+# grows by twice DELAY.  For a remote server put it on the outgoing
+# interface, which only delays requests.  Needs root, tc with netem and
+# an uptime with centisecond resolution (/proc/uptime).
+
+set -e
+me=`basename $0`
+share=$1
+mnt=${2:-/mnt/cifs-bench}
+delay=${DELAY:-10}
+dev=${DEV:-lo}
+size=${SIZE:-32}
+pipelines=${PIPELINES:-"1 2 4 8 16"}
+
+test -z "$share" && {
+	echo "usage: $me //server/share [mountpoint]" 1>&2
+	exit 1
+}
+mkdir -p $mnt
+
+now() {
+	cut -d' ' -f1 /proc/uptime
+}
+
+# mbps <start> <end>
+mbps() {
+	echo $1 $2 | awk -v mb=$size '{ t = $2 - $1; if (t <= 0) t = 0.01;
+		printf "%8.2f", mb / t }'
+}
+
+cleanup() {
+	umount $mnt 2>/dev/null || true
+	test "$delay" != 0 && tc qdisc del dev $dev root 2>/dev/null || true
+}
+trap cleanup EXIT
+
+test "$delay" != 0 && tc qdisc add dev $dev root netem delay ${delay}ms
+
+printf "%s, %d MB, +%s ms on %s\n" "$share" $size $delay $dev
+printf "%8s %8s %8s\n" pipeline "write" "read"
+printf "%8s %8s %8s\n" "" "MB/s" "MB/s"
+for p in $pipelines; do
+	mount -t cifs $share $mnt -o pipeline=$p${CIFS_OPTS:+,$CIFS_OPTS}
+
+	t0=`now`
+	dd if=/dev/zero of=$mnt/cifs-bench bs=64k count=$((size * 16)) \
+		2>/dev/null
+	sync
+	t1=`now`
+
+	# read it back from the server, not from the page cache
+	umount $mnt
+	echo 3 > /proc/sys/vm/drop_caches
+	mount -t cifs $share $mnt -o pipeline=$p${CIFS_OPTS:+,$CIFS_OPTS}
+	t2=`now`
+	cat $mnt/cifs-bench > /dev/null
+	t3=`now`
+
+	rm -f $mnt/cifs-bench
+	umount $mnt
+	printf "%8s %s %s\n" $p "`mbps $t0 $t1`" "`mbps $t2 $t3`"
+done
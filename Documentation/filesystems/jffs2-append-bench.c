@@ -0,0 +1,208 @@
+/*
+ * jffs2-append-bench: small log appends on JFFS2, with and without
+ * append coalescing.
+ *
+ * Appends -n records of -r bytes to a new file in -d (on JFFS2), one
+ * write() each, -i milliseconds apart (0: back to back), with an fsync()
+ * every -f records if -f is given.  Each write() is timed.  Then the file
+ * is closed and sync()ed, and the flash space it took is read from
+ * statfs(), which counts node headers and padding as well as data.  It
+ * prints the write latency (median, 99th percentile, maximum) and the
+ * flash bytes used per record.
+ *
+ * With -c it runs twice: first with /sys/module/jffs2/parameters/
+ * append_delay_ms set to 0 (every write() its own node, as without
+ * CONFIG_JFFS2_FS_APPEND_COALESCE), then with the setting it found, which
+ * is restored afterwards.  That needs root.
+ *
+ * Each run's space is only exact if nothing else writes to the
+ * filesystem meanwhile, and garbage collection can move the numbers by
+ * an erase block; use a filesystem with plenty of free space.
+ *
+ * Compile with
+ *	gcc -O2 -Wall jffs2-append-bench.c -o jffs2-append-bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+#define DELAY_PARAM	"/sys/module/jffs2/parameters/append_delay_ms"
+
+static const char *dir = ".";		/* -d */
+static unsigned int records = 1000;	/* -n */
+static unsigned int rec_len = 40;	/* -r */
+static unsigned int interval_ms;	/* -i */
+static unsigned int fsync_every;	/* -f */
+static int compare;			/* -c */
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long free_bytes(void)
+{
+	struct statvfs st;
+
+	sync();
+	if (statvfs(dir, &st)) {
+		perror(dir);
+		exit(1);
+	}
+	return (unsigned long long)st.f_bfree * st.f_bsize;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Returns the old value, or -1 if the parameter is not there */
+static int set_delay(int ms)
+{
+	char buf[32];
+	int fd, n, old = -1;
+
+	fd = open(DELAY_PARAM, O_RDWR);
+	if (fd < 0)
+		return -1;
+	n = read(fd, buf, sizeof(buf) - 1);
+	if (n > 0) {
+		buf[n] = '\0';
+		old = atoi(buf);
+	}
+	if (ms >= 0) {
+		n = snprintf(buf, sizeof(buf), "%d\n", ms);
+		if (pwrite(fd, buf, n, 0) != n)
+			perror(DELAY_PARAM);
+	}
+	close(fd);
+	return old;
+}
+
+static void run(const char *label)
+{
+	unsigned long long before, after;
+	double *lat, t, start;
+	char name[256], *rec;
+	struct timespec ts;
+	unsigned int i;
+	int fd;
+
+	lat = calloc(records, sizeof(*lat));
+	rec = malloc(rec_len);
+	if (!lat || !rec)
+		exit(1);
+	snprintf(name, sizeof(name), "%s/append-bench.log", dir);
+	unlink(name);
+	before = free_bytes();
+
+	fd = open(name, O_WRONLY | O_CREAT | O_APPEND | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror(name);
+		exit(1);
+	}
+	start = now();
+	for (i = 0; i < records; i++) {
+		snprintf(rec, rec_len, "%08u %.3f ", i, now() - start);
+		memset(rec + strlen(rec), 'x', rec_len - strlen(rec));
+		rec[rec_len - 1] = '\n';
+		t = now();
+		if (write(fd, rec, rec_len) != rec_len) {
+			perror("write");
+			exit(1);
+		}
+		lat[i] = now() - t;
+		if (fsync_every && (i + 1) % fsync_every == 0)
+			fsync(fd);
+		if (interval_ms) {
+			ts.tv_sec = interval_ms / 1000;
+			ts.tv_nsec = (interval_ms % 1000) * 1000000;
+			nanosleep(&ts, NULL);
+		}
+	}
+	t = now() - start;
+	close(fd);
+	after = free_bytes();
+	unlink(name);
+
+	qsort(lat, records, sizeof(*lat), cmp_double);
+	printf("%-10s write us median %6.0f p99 %6.0f max %7.0f, "
+	       "%.2f s, flash %6.1f bytes/record\n", label,
+	       lat[records / 2] * 1e6, lat[records * 99 / 100] * 1e6,
+	       lat[records - 1] * 1e6, t,
+	       before > after ? (double)(before - after) / records : 0.0);
+	free(lat);
+	free(rec);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+"usage: jffs2-append-bench [-c] [-d dir] [-n records] [-r record bytes]\n"
+"                          [-i interval ms] [-f fsync every]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	char label[32];
+	int c, delay;
+
+	while ((c = getopt(argc, argv, "cd:n:r:i:f:")) != -1) {
+		switch (c) {
+		case 'c':
+			compare = 1;
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		case 'n':
+			records = atoi(optarg);
+			break;
+		case 'r':
+			rec_len = atoi(optarg);
+			break;
+		case 'i':
+			interval_ms = atoi(optarg);
+			break;
+		case 'f':
+			fsync_every = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (!records || rec_len < 24)
+		usage();
+
+	printf("%u records of %u bytes, every %u ms, fsync every %u\n",
+	       records, rec_len, interval_ms, fsync_every);
+	delay = set_delay(-1);
+	if (compare) {
+		if (delay < 0) {
+			fprintf(stderr, "no %s\n", DELAY_PARAM);
+			return 1;
+		}
+		set_delay(0);
+		run("delay 0");
+		set_delay(delay);
+	}
+	if (delay >= 0)
+		snprintf(label, sizeof(label), "delay %d", delay);
+	else
+		snprintf(label, sizeof(label), "as is");
+	run(label);
+	return 0;
+}
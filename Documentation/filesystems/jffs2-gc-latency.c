@@ -0,0 +1,242 @@
+/*
+ * jffs2-gc-latency: writer latency on a nearly full JFFS2 filesystem.
+ *
+ * Fills the directory given with -d (on JFFS2) to -p percent with
+ * incompressible files, then starts a child that keeps overwriting
+ * random pieces of them, so the filesystem runs out of free blocks and
+ * garbage collection has to run: in jffs2_gcd_mtdN and in the writers
+ * themselves.  Meanwhile the parent plays the marking process: every -i
+ * milliseconds it wakes up, writes -w bytes to a log file and times the
+ * write().  At the end it prints, in microseconds:
+ *
+ *   wakeup	how late the periodic wakeup came (CPU held by GC)
+ *   write	how long the write() took (alloc_sem held by GC)
+ *
+ * as median, 99th percentile and maximum.  Compare runs with different
+ * /sys/module/jffs2/parameters/gc_policy and gc_nice settings, and
+ * kernels with and without a GC change.  The files are removed at the
+ * end unless -k is given, so a second run can reuse them.
+ *
+ * Compile with
+ *	gcc -O2 -Wall jffs2-gc-latency.c -o jffs2-gc-latency
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/wait.h>
+
+#define FILE_SIZE	(64 << 10)
+#define MAX_FILES	4096
+#define MAX_SAMPLES	100000
+
+static const char *dir = ".";		/* -d */
+static unsigned int fill_pct = 95;	/* -p */
+static unsigned int write_len = 256;	/* -w */
+static unsigned int interval_ms = 10;	/* -i */
+static unsigned int seconds = 60;	/* -t */
+static int keep;			/* -k */
+
+static unsigned int nfiles;
+static char buf[FILE_SIZE];
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill_random(char *p, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		p[i] = rand();
+}
+
+static unsigned int used_pct(void)
+{
+	struct statvfs st;
+
+	if (statvfs(dir, &st) || !st.f_blocks)
+		return 100;
+	return 100 - st.f_bfree * 100 / st.f_blocks;
+}
+
+static void file_name(char *name, size_t len, unsigned int i)
+{
+	snprintf(name, len, "%s/gc-latency.%u", dir, i);
+}
+
+/* Fill up to fill_pct with incompressible files, reusing existing ones */
+static void fill(void)
+{
+	char name[256];
+	struct stat st;
+	int fd;
+
+	for (nfiles = 0; nfiles < MAX_FILES; nfiles++) {
+		file_name(name, sizeof(name), nfiles);
+		if (!stat(name, &st) && st.st_size == FILE_SIZE)
+			continue;
+		if (used_pct() >= fill_pct)
+			break;
+		fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			perror(name);
+			exit(1);
+		}
+		fill_random(buf, FILE_SIZE);
+		if (write(fd, buf, FILE_SIZE) != FILE_SIZE) {
+			close(fd);
+			unlink(name);
+			break;
+		}
+		close(fd);
+	}
+	if (!nfiles) {
+		fprintf(stderr, "no room for any %u kB file in %s\n",
+			FILE_SIZE >> 10, dir);
+		exit(1);
+	}
+}
+
+/* Overwrite random 4kB pieces of the files, making dirty space for GC */
+static void churn(void)
+{
+	char name[256];
+	int fd;
+
+	for (;;) {
+		file_name(name, sizeof(name), rand() % nfiles);
+		fd = open(name, O_WRONLY);
+		if (fd < 0)
+			continue;
+		fill_random(buf, 4096);
+		pwrite(fd, buf, 4096, (rand() % (FILE_SIZE / 4096)) * 4096);
+		close(fd);
+	}
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report(const char *what, double *v, unsigned int n)
+{
+	qsort(v, n, sizeof(*v), cmp_double);
+	printf("%-8s median %8.0f  p99 %8.0f  max %8.0f\n", what,
+	       v[n / 2] * 1e6, v[n * 99 / 100] * 1e6, v[n - 1] * 1e6);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+"usage: jffs2-gc-latency [-k] [-d dir] [-p fill %%] [-w write bytes]\n"
+"                        [-i interval ms] [-t seconds]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	double *wake, *wr, t, next, end;
+	unsigned int n = 0, i;
+	char name[256], *rec;
+	pid_t child;
+	int c, fd;
+
+	while ((c = getopt(argc, argv, "kd:p:w:i:t:")) != -1) {
+		switch (c) {
+		case 'k':
+			keep = 1;
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		case 'p':
+			fill_pct = atoi(optarg);
+			break;
+		case 'w':
+			write_len = atoi(optarg);
+			break;
+		case 'i':
+			interval_ms = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+
+	wake = calloc(MAX_SAMPLES, sizeof(*wake));
+	wr = calloc(MAX_SAMPLES, sizeof(*wr));
+	rec = malloc(write_len);
+	if (!wake || !wr || !rec || !write_len || !interval_ms)
+		return 1;
+	memset(rec, 'x', write_len);
+
+	fill();
+	printf("%u files of %u kB, %u%% used\n", nfiles, FILE_SIZE >> 10,
+	       used_pct());
+
+	snprintf(name, sizeof(name), "%s/gc-latency.log", dir);
+	fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror(name);
+		return 1;
+	}
+
+	child = fork();
+	if (!child)
+		churn();
+
+	next = now();
+	end = next + seconds;
+	while (next < end && n < MAX_SAMPLES) {
+		struct timespec ts;
+
+		next += interval_ms / 1e3;
+		ts.tv_sec = (time_t)next;
+		ts.tv_nsec = (next - ts.tv_sec) * 1e9;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		t = now();
+		wake[n] = t - next;
+		if (write(fd, rec, write_len) != write_len) {
+			/* full: start the log over */
+			ftruncate(fd, 0);
+			lseek(fd, 0, SEEK_SET);
+		}
+		wr[n++] = now() - t;
+	}
+
+	kill(child, SIGKILL);
+	waitpid(child, NULL, 0);
+	close(fd);
+	unlink(name);
+	if (!keep)
+		for (i = 0; i < nfiles; i++) {
+			file_name(name, sizeof(name), i);
+			unlink(name);
+		}
+
+	printf("%u writes of %u bytes every %u ms, us:\n", n, write_len,
+	       interval_ms);
+	if (n) {
+		report("wakeup", wake, n);
+		report("write", wr, n);
+	}
+	return 0;
+}
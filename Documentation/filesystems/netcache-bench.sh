@@ -0,0 +1,90 @@
+#! /bin/sh
+# Cold and warm load times of job files through netcache.
+#
+# Usage: netcache-bench.sh nfs|cifs <source> <mountpoint> <file>...
+#
+# The files are given relative to the share.  Each one is timed three
+# ways, with the page cache dropped before every read:
+#
+#   plain	mounted without fsc
+#   cold	mounted with fsc, right after the file was touched (opening
+#		it for write drops the cached copy): read from the server
+#		and stored
+#   warm	mounted again with fsc: read from the local copy
+#
+# Environment:
+#   MOUNT_OPTS	extra mount options, e.g. "user=job,pass=job" for CIFS
+#   DELAY	one-way delay in ms added with netem (default 0)
+#   DEV		interface the delay goes on (default eth0)
+#   SETTLE	seconds to let netcache finish storing (default 2)
+#
+# netcache.dir= must be set and the share writable (for the touch).
+# Needs root, and tc with netem when DELAY is set.
+
+set -e
+me=`basename $0`
+fstype=$1
+src=$2
+mnt=$3
+delay=${DELAY:-0}
+dev=${DEV:-eth0}
+settle=${SETTLE:-2}
+
+test $# -lt 4 && {
+	echo "usage: $me nfs|cifs <source> <mountpoint> <file>..." 1>&2
+	exit 1
+}
+shift 3
+
+test -z "`cat /sys/module/netcache/parameters/dir 2>/dev/null`" && {
+	echo "$me: netcache.dir is not set" 1>&2
+	exit 1
+}
+
+now() {
+	cut -d' ' -f1 /proc/uptime
+}
+
+# load <file>: prints seconds taken to read it with a cold page cache
+load() {
+	echo 3 > /proc/sys/vm/drop_caches
+	t0=`now`
+	cat "$mnt/$1" > /dev/null
+	t1=`now`
+	echo $t0 $t1 | awk '{ printf "%8.2f", $2 - $1 }'
+}
+
+mnt_with() {
+	mount -t $fstype $src $mnt -o $1${MOUNT_OPTS:+,$MOUNT_OPTS}
+}
+
+cleanup() {
+	umount $mnt 2>/dev/null || true
+	test "$delay" != 0 && tc qdisc del dev $dev root 2>/dev/null || true
+}
+trap cleanup EXIT
+
+test "$delay" != 0 && tc qdisc add dev $dev root netem delay ${delay}ms
+
+printf "%s %s, +%s ms on %s, seconds\n" $fstype $src $delay $dev
+printf "%8s %8s %8s %10s  %s\n" plain cold warm bytes file
+for f in "$@"; do
+	mnt_with ro
+	plain=`load "$f"`
+	umount $mnt
+
+	mnt_with rw,fsc
+	touch "$mnt/$f"
+	umount $mnt
+	mnt_with rw,fsc
+	cold=`load "$f"`
+	umount $mnt
+	sleep $settle
+
+	mnt_with ro,fsc
+	warm=`load "$f"`
+	bytes=`wc -c < "$mnt/$f"`
+	umount $mnt
+
+	printf "%s %s %s %10s  %s\n" "$plain" "$cold" "$warm" $bytes "$f"
+done
@@ -0,0 +1,183 @@
+/*
+ * pipe-bench: pipe throughput and context switches per pipe size.
+ *
+ * A child writes -m MB into a pipe in -b byte write()s and the parent
+ * reads it out again, with read() or, with -s, splice() to /dev/null.
+ * This is repeated for each pipe size given on the command line (set
+ * with F_SETPIPE_SZ; 0 keeps the default of 16 pages).  Both processes
+ * are bound to one CPU unless -a is given, as on the 440, so every time
+ * the pipe fills or empties the CPU switches between them.  For each
+ * size it prints the throughput and the context switches of both
+ * processes, from getrusage().
+ *
+ * Sizes above /proc/sys/fs/pipe-max-size need root.
+ *
+ * Compile with
+ *	gcc -O2 -Wall pipe-bench.c -o pipe-bench
+ *
+ * Example
+ *	./pipe-bench 0 262144 1048576
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#ifndef F_SETPIPE_SZ
+#define F_SETPIPE_SZ	1031
+#define F_GETPIPE_SZ	1032
+#endif
+
+static unsigned int mbytes = 256;	/* -m */
+static unsigned int block = 1 << 20;	/* -b */
+static int use_splice;			/* -s */
+static int any_cpu;			/* -a */
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void writer(int fd, char *buf)
+{
+	unsigned long long left = (unsigned long long)mbytes << 20;
+	ssize_t n;
+
+	while (left) {
+		n = write(fd, buf, left < block ? left : block);
+		if (n <= 0) {
+			perror("write");
+			exit(1);
+		}
+		left -= n;
+	}
+	exit(0);
+}
+
+static long switches(struct rusage *ru)
+{
+	return ru->ru_nvcsw + ru->ru_nivcsw;
+}
+
+static int run(int size, char *buf, int null)
+{
+	struct rusage self0, self1, child;
+	double t0, t;
+	long long total = 0;
+	ssize_t n;
+	int pfd[2], got;
+	pid_t pid;
+
+	if (pipe(pfd)) {
+		perror("pipe");
+		return -1;
+	}
+	if (size && fcntl(pfd[1], F_SETPIPE_SZ, size) < 0) {
+		perror("F_SETPIPE_SZ");
+		close(pfd[0]);
+		close(pfd[1]);
+		return -1;
+	}
+	got = fcntl(pfd[1], F_GETPIPE_SZ);
+
+	fflush(stdout);
+	getrusage(RUSAGE_SELF, &self0);
+	t0 = now();
+	pid = fork();
+	if (!pid) {
+		close(pfd[0]);
+		writer(pfd[1], buf);
+	}
+	close(pfd[1]);
+	for (;;) {
+		if (use_splice)
+			n = splice(pfd[0], NULL, null, NULL, block,
+				   SPLICE_F_MOVE);
+		else
+			n = read(pfd[0], buf, block);
+		if (n <= 0)
+			break;
+		total += n;
+	}
+	t = now() - t0;
+	close(pfd[0]);
+	wait4(pid, NULL, 0, &child);
+	getrusage(RUSAGE_SELF, &self1);
+
+	if (n < 0)
+		perror(use_splice ? "splice" : "read");
+	printf("%9d %9.1f %9ld %9ld %11.1f\n", got,
+	       total / t / (1 << 20),
+	       switches(&child),
+	       switches(&self1) - switches(&self0),
+	       (switches(&child) + switches(&self1) - switches(&self0)) /
+	       (total / (double)(1 << 20)));
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+"usage: pipe-bench [-s] [-a] [-m MB] [-b write size] size...\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	cpu_set_t cpus;
+	char *buf;
+	int c, null;
+
+	while ((c = getopt(argc, argv, "sam:b:")) != -1) {
+		switch (c) {
+		case 's':
+			use_splice = 1;
+			break;
+		case 'a':
+			any_cpu = 1;
+			break;
+		case 'm':
+			mbytes = atoi(optarg);
+			break;
+		case 'b':
+			block = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind == argc || !block)
+		usage();
+
+	if (!any_cpu) {
+		CPU_ZERO(&cpus);
+		CPU_SET(0, &cpus);
+		if (sched_setaffinity(0, sizeof(cpus), &cpus))
+			perror("sched_setaffinity");
+	}
+	buf = malloc(block);
+	null = open("/dev/null", O_WRONLY);
+	if (!buf || null < 0)
+		return 1;
+	memset(buf, 0x5a, block);
+
+	printf("%u MB in %u byte writes, %s, %s\n", mbytes, block,
+	       use_splice ? "splice to /dev/null" : "read",
+	       any_cpu ? "any CPU" : "one CPU");
+	printf("%9s %9s %9s %9s %11s\n", "pipe", "MB/s", "writer",
+	       "reader", "switches/MB");
+	for (; optind < argc; optind++)
+		run(atoi(argv[optind]), buf, null);
+	return 0;
+}
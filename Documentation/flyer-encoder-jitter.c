@@ -0,0 +1,192 @@
+/*
+ * flyer-encoder-jitter: encoder interrupt jitter on the Flyer with the
+ * status LED blinking and not.
+ *
+ *	flyer-encoder-jitter [-b blink hz] [-t seconds] [-r rounds]
+ *			     [-x xilinx dev] [-f debugfs file]
+ *
+ * Alternates -r times between the status LED off and blinking green at
+ * -b Hz (XIL_LED_SET_STATUS, as the marking application sets it), for
+ * -t seconds each.  Each phase clears the encoder statistics in debugfs
+ * (flyer_xil/encoder, which needs CONFIG_DEBUG_FS) and reads them back
+ * at the end.  For each phase it prints the number of encoder intervals,
+ * their minimum, mean and maximum, and from the histogram of how much
+ * each interval differs from the one before, the bucket holding the
+ * median, 99th and 99.9th percentile change.  The buckets double in
+ * width, so a percentile is only known to within a factor of two.
+ *
+ * The encoder has to be running for the whole time, at a steady rate:
+ * feed its input from a signal generator, or run a tracking job with
+ * the line at constant speed.  Other load (USB, network) should be the
+ * same in all phases.  The LED is left off afterwards.
+ *
+ *	mount -t debugfs none /sys/kernel/debug
+ *	mknod /dev/flyer_xil c 242 0
+ *
+ * Compile with
+ *	gcc -O2 -Wall -I<kernel>/include flyer-encoder-jitter.c \
+ *		-o flyer-encoder-jitter
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <asm-ppc/Flyer_Xilinx.h>
+
+#define ENC_HIST	16
+
+static unsigned int blink_hz = 10;	/* -b */
+static unsigned int seconds = 30;	/* -t */
+static unsigned int rounds = 3;		/* -r */
+static const char *xil_dev = "/dev/flyer_xil";			/* -x */
+static const char *stats = "/sys/kernel/debug/flyer_xil/encoder";	/* -f */
+
+struct enc_stats {
+	unsigned int tb_per_us;
+	unsigned long intervals;
+	unsigned long min, mean, max;	/* timebase ticks */
+	unsigned long hist[ENC_HIST];
+};
+
+static void clear_stats(void)
+{
+	int fd = open(stats, O_WRONLY);
+
+	if (fd < 0 || write(fd, "0\n", 2) != 2) {
+		perror(stats);
+		exit(1);
+	}
+	close(fd);
+}
+
+static void read_stats(struct enc_stats *e)
+{
+	char line[256];
+	FILE *f;
+	int i;
+
+	memset(e, 0, sizeof(*e));
+	f = fopen(stats, "r");
+	if (!f) {
+		perror(stats);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "timebase %u", &e->tb_per_us) == 1 ||
+		    sscanf(line, "intervals %lu", &e->intervals) == 1 ||
+		    sscanf(line, "min/mean/max %lu %lu %lu", &e->min,
+			   &e->mean, &e->max) == 3)
+			continue;
+		if (!strncmp(line, "change from", 11)) {
+			for (i = 0; i < ENC_HIST; i++)
+				if (fscanf(f, "%lu", &e->hist[i]) != 1)
+					break;
+			break;
+		}
+	}
+	fclose(f);
+	if (!e->tb_per_us)
+		e->tb_per_us = 1;
+}
+
+/* Upper end, in us, of the histogram bucket holding fraction p */
+static double hist_pct(const struct enc_stats *e, double p)
+{
+	unsigned long total = 0, sum = 0;
+	int i;
+
+	for (i = 0; i < ENC_HIST; i++)
+		total += e->hist[i];
+	if (!total)
+		return 0;
+	for (i = 0; i < ENC_HIST - 1; i++) {
+		sum += e->hist[i];
+		if (sum >= p * total)
+			break;
+	}
+	/* bucket 0 is 0 ticks, bucket i is 2^(i-1) .. 2^i - 1 */
+	return i ? ((1UL << i) - 1) / (double)e->tb_per_us : 0;
+}
+
+static void set_led(int fd, unsigned int hz)
+{
+	int state = hz ? SOLID_GREEN | ((hz << 2) & FREQ_MASK) : 0;
+
+	ioctl(fd, XIL_LED_SET_STATUS, state);
+}
+
+static void phase(int fd, unsigned int hz)
+{
+	struct enc_stats e;
+	double us;
+
+	set_led(fd, hz);
+	clear_stats();
+	sleep(seconds);
+	read_stats(&e);
+	if (!e.intervals) {
+		printf("blink %2u Hz: no encoder interrupts\n", hz);
+		return;
+	}
+	us = e.tb_per_us;
+	printf("blink %2u Hz: %8lu intervals, us min %8.2f mean %8.2f "
+	       "max %8.2f, change p50 <=%6.2f p99 <=%6.2f p99.9 <=%6.2f\n",
+	       hz, e.intervals, e.min / us, e.mean / us, e.max / us,
+	       hist_pct(&e, 0.5), hist_pct(&e, 0.99), hist_pct(&e, 0.999));
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+"usage: flyer-encoder-jitter [-b blink hz] [-t seconds] [-r rounds]\n"
+"                            [-x xilinx dev] [-f debugfs file]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int r;
+	int c, fd;
+
+	while ((c = getopt(argc, argv, "b:t:r:x:f:")) != -1) {
+		switch (c) {
+		case 'b':
+			blink_hz = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'x':
+			xil_dev = optarg;
+			break;
+		case 'f':
+			stats = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	/* the frequency field of XIL_LED_SET_STATUS is six bits */
+	if (optind != argc || !blink_hz || blink_hz > (FREQ_MASK >> 2) ||
+	    !seconds || !rounds)
+		usage();
+
+	fd = open(xil_dev, O_RDWR);
+	if (fd < 0) {
+		perror(xil_dev);
+		return 1;
+	}
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	for (r = 0; r < rounds; r++) {
+		phase(fd, 0);
+		phase(fd, blink_hz);
+	}
+	set_led(fd, 0);
+	return 0;
+}
@@ -0,0 +1,61 @@
+#! /bin/sh
+# Boot time spent in initcalls, from a dmesg taken with initcall_debug.
+#
+# Usage: initcall-times.sh [-n count] [dmesg file]...
+#
+# Boot with "initcall_debug printk.time=1" (and log_buf_len=128k or so,
+# so that the start of the boot is still in the buffer), save dmesg, and
+# again with "noasyncinit" added to run the async initcalls in line.
+# For each file this prints the count (default 10) slowest initcalls,
+# async ones marked, the time do_initcalls() took, how long the boot
+# then waited for async initcalls, and the printk timestamp at which
+# the kernel freed its init memory, i.e. just before /sbin/init.
+# Without a file it reads dmesg.
+
+count=10
+test "$1" = "-n" && { count=$2; shift 2; }
+test $# -eq 0 && set -- -
+
+for f in "$@"; do
+	test "$f" = - && name=dmesg || name=$f
+	if test "$f" = - && test -t 0; then
+		dmesg
+	else
+		cat "$f"
+	fi | awk -v name="$name" -v count=$count '
+	/initcall 0x[0-9a-f]+.* returned .* after [0-9]+ usecs/ {
+		fn = $0
+		sub(/.*: /, "", fn); sub(/ returned.*/, "", fn)
+		if ($0 ~ /async initcall/)
+			fn = fn " (async)"
+		us = $0; sub(/.* after /, "", us); sub(/ usecs.*/, "", us)
+		n++; t[n] = us + 0; f[n] = fn
+	}
+	/^(\[ *[0-9.]+\] )?initcalls took/ {
+		took = $0; sub(/.*took /, "", took); sub(/ usecs.*/, "", took)
+	}
+	/async initcalls waited for/ {
+		waited = $0; sub(/.*for /, "", waited); sub(/ usecs.*/, "", waited)
+	}
+	/Freeing unused kernel memory/ {
+		if (match($0, /^\[ *[0-9.]+\]/)) {
+			freed = substr($0, 2, RLENGTH - 2); sub(/^ */, "", freed)
+		}
+	}
+	END {
+		printf "%s: %d initcalls\n", name, n
+		for (i = 1; i <= n; i++)
+			for (j = i + 1; j <= n; j++)
+				if (t[j] > t[i]) {
+					x = t[i]; t[i] = t[j]; t[j] = x
+					x = f[i]; f[i] = f[j]; f[j] = x
+				}
+		for (i = 1; i <= n && i <= count; i++)
+			printf "%10.1f ms  %s\n", t[i] / 1000, f[i]
+		if (took != "")
+			printf "initcalls took        %10.1f ms\n", took / 1000
+		printf "waited for async ones %10.1f ms\n", waited / 1000
+		if (freed != "")
+			printf "init memory freed at  %10.1f ms\n", freed * 1000
+	}'
+done
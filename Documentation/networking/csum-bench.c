@@ -0,0 +1,264 @@
+/*
+ * csum-bench: TCP and UDP receive throughput and CPU cost per megabyte.
+ *
+ * Without hardware checksumming every received byte goes through
+ * csum_partial_copy_generic(), fused with the copy to user space when
+ * the reader is already waiting in recvmsg() (TCP prequeue, UDP), or as
+ * a separate checksum pass otherwise.  This measures how much CPU that
+ * costs.
+ *
+ * Receiver:  csum-bench -l [-u] [-i iovecs] [-b bytes] [port]
+ * Sender:    csum-bench [-u] [-b bytes] [-t seconds] host [port]
+ *
+ * The sender writes -b byte buffers (TCP, default 64 kB) or datagrams
+ * (UDP, default 1472 bytes, one Ethernet frame) for -t seconds.  The receiver reads them with readv() into a -b byte buffer
+ * split into -i iovecs of equal size, so a datagram or segment spans
+ * several of them.  Both report MB/s and the CPU time used per MB:
+ * their own (user + system, which includes the checksum and copy) and
+ * the whole machine's from /proc/stat (which adds softirq time), so run
+ * nothing else meanwhile.  A UDP receiver reports after one second
+ * without traffic.
+ *
+ * Loopback never checksums.  Run it over the EMAC against another
+ * machine, or over a veth pair with one end in another network
+ * namespace.  A veth pair computes checksums unless "ethtool -K vethX
+ * tx on" turns them off, which gives a reference without the checksum.
+ *
+ * Compile with
+ *	gcc -O2 -Wall csum-bench.c -o csum-bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+
+#define MAX_IOV		64
+
+static int udp;				/* -u */
+static unsigned int bufsize;		/* -b */
+static unsigned int niov = 1;		/* -i */
+static unsigned int seconds = 10;	/* -t */
+static const char *port = "5020";
+
+struct sample {
+	double t;		/* wall clock */
+	double cpu;		/* this process, user + system */
+	unsigned long long busy;	/* whole machine, /proc/stat ticks */
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sample(struct sample *s)
+{
+	unsigned long long v[8] = { 0 };
+	struct rusage ru;
+	FILE *f;
+	int i;
+
+	s->t = now();
+	getrusage(RUSAGE_SELF, &ru);
+	s->cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+		 ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+	s->busy = 0;
+	f = fopen("/proc/stat", "r");
+	if (!f)
+		return;
+	/* user nice system idle iowait irq softirq steal */
+	if (fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &v[0],
+		   &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) >= 4)
+		for (i = 0; i < 8; i++)
+			if (i != 3 && i != 4)
+				s->busy += v[i];
+	fclose(f);
+}
+
+/* t is the time the data took, the CPU times are from a to b */
+static void report(const char *what, unsigned long long bytes, double t,
+		   struct sample *a, struct sample *b)
+{
+	double mb = bytes / (double)(1 << 20);
+	double busy = (b->busy - a->busy) / (double)sysconf(_SC_CLK_TCK);
+
+	if (!mb || t <= 0)
+		return;
+	printf("%s %s: %.1f MB in %.2f s, %.1f MB/s, "
+	       "process %.2f ms/MB, machine %.2f ms/MB\n",
+	       udp ? "udp" : "tcp", what, mb, t, mb / t,
+	       (b->cpu - a->cpu) * 1e3 / mb, busy * 1e3 / mb);
+}
+
+static struct addrinfo *lookup(const char *host)
+{
+	struct addrinfo hints, *ai;
+	int err;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = udp ? SOCK_DGRAM : SOCK_STREAM;
+	hints.ai_flags = host ? 0 : AI_PASSIVE;
+	err = getaddrinfo(host, port, &hints, &ai);
+	if (err) {
+		fprintf(stderr, "%s: %s\n", host ? host : port,
+			gai_strerror(err));
+		exit(1);
+	}
+	return ai;
+}
+
+static void receive(int fd, char *buf)
+{
+	struct iovec iov[MAX_IOV];
+	struct sample a, b;
+	unsigned long long bytes = 0;
+	unsigned int i, step = bufsize / niov;
+	double last = 0;
+	ssize_t n;
+	int started = 0;
+
+	for (i = 0; i < niov; i++) {
+		iov[i].iov_base = buf + i * step;
+		iov[i].iov_len = i == niov - 1 ? bufsize - i * step : step;
+	}
+	for (;;) {
+		n = readv(fd, iov, niov);
+		if (n <= 0)
+			break;
+		if (!started) {
+			/* from the first data on */
+			sample(&a);
+			started = 1;
+		}
+		bytes += n;
+		last = now();
+	}
+	/* a UDP receiver gets here a second after the last datagram */
+	sample(&b);
+	if (started)
+		report("receive", bytes, last - a.t, &a, &b);
+}
+
+static void listener(void)
+{
+	struct addrinfo *ai = lookup(NULL);
+	struct timeval tv = { 1, 0 };
+	char *buf = malloc(bufsize);
+	int fd, c, one = 1;
+
+	fd = socket(ai->ai_family, ai->ai_socktype, 0);
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (fd < 0 || !buf || bind(fd, ai->ai_addr, ai->ai_addrlen)) {
+		perror("bind");
+		exit(1);
+	}
+	if (udp) {
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		for (;;)
+			receive(fd, buf);
+	}
+	listen(fd, 1);
+	for (;;) {
+		c = accept(fd, NULL, NULL);
+		if (c < 0)
+			continue;
+		receive(c, buf);
+		close(c);
+	}
+}
+
+static void sender(const char *host)
+{
+	struct addrinfo *ai = lookup(host);
+	struct sample a, b;
+	unsigned long long bytes = 0;
+	char *buf = malloc(bufsize);
+	double end;
+	ssize_t n;
+	int fd;
+
+	fd = socket(ai->ai_family, ai->ai_socktype, 0);
+	if (fd < 0 || !buf || connect(fd, ai->ai_addr, ai->ai_addrlen)) {
+		perror(host);
+		exit(1);
+	}
+	memset(buf, 0x5a, bufsize);
+	sample(&a);
+	end = a.t + seconds;
+	do {
+		n = write(fd, buf, bufsize);
+		if (n < 0 && !udp) {
+			perror("write");
+			break;
+		}
+		if (n > 0)
+			bytes += n;
+	} while (now() < end);
+	sample(&b);
+	close(fd);
+	report("send", bytes, b.t - a.t, &a, &b);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+"usage: csum-bench -l [-u] [-i iovecs] [-b bytes] [port]\n"
+"       csum-bench [-u] [-b bytes] [-t seconds] host [port]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	int c, listen_mode = 0;
+
+	while ((c = getopt(argc, argv, "lui:b:t:")) != -1) {
+		switch (c) {
+		case 'l':
+			listen_mode = 1;
+			break;
+		case 'u':
+			udp = 1;
+			break;
+		case 'i':
+			niov = atoi(optarg);
+			break;
+		case 'b':
+			bufsize = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (!bufsize)
+		bufsize = udp ? 1472 : 65536;
+	if (!niov || niov > MAX_IOV || bufsize < niov)
+		usage();
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	if (listen_mode) {
+		if (optind < argc)
+			port = argv[optind];
+		listener();
+	}
+	if (optind == argc)
+		usage();
+	if (optind + 1 < argc)
+		port = argv[optind + 1];
+	sender(argv[optind]);
+	return 0;
+}
@@ -0,0 +1,277 @@
+/*
+ * mmsg-bench: UDP packets per second and CPU per packet, one datagram
+ * per system call against recvmmsg()/sendmmsg() batches.
+ *
+ * Receiver:  mmsg-bench -l [-m batch] [port]
+ * Sender:    mmsg-bench [-m batch] [-s size] [-t seconds] host [port]
+ *
+ * With -m 1 (the default) the receiver uses recvmsg() and the sender
+ * sendmsg(); with a larger -m they move up to that many datagrams per
+ * recvmmsg(MSG_WAITFORONE) or sendmmsg() call.  The sender sends -s byte
+ * datagrams (default 64, a status packet) for -t seconds, the receiver
+ * reports a second after the last one arrived.  Both print packets per
+ * second, the average number of datagrams per call and the CPU time
+ * (user + system) per packet.  Run the sender on another machine, or
+ * pace it, when measuring the receiver: on one CPU the two compete.
+ *
+ * 32-bit powerpc reaches the calls through socketcall(), as its C
+ * library does for all socket calls, so this does not depend on the C
+ * library knowing about them.
+ *
+ * Compile with
+ *	gcc -O2 -Wall mmsg-bench.c -o mmsg-bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <netdb.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+
+#ifndef MSG_WAITFORONE
+#define MSG_WAITFORONE	0x10000
+#endif
+#define SYS_RECVMMSG	19	/* socketcall() numbers */
+#define SYS_SENDMMSG	20
+
+#define MAX_BATCH	256
+#define MAX_SIZE	65536
+
+/* struct mmsghdr, which older C libraries do not have */
+struct bench_mmsghdr {
+	struct msghdr	msg_hdr;
+	unsigned int	msg_len;
+};
+
+static unsigned int batch = 1;		/* -m */
+static unsigned int size = 64;		/* -s */
+static unsigned int seconds = 10;	/* -t */
+static const char *port = "5021";
+
+static struct bench_mmsghdr msgs[MAX_BATCH];
+static struct iovec iovs[MAX_BATCH];
+
+static int do_recvmmsg(int fd, struct bench_mmsghdr *m, unsigned int n,
+		       unsigned int flags)
+{
+#ifdef __NR_socketcall
+	unsigned long args[5] = { fd, (unsigned long)m, n, flags, 0 };
+
+	return syscall(__NR_socketcall, SYS_RECVMMSG, args);
+#else
+	return syscall(__NR_recvmmsg, fd, m, n, flags, NULL);
+#endif
+}
+
+static int do_sendmmsg(int fd, struct bench_mmsghdr *m, unsigned int n,
+		       unsigned int flags)
+{
+#ifdef __NR_socketcall
+	unsigned long args[4] = { fd, (unsigned long)m, n, flags };
+
+	return syscall(__NR_socketcall, SYS_SENDMMSG, args);
+#else
+	return syscall(__NR_sendmmsg, fd, m, n, flags);
+#endif
+}
+
+struct sample {
+	double t, cpu;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sample(struct sample *s)
+{
+	struct rusage ru;
+
+	s->t = now();
+	getrusage(RUSAGE_SELF, &ru);
+	s->cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+		 ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+static void report(const char *what, unsigned long pkts, unsigned long calls,
+		   double t, struct sample *a, struct sample *b)
+{
+	if (!pkts || t <= 0)
+		return;
+	printf("%s, batch %u: %lu packets in %.2f s, %.0f pps, "
+	       "%.1f per call, %.2f us cpu/packet\n", what, batch, pkts, t,
+	       pkts / t, (double)pkts / calls, (b->cpu - a->cpu) * 1e6 / pkts);
+}
+
+static struct addrinfo *lookup(const char *host)
+{
+	struct addrinfo hints, *ai;
+	int err;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_flags = host ? 0 : AI_PASSIVE;
+	err = getaddrinfo(host, port, &hints, &ai);
+	if (err) {
+		fprintf(stderr, "%s: %s\n", host ? host : port,
+			gai_strerror(err));
+		exit(1);
+	}
+	return ai;
+}
+
+static void setup_msgs(char *buf, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 0; i < batch; i++) {
+		iovs[i].iov_base = buf + i * len;
+		iovs[i].iov_len = len;
+		memset(&msgs[i], 0, sizeof(msgs[i]));
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+static void receiver(void)
+{
+	struct addrinfo *ai = lookup(NULL);
+	struct timeval tv = { 1, 0 };
+	struct sample a, b;
+	unsigned long pkts, calls;
+	char *buf = malloc(batch * MAX_SIZE);
+	double last;
+	int fd, n;
+
+	fd = socket(ai->ai_family, ai->ai_socktype, 0);
+	if (fd < 0 || !buf || bind(fd, ai->ai_addr, ai->ai_addrlen)) {
+		perror("bind");
+		exit(1);
+	}
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setup_msgs(buf, MAX_SIZE);
+
+	for (;;) {
+		pkts = calls = 0;
+		last = 0;
+		for (;;) {
+			if (batch == 1)
+				n = recvmsg(fd, &msgs[0].msg_hdr, 0) < 0 ? -1 : 1;
+			else
+				n = do_recvmmsg(fd, msgs, batch,
+						MSG_WAITFORONE);
+			if (n < 0) {
+				if (errno == EAGAIN || errno == EINTR)
+					break;
+				perror(batch == 1 ? "recvmsg" : "recvmmsg");
+				exit(1);
+			}
+			if (!pkts)
+				sample(&a);
+			pkts += n;
+			calls++;
+			last = now();
+		}
+		if (pkts) {
+			sample(&b);
+			report("receive", pkts, calls, last - a.t, &a, &b);
+		}
+	}
+}
+
+static void sender(const char *host)
+{
+	struct addrinfo *ai = lookup(host);
+	struct sample a, b;
+	unsigned long pkts = 0, calls = 0;
+	char *buf = malloc(batch * size);
+	double end;
+	int fd, n;
+
+	fd = socket(ai->ai_family, ai->ai_socktype, 0);
+	if (fd < 0 || !buf || connect(fd, ai->ai_addr, ai->ai_addrlen)) {
+		perror(host);
+		exit(1);
+	}
+	memset(buf, 0x5a, batch * size);
+	setup_msgs(buf, size);
+
+	sample(&a);
+	end = a.t + seconds;
+	do {
+		if (batch == 1)
+			n = sendmsg(fd, &msgs[0].msg_hdr, 0) < 0 ? -1 : 1;
+		else
+			n = do_sendmmsg(fd, msgs, batch, 0);
+		if (n < 0) {
+			/* ECONNREFUSED from an earlier datagram, go on */
+			if (errno == ECONNREFUSED || errno == ENOBUFS)
+				continue;
+			perror(batch == 1 ? "sendmsg" : "sendmmsg");
+			break;
+		}
+		pkts += n;
+		calls++;
+	} while (now() < end);
+	sample(&b);
+	report("send", pkts, calls, b.t - a.t, &a, &b);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+"usage: mmsg-bench -l [-m batch] [port]\n"
+"       mmsg-bench [-m batch] [-s size] [-t seconds] host [port]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	int c, listen_mode = 0;
+
+	while ((c = getopt(argc, argv, "lm:s:t:")) != -1) {
+		switch (c) {
+		case 'l':
+			listen_mode = 1;
+			break;
+		case 'm':
+			batch = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (!batch || batch > MAX_BATCH || !size || size > MAX_SIZE)
+		usage();
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	if (listen_mode) {
+		if (optind < argc)
+			port = argv[optind];
+		receiver();
+	}
+	if (optind == argc)
+		usage();
+	if (optind + 1 < argc)
+		port = argv[optind + 1];
+	sender(argv[optind]);
+	return 0;
+}
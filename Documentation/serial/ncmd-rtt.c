@@ -0,0 +1,316 @@
+/*
+ * ncmd-rtt: command round-trip time over a serial line, through the
+ * normal tty path and through N_CMD with a low-latency port.
+ *
+ * Responder: ncmd-rtt -r [-m tty|cmd] [-l] [-n report every] [-b baud] tty
+ * Initiator: ncmd-rtt [-n count] [-s bytes] [-i interval ms] [-b baud] tty
+ *
+ * Run the responder on the Flyer and the initiator on a PC connected to
+ * it by a null-modem cable (or both on one machine, across two ports).
+ * The initiator sends -n commands of -s bytes, each ending in CR, and
+ * waits for each to be echoed back before sending the next.  It prints
+ * the round-trip time (median, 99th percentile, maximum) and the part of
+ * it the characters themselves take on the wire, ten bits per byte each
+ * way.  A command that is not answered within a second counts as lost.
+ *
+ * The responder reads commands and writes each back with its CR.  With
+ * -m tty (the default) it reads the port in raw mode through N_TTY, as
+ * the marker's command handler does today; with -m cmd it switches the
+ * port to N_CMD and reads one command per read().  -l sets the port's
+ * low_latency flag (setserial's low_latency, which on an 8250 also drops
+ * the RX FIFO trigger to one byte); without -l the flag is cleared, so
+ * "-m tty" alone is the current path.  With -m cmd the responder also
+ * prints, every -n commands, the time from the arrival of each command's
+ * CR (CMDIOCGSTAMP) to the return of its read().
+ *
+ * Compile with
+ *	gcc -O2 -Wall ncmd-rtt.c -o ncmd-rtt
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+#ifndef N_CMD
+#define N_CMD		18
+#endif
+#define CMDIOCGSTAMP	_IOR(0xB2, 0, struct timespec)
+
+#define MAX_CMD		256
+
+static unsigned int count = 1000;	/* -n */
+static unsigned int cmd_len = 16;	/* -s, CR included */
+static unsigned int interval_ms;	/* -i */
+static unsigned int baud = 115200;	/* -b */
+static int use_ncmd;			/* -m cmd */
+static int low_latency;			/* -l */
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report(const char *what, double *v, unsigned int n)
+{
+	if (!n)
+		return;
+	qsort(v, n, sizeof(*v), cmp_double);
+	printf("%s us median %7.0f p99 %7.0f max %7.0f (%u)\n", what,
+	       v[n / 2] * 1e6, v[n * 99 / 100] * 1e6, v[n - 1] * 1e6, n);
+}
+
+static speed_t speed(unsigned int b)
+{
+	switch (b) {
+	case 9600:	return B9600;
+	case 19200:	return B19200;
+	case 38400:	return B38400;
+	case 57600:	return B57600;
+	case 115200:	return B115200;
+	case 230400:	return B230400;
+	}
+	fprintf(stderr, "unsupported baud rate %u\n", b);
+	exit(2);
+}
+
+static int open_tty(const char *name)
+{
+	struct serial_struct ss;
+	struct termios t;
+	int fd;
+
+	fd = open(name, O_RDWR | O_NOCTTY);
+	if (fd < 0 || tcgetattr(fd, &t)) {
+		perror(name);
+		exit(1);
+	}
+	cfmakeraw(&t);
+	t.c_cflag |= CLOCAL | CREAD;
+	t.c_cflag &= ~CRTSCTS;
+	t.c_cc[VMIN] = 1;
+	t.c_cc[VTIME] = 0;
+	cfsetispeed(&t, speed(baud));
+	cfsetospeed(&t, speed(baud));
+	if (tcsetattr(fd, TCSANOW, &t)) {
+		perror("tcsetattr");
+		exit(1);
+	}
+
+	/* a pty has no serial_struct; only -l insists on one */
+	if (ioctl(fd, TIOCGSERIAL, &ss) == 0) {
+		if (low_latency)
+			ss.flags |= ASYNC_LOW_LATENCY;
+		else
+			ss.flags &= ~ASYNC_LOW_LATENCY;
+		if (ioctl(fd, TIOCSSERIAL, &ss) && low_latency) {
+			perror("TIOCSSERIAL");
+			exit(1);
+		}
+	} else if (low_latency) {
+		perror("TIOCGSERIAL");
+		exit(1);
+	}
+	tcflush(fd, TCIOFLUSH);
+	return fd;
+}
+
+static void write_all(int fd, const char *p, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		n = write(fd, p, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("write");
+			exit(1);
+		}
+		p += n;
+		len -= n;
+	}
+}
+
+/*
+ * Read up to and including a CR into buf, waiting at most timeout_ms
+ * for each byte (forever for -1).  Returns the length, or -1 on timeout.
+ */
+static int read_line(int fd, char *buf, int timeout_ms)
+{
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	int len = 0;
+	ssize_t n;
+
+	for (;;) {
+		if (timeout_ms >= 0 && poll(&pfd, 1, timeout_ms) <= 0)
+			return -1;
+		n = read(fd, buf + len, MAX_CMD - len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("read");
+			exit(1);
+		}
+		if (!n) {
+			fprintf(stderr, "hangup\n");
+			exit(1);
+		}
+		len += n;
+		if (buf[len - 1] == '\r' || len == MAX_CMD)
+			return len;
+	}
+}
+
+static void responder(int fd)
+{
+	double *lat = calloc(count, sizeof(*lat));
+	struct timespec stamp, ts;
+	char buf[MAX_CMD + 1];
+	unsigned int done = 0;
+	int ldisc = N_CMD, n;
+
+	if (!lat)
+		exit(1);
+	if (use_ncmd && ioctl(fd, TIOCSETD, &ldisc)) {
+		perror("TIOCSETD N_CMD");
+		exit(1);
+	}
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	printf("responding on %s, %s%s\n", use_ncmd ? "N_CMD" : "N_TTY",
+	       low_latency ? "low_latency, " : "", "CR delimited");
+
+	for (;;) {
+		if (!use_ncmd) {
+			n = read_line(fd, buf, -1);
+			write_all(fd, buf, n);
+			continue;
+		}
+		/* N_CMD returns the command without its delimiter */
+		n = read(fd, buf, MAX_CMD);
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("read");
+			exit(1);
+		}
+		buf[n++] = '\r';
+		write_all(fd, buf, n);
+		if (ioctl(fd, CMDIOCGSTAMP, &stamp))
+			continue;
+		lat[done++] = ts.tv_sec - stamp.tv_sec +
+			      (ts.tv_nsec - stamp.tv_nsec) / 1e9;
+		if (done == count) {
+			report("CR to read()", lat, done);
+			done = 0;
+		}
+	}
+}
+
+static void initiator(int fd)
+{
+	double *rtt = calloc(count, sizeof(*rtt));
+	char cmd[MAX_CMD], buf[MAX_CMD];
+	struct timespec ts;
+	unsigned int i, ok = 0, lost = 0, bad = 0;
+	double t;
+	int n;
+
+	if (!rtt)
+		exit(1);
+	printf("%u commands of %u bytes at %u baud, wire time %.0f us\n",
+	       count, cmd_len, baud, 2 * cmd_len * 10 * 1e6 / baud);
+	for (i = 0; i < count; i++) {
+		snprintf(cmd, sizeof(cmd), "%0*u", cmd_len - 1, i);
+		cmd[cmd_len - 1] = '\r';
+		t = now();
+		write_all(fd, cmd, cmd_len);
+		n = read_line(fd, buf, 1000);
+		t = now() - t;
+		if (n < 0) {
+			lost++;
+			tcflush(fd, TCIFLUSH);
+		} else if (n != (int)cmd_len || memcmp(cmd, buf, n)) {
+			bad++;
+		} else {
+			rtt[ok++] = t;
+		}
+		if (interval_ms) {
+			ts.tv_sec = interval_ms / 1000;
+			ts.tv_nsec = (interval_ms % 1000) * 1000000;
+			nanosleep(&ts, NULL);
+		}
+	}
+	report("round trip", rtt, ok);
+	if (lost || bad)
+		printf("%u lost, %u wrong\n", lost, bad);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+"usage: ncmd-rtt -r [-m tty|cmd] [-l] [-n report every] [-b baud] tty\n"
+"       ncmd-rtt [-n count] [-s bytes] [-i interval ms] [-b baud] tty\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	int c, respond = 0, fd;
+
+	while ((c = getopt(argc, argv, "rm:ln:s:i:b:")) != -1) {
+		switch (c) {
+		case 'r':
+			respond = 1;
+			break;
+		case 'm':
+			if (!strcmp(optarg, "cmd"))
+				use_ncmd = 1;
+			else if (strcmp(optarg, "tty"))
+				usage();
+			break;
+		case 'l':
+			low_latency = 1;
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 's':
+			cmd_len = atoi(optarg);
+			break;
+		case 'i':
+			interval_ms = atoi(optarg);
+			break;
+		case 'b':
+			baud = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1 || !count || cmd_len < 2 || cmd_len > MAX_CMD)
+		usage();
+
+	fd = open_tty(argv[optind]);
+	if (respond)
+		responder(fd);
+	initiator(fd);
+	return 0;
+}
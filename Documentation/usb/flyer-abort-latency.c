@@ -0,0 +1,410 @@
+/*
+ * flyer-abort-latency: how long an abort from the host takes to wake the
+ * marking thread, through the application and through the urgent
+ * channel's abort notifier.
+ *
+ * Flyer: flyer-abort-latency -r [-d] [-p prio] [-n report every]
+ *				[-u urgent dev] [-x xilinx dev]
+ * Host:  flyer-abort-latency [-n count] [-i interval ms]
+ *
+ * On the Flyer a "marking" thread sleeps in XIL_WAIT_EVENTS for
+ * XIL_EVENT_ABORT and, each time it wakes, writes an acknowledgement to
+ * the urgent channel.  A reader thread reads the urgent channel.  Without
+ * -d it is the reader that issues XIL_WAKE_IO_SLEEPERS when an "ABORT"
+ * message arrives, as the marker application does today; with -d the
+ * "ABORT" prefix is handed to FLYER_URGENT_ABORT_MATCH and the gadget's
+ * completion handler wakes the marking thread itself.  Every -n aborts
+ * the Flyer side prints the time from each message's arrival
+ * (FLYER_URGENT_GSTAMP) to the abort event (tsFired of XIL_WAIT_EVENTS)
+ * and to the marking thread running again.  -p runs both threads
+ * SCHED_FIFO at that priority, as the marker application does.
+ *
+ * The host side finds the Flyer through usbfs (/dev/bus/usb), claims
+ * its urgent interface, sends -n "ABORT" messages -i milliseconds apart
+ * (default 10, so the marking thread is back in XIL_WAIT_EVENTS before
+ * the next one) and waits for each acknowledgement.  It prints the round
+ * trip: host send to marking thread wake, plus the acknowledgement's way
+ * back.  No other driver may be bound to the urgent interface.
+ *
+ * The device nodes on the Flyer are
+ *	mknod /dev/flyer_usb1 c 243 1
+ *	mknod /dev/flyer_xil c 242 0
+ *
+ * Compile with
+ *	gcc -O2 -Wall -I<kernel>/include flyer-abort-latency.c \
+ *		-o flyer-abort-latency -lpthread -lrt
+ * (the Flyer side needs <asm-ppc/Flyer_Xilinx.h> from this tree; build
+ * the host side with -DHOST_ONLY).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <linux/usbdevice_fs.h>
+#ifndef HOST_ONLY
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <asm-ppc/Flyer_Xilinx.h>
+#endif
+
+#define FLYER_VENDOR	0x7967
+#define FLYER_PRODUCT	0x3473
+#define URGENT_INTF	1
+
+#define FLYER_IOCTL_BASE	0xAE
+#define URGENT_MATCH_MAX	16
+struct flyer_urgent_match {
+	unsigned int len;
+	unsigned char data[URGENT_MATCH_MAX];
+};
+#define FLYER_URGENT_GSTAMP	_IOR(FLYER_IOCTL_BASE, 0x22, struct timespec)
+#define FLYER_URGENT_ABORT_MATCH \
+	_IOW(FLYER_IOCTL_BASE, 0x23, struct flyer_urgent_match)
+
+#define ABORT_MSG	"ABORT"
+#define ACK_MSG		"ACK"
+#define MSG_MAX		512
+
+static unsigned int count = 1000;	/* -n */
+static unsigned int interval_ms = 10;	/* -i */
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report(const char *what, double *v, unsigned int n)
+{
+	if (!n)
+		return;
+	qsort(v, n, sizeof(*v), cmp_double);
+	printf("%-18s us median %7.0f p99 %7.0f max %7.0f (%u)\n", what,
+	       v[n / 2] * 1e6, v[n * 99 / 100] * 1e6, v[n - 1] * 1e6, n);
+}
+
+#ifndef HOST_ONLY
+static const char *urgent_dev = "/dev/flyer_usb1";	/* -u */
+static const char *xil_dev = "/dev/flyer_xil";		/* -x */
+static int flyer;					/* -r */
+static int direct;					/* -d */
+static int prio;					/* -p */
+
+static int urgent_fd, xil_fd;
+
+/* written by the marking thread, read by the reader */
+static struct timespec *fired, *woken;
+static volatile unsigned int wakes;
+
+static double ts_diff(const struct timespec *a, const struct timespec *b)
+{
+	return b->tv_sec - a->tv_sec + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+static void realtime(void)
+{
+	struct sched_param sp = { .sched_priority = prio };
+
+	if (prio && pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp)) {
+		fprintf(stderr, "SCHED_FIFO %d failed\n", prio);
+		exit(1);
+	}
+}
+
+static void *marking_thread(void *arg)
+{
+	waitEventStruct w;
+	unsigned int i;
+
+	realtime();
+	for (;;) {
+		memset(&w, 0, sizeof(w));
+		w.dwEvents = XIL_EVENT_ABORT;
+		if (ioctl(xil_fd, XIL_WAIT_EVENTS, &w)) {
+			if (errno == EINTR)
+				continue;
+			perror("XIL_WAIT_EVENTS");
+			exit(1);
+		}
+		i = wakes % count;
+		clock_gettime(CLOCK_MONOTONIC, &woken[i]);
+		fired[i] = w.tsFired;
+		__sync_synchronize();
+		wakes++;
+		if (write(urgent_fd, ACK_MSG, sizeof(ACK_MSG)) < 0)
+			perror("write ack");
+	}
+	return NULL;
+}
+
+static void flyer_side(void)
+{
+	struct flyer_urgent_match match;
+	struct pollfd pfd;
+	struct timespec *arrived;
+	double *to_event, *to_wake;
+	unsigned int aborts = 0, i;
+	char msg[MSG_MAX];
+	pthread_t tid;
+	int n;
+
+	urgent_fd = open(urgent_dev, O_RDWR);
+	if (urgent_fd < 0) {
+		perror(urgent_dev);
+		exit(1);
+	}
+	xil_fd = open(xil_dev, O_RDWR);
+	if (xil_fd < 0) {
+		perror(xil_dev);
+		exit(1);
+	}
+	arrived = calloc(count, sizeof(*arrived));
+	fired = calloc(count, sizeof(*fired));
+	woken = calloc(count, sizeof(*woken));
+	to_event = calloc(count, sizeof(*to_event));
+	to_wake = calloc(count, sizeof(*to_wake));
+	if (!arrived || !fired || !woken || !to_event || !to_wake)
+		exit(1);
+
+	memset(&match, 0, sizeof(match));
+	if (direct) {
+		match.len = strlen(ABORT_MSG);
+		memcpy(match.data, ABORT_MSG, match.len);
+	}
+	if (ioctl(urgent_fd, FLYER_URGENT_ABORT_MATCH, &match)) {
+		perror("FLYER_URGENT_ABORT_MATCH");
+		exit(1);
+	}
+	if (prio && mlockall(MCL_CURRENT | MCL_FUTURE))
+		perror("mlockall");
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	printf("abort through %s\n", direct ? "the gadget's abort notifier" :
+	       "the reader's XIL_WAKE_IO_SLEEPERS");
+
+	if (pthread_create(&tid, NULL, marking_thread, NULL)) {
+		fprintf(stderr, "pthread_create failed\n");
+		exit(1);
+	}
+	realtime();
+
+	pfd.fd = urgent_fd;
+	pfd.events = POLLIN;
+	for (;;) {
+		if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+			perror("poll");
+			exit(1);
+		}
+		/* read() returns 0 while the ring is empty */
+		n = read(urgent_fd, msg, sizeof(msg));
+		if (n <= 0 || n < (int)strlen(ABORT_MSG) ||
+		    memcmp(msg, ABORT_MSG, strlen(ABORT_MSG)))
+			continue;
+		if (!direct && ioctl(xil_fd, XIL_WAKE_IO_SLEEPERS))
+			perror("XIL_WAKE_IO_SLEEPERS");
+		if (ioctl(urgent_fd, FLYER_URGENT_GSTAMP, &arrived[aborts % count]))
+			perror("FLYER_URGENT_GSTAMP");
+		if (++aborts % count)
+			continue;
+
+		/* the marking thread acks before the host sends the next */
+		while (wakes < aborts)
+			usleep(1000);
+		__sync_synchronize();
+		for (i = 0; i < count; i++) {
+			to_event[i] = ts_diff(&arrived[i], &fired[i]);
+			to_wake[i] = ts_diff(&arrived[i], &woken[i]);
+		}
+		report("arrival to event", to_event, count);
+		report("arrival to wake", to_wake, count);
+	}
+}
+#endif
+
+/* usbfs handle and urgent endpoints of the Flyer, as the host sees it */
+static int usb_fd = -1;
+static unsigned int ep_out, ep_in;
+
+static void find_flyer(void)
+{
+	unsigned char desc[4096];
+	char path[PATH_MAX];
+	struct dirent *b, *d;
+	DIR *bus, *dev;
+	int fd, n = 0, i, intf = -1;
+	unsigned int ifno = URGENT_INTF;
+
+	bus = opendir("/dev/bus/usb");
+	if (!bus) {
+		perror("/dev/bus/usb");
+		exit(1);
+	}
+	while (usb_fd < 0 && (b = readdir(bus))) {
+		if (b->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof(path), "/dev/bus/usb/%s", b->d_name);
+		dev = opendir(path);
+		if (!dev)
+			continue;
+		while ((d = readdir(dev))) {
+			if (d->d_name[0] == '.')
+				continue;
+			snprintf(path, sizeof(path), "/dev/bus/usb/%s/%s",
+				 b->d_name, d->d_name);
+			fd = open(path, O_RDWR);
+			if (fd < 0)
+				continue;
+			n = read(fd, desc, sizeof(desc));
+			if (n >= 18 &&
+			    (desc[8] | desc[9] << 8) == FLYER_VENDOR &&
+			    (desc[10] | desc[11] << 8) == FLYER_PRODUCT) {
+				usb_fd = fd;
+				break;
+			}
+			close(fd);
+		}
+		closedir(dev);
+	}
+	closedir(bus);
+	if (usb_fd < 0) {
+		fprintf(stderr, "no Flyer found in /dev/bus/usb\n");
+		exit(1);
+	}
+
+	/* device descriptor, then the configuration with all its parts */
+	for (i = 18; i + 2 <= n && desc[i]; i += desc[i]) {
+		if (desc[i + 1] == 4)			/* interface */
+			intf = desc[i + 2];
+		else if (desc[i + 1] == 5 && intf == URGENT_INTF &&
+			 (desc[i + 3] & 3) == 2) {	/* bulk endpoint */
+			if (desc[i + 2] & 0x80)
+				ep_in = desc[i + 2];
+			else
+				ep_out = desc[i + 2];
+		}
+	}
+	if (!ep_in || !ep_out) {
+		fprintf(stderr, "no urgent endpoints\n");
+		exit(1);
+	}
+	if (ioctl(usb_fd, USBDEVFS_CLAIMINTERFACE, &ifno) < 0) {
+		perror("claim urgent interface");
+		exit(1);
+	}
+}
+
+static int bulk(unsigned int ep, void *buf, unsigned int len,
+		unsigned int timeout_ms)
+{
+	struct usbdevfs_bulktransfer bt;
+
+	bt.ep = ep;
+	bt.len = len;
+	bt.timeout = timeout_ms;
+	bt.data = buf;
+	return ioctl(usb_fd, USBDEVFS_BULK, &bt);
+}
+
+static void host_side(void)
+{
+	double *rtt = calloc(count, sizeof(*rtt));
+	char msg[32], ack[MSG_MAX];
+	struct timespec ts;
+	unsigned int i, ok = 0, lost = 0;
+	double t;
+
+	if (!rtt)
+		exit(1);
+	find_flyer();
+	/* drop acknowledgements left over from an earlier run */
+	while (bulk(ep_in, ack, sizeof(ack), 10) > 0)
+		;
+	for (i = 0; i < count; i++) {
+		snprintf(msg, sizeof(msg), "%s %u", ABORT_MSG, i);
+		t = now();
+		if (bulk(ep_out, msg, strlen(msg) + 1, 1000) < 0) {
+			perror("send");
+			exit(1);
+		}
+		if (bulk(ep_in, ack, sizeof(ack), 1000) < 0)
+			lost++;
+		else
+			rtt[ok++] = now() - t;
+		ts.tv_sec = interval_ms / 1000;
+		ts.tv_nsec = (interval_ms % 1000) * 1000000;
+		nanosleep(&ts, NULL);
+	}
+	report("round trip", rtt, ok);
+	if (lost)
+		printf("%u not acknowledged\n", lost);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+"usage: flyer-abort-latency -r [-d] [-p prio] [-n report every]\n"
+"                           [-u urgent dev] [-x xilinx dev]\n"
+"       flyer-abort-latency [-n count] [-i interval ms]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "rdp:n:i:u:x:")) != -1) {
+		switch (c) {
+#ifndef HOST_ONLY
+		case 'r':
+			flyer = 1;
+			break;
+		case 'd':
+			direct = 1;
+			break;
+		case 'p':
+			prio = atoi(optarg);
+			break;
+		case 'u':
+			urgent_dev = optarg;
+			break;
+		case 'x':
+			xil_dev = optarg;
+			break;
+#endif
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'i':
+			interval_ms = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || !count)
+		usage();
+
+#ifndef HOST_ONLY
+	if (flyer)
+		flyer_side();
+#endif
+	host_side();
+	return 0;
+}
@@ -0,0 +1,256 @@
+/*
+ * mem_notify-stress: check that /dev/mem_notify saves an application
+ * from reclaim stalls.
+ *
+ * A child keeps the page cache growing by writing and re-reading a file
+ * larger than memory.  Meanwhile the parent plays the marking process:
+ * it holds an anonymous cache of its own (-c MB) and every few
+ * milliseconds allocates, fills and frees a "job" buffer, timing each
+ * job.  When listening (the default) it polls /dev/mem_notify and gives
+ * half of its cache back at "medium" and all of it at "critical", and
+ * grows it again once the level is back to "none".  Run it once with
+ * -n (not listening) and once without, and compare:
+ *
+ *   allocstall, pgscan_direct_*	from /proc/vmstat, over the run
+ *   job time max and 99th percentile
+ *
+ * The file goes in the current directory (-d), which must not be tmpfs;
+ * on the Flyer use an NFS mount rather than wearing out the flash.
+ *
+ * Compile with
+ *	gcc -O2 -Wall mem_notify-stress.c -o mem_notify-stress
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define CHUNK		(1 << 20)	/* the app cache is kept in 1MB pieces */
+#define MAX_JOBS	100000
+
+static const char *device = "/dev/mem_notify";
+static const char *dir = ".";		/* -d */
+static unsigned int cache_mb = 16;	/* -c */
+static unsigned int file_mb;		/* -f, default twice MemTotal */
+static unsigned int job_kb = 512;	/* -j */
+static unsigned int job_ms = 10;	/* -i */
+static unsigned int seconds = 60;	/* -t */
+static int use_notify = 1;		/* -n clears */
+
+static char **cache;
+static unsigned int cache_n;
+static unsigned long drops, refills;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long vmstat(const char *prefix)
+{
+	char name[64];
+	unsigned long long val, sum = 0;
+	FILE *f = fopen("/proc/vmstat", "r");
+
+	if (!f)
+		return 0;
+	while (fscanf(f, "%63s %llu", name, &val) == 2)
+		if (!strncmp(name, prefix, strlen(prefix)))
+			sum += val;
+	fclose(f);
+	return sum;
+}
+
+static unsigned int mem_total_mb(void)
+{
+	char line[128];
+	unsigned long kb = 0;
+	FILE *f = fopen("/proc/meminfo", "r");
+
+	if (!f)
+		return 64;
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "MemTotal: %lu kB", &kb) == 1)
+			break;
+	fclose(f);
+	return kb >> 10;
+}
+
+static void cache_resize(unsigned int n)
+{
+	while (cache_n > n)
+		free(cache[--cache_n]);
+	while (cache_n < n) {
+		cache[cache_n] = malloc(CHUNK);
+		if (!cache[cache_n])
+			break;
+		memset(cache[cache_n], cache_n, CHUNK);
+		cache_n++;
+	}
+}
+
+/* Page cache pressure: write and re-read a file bigger than memory */
+static void pressure(void)
+{
+	char path[256], *buf;
+	unsigned int i;
+	int fd;
+
+	buf = malloc(CHUNK);
+	if (!buf)
+		exit(1);
+	memset(buf, 0x5a, CHUNK);
+	snprintf(path, sizeof(path), "%s/mem_notify-stress.%d", dir, getpid());
+	for (;;) {
+		fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+		if (fd < 0) {
+			perror(path);
+			exit(1);
+		}
+		unlink(path);
+		for (i = 0; i < file_mb; i++)
+			if (write(fd, buf, CHUNK) != CHUNK)
+				break;
+		lseek(fd, 0, SEEK_SET);
+		while (read(fd, buf, CHUNK) > 0)
+			;
+		close(fd);
+	}
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+"usage: mem_notify-stress [-n] [-c cache MB] [-f file MB] [-d dir]\n"
+"                         [-j job kB] [-i job interval ms] [-t seconds]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long stall0, direct0;
+	unsigned int njobs = 0, level = 0;
+	double *jobs, t, end;
+	struct pollfd pfd;
+	char msg[32];
+	pid_t child;
+	int c;
+
+	while ((c = getopt(argc, argv, "nc:f:d:j:i:t:")) != -1) {
+		switch (c) {
+		case 'n':
+			use_notify = 0;
+			break;
+		case 'c':
+			cache_mb = atoi(optarg);
+			break;
+		case 'f':
+			file_mb = atoi(optarg);
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		case 'j':
+			job_kb = atoi(optarg);
+			break;
+		case 'i':
+			job_ms = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (!file_mb)
+		file_mb = 2 * mem_total_mb();
+
+	cache = calloc(cache_mb, sizeof(*cache));
+	jobs = calloc(MAX_JOBS, sizeof(*jobs));
+	if (!cache || !jobs)
+		return 1;
+	cache_resize(cache_mb);
+
+	pfd.fd = -1;
+	pfd.events = POLLIN;
+	if (use_notify) {
+		pfd.fd = open(device, O_RDONLY);
+		if (pfd.fd < 0) {
+			perror(device);
+			return 1;
+		}
+	}
+
+	child = fork();
+	if (!child)
+		pressure();
+
+	stall0 = vmstat("allocstall");
+	direct0 = vmstat("pgscan_direct");
+	end = now() + seconds;
+	while ((t = now()) < end && njobs < MAX_JOBS) {
+		char *job;
+
+		/* wait out the interval, watching the pressure level */
+		if (poll(&pfd, 1, job_ms) > 0 && (pfd.revents & POLLIN) &&
+		    read(pfd.fd, msg, sizeof(msg)) > 0) {
+			level = atoi(msg);
+			if (level >= 3 && cache_n) {
+				cache_resize(0);
+				drops++;
+			} else if (level == 2 && cache_n > cache_mb / 2) {
+				cache_resize(cache_mb / 2);
+				drops++;
+			}
+		}
+		if (use_notify && level == 0 && cache_n < cache_mb) {
+			cache_resize(cache_n + 1);
+			refills++;
+		}
+
+		t = now();
+		job = malloc(job_kb << 10);
+		if (job) {
+			memset(job, njobs, job_kb << 10);
+			free(job);
+		}
+		jobs[njobs++] = (now() - t) * 1e3;
+	}
+
+	kill(child, SIGKILL);
+	waitpid(child, NULL, 0);
+
+	qsort(jobs, njobs, sizeof(*jobs), cmp_double);
+	printf("%s, %u s, cache %u MB, file %u MB, jobs of %u kB every %u ms\n",
+	       use_notify ? "listening" : "not listening", seconds, cache_mb,
+	       file_mb, job_kb, job_ms);
+	printf("allocstall     %llu\n", vmstat("allocstall") - stall0);
+	printf("pgscan_direct  %llu\n", vmstat("pgscan_direct") - direct0);
+	if (njobs)
+		printf("job ms         median %.3f  p99 %.3f  max %.3f  (%u jobs)\n",
+		       jobs[njobs / 2], jobs[njobs * 99 / 100],
+		       jobs[njobs - 1], njobs);
+	if (use_notify)
+		printf("cache drops    %lu, refills %lu MB, %u MB held at end\n",
+		       drops, refills, cache_n);
+	return 0;
+}
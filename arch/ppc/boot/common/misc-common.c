@@ -15,6 +15,9 @@
 #include <stdarg.h>	/* for va_ bits */
 #include <linux/string.h>
 #include <linux/zlib.h>
+#ifdef CONFIG_ZIMAGE_LZO
+#include <linux/lzo.h>
+#endif
 #include "nonstdio.h"
 
 /* If we're on a PReP, assume we have a keyboard controller
@@ -50,9 +53,11 @@ void puts(const char *);
 void putc(const char c);
 void puthex(unsigned long val);
 void gunzip(void *, int, unsigned char *, int *);
+void unpack_image(void *, int, unsigned char *, int *);
 static int _cvt(unsigned long val, char *buf, long radix, char *digits);
 
 void _vprintk(void(*putc)(const char), const char *fmt0, va_list ap);
+void _printk(char const *fmt, ...);
 unsigned char *ISA_io = NULL;
 
 #if defined(CONFIG_SERIAL_CPM_CONSOLE) || defined(CONFIG_SERIAL_8250_CONSOLE) \
@@ -274,6 +279,161 @@ void gunzip(void *dst, int dstlen, unsigned char *src, int *lenp)
 	zlib_inflateEnd(&s);
 }
 
+#ifdef CONFIG_BOOT_UNPACK_TIMING
+extern unsigned long timebase_period_ns;
+
+static inline unsigned long get_tbl(void)
+{
+	unsigned long tbl;
+
+	asm volatile("mftb %0" : "=r" (tbl));
+	return tbl;
+}
+
+static unsigned long unpack_copy_ticks;
+#endif
+
+#ifdef CONFIG_ZIMAGE_LZO
+/*
+ * lzop container: a header, then blocks of (uncompressed length,
+ * compressed length, checksums, data), ending with a zero length.
+ * Blocks that did not compress are stored as is.  Checksums are
+ * skipped, as gunzip skips the gzip CRC.
+ */
+#define LZOP_ADLER32_D	0x00000001
+#define LZOP_ADLER32_C	0x00000002
+#define LZOP_CRC32_D	0x00000100
+#define LZOP_CRC32_C	0x00000200
+#define LZOP_H_FILTER	0x00000800
+
+static const unsigned char lzop_magic[9] = {
+	0x89, 'L', 'Z', 'O', 0x00, 0x0d, 0x0a, 0x1a, 0x0a
+};
+
+static unsigned long get_be32(const unsigned char *p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void unlzo(void *dst, int dstlen, unsigned char *src, int *lenp)
+{
+	unsigned char *p = src, *end = src + *lenp;
+	unsigned char *out = dst;
+	unsigned long version, flags, dlen, slen;
+	size_t olen;
+	int r;
+
+	if (memcmp(p, lzop_magic, sizeof(lzop_magic))) {
+		puts("bad lzo data\n");
+		exit();
+	}
+	p += sizeof(lzop_magic);
+	version = (p[0] << 8) | p[1];
+	p += 4;				/* version, library version */
+	if (version >= 0x0940)
+		p += 2;			/* version needed to extract */
+	p++;				/* method */
+	if (version >= 0x0940)
+		p++;			/* level */
+	flags = get_be32(p);
+	p += 4;
+	if (flags & LZOP_H_FILTER)
+		p += 4;
+	p += 8;				/* mode, mtime */
+	if (version >= 0x0940)
+		p += 4;			/* mtime high */
+	p += *p + 1;			/* file name */
+	p += 4;				/* header checksum */
+
+	for (;;) {
+		if (p + 4 > end)
+			goto short_data;
+		dlen = get_be32(p);
+		if (dlen == 0)
+			break;
+		if (p + 8 > end)
+			goto short_data;
+		slen = get_be32(p + 4);
+		p += 8;
+		if (flags & LZOP_ADLER32_D)
+			p += 4;
+		if (flags & LZOP_CRC32_D)
+			p += 4;
+		if (slen < dlen) {
+			if (flags & LZOP_ADLER32_C)
+				p += 4;
+			if (flags & LZOP_CRC32_C)
+				p += 4;
+		}
+		if (p + slen > end || out + dlen > (unsigned char *)dst + dstlen) {
+			puts("unlzo: block overruns image\n");
+			exit();
+		}
+
+		if (slen < dlen) {
+			olen = dlen;
+			r = lzo1x_decompress_safe(p, slen, out, &olen);
+			if (r != LZO_E_OK || olen != dlen) {
+				puts("lzo1x_decompress_safe returned ");
+				puthex(r); puts("\n");
+				exit();
+			}
+		} else {
+#ifdef CONFIG_BOOT_UNPACK_TIMING
+			unsigned long t = get_tbl();
+#endif
+			memcpy(out, p, dlen);
+#ifdef CONFIG_BOOT_UNPACK_TIMING
+			unpack_copy_ticks += get_tbl() - t;
+#endif
+		}
+		p += slen;
+		out += dlen;
+	}
+	*lenp = out - (unsigned char *)dst;
+	return;
+
+short_data:
+	puts("unlzo: ran out of data\n");
+	exit();
+}
+#endif /* CONFIG_ZIMAGE_LZO */
+
+/*
+ * Unpack the kernel in whatever format it was built in.  Updates *lenp
+ * to the size of the unpacked kernel.
+ */
+void unpack_image(void *dst, int dstlen, unsigned char *src, int *lenp)
+{
+#ifdef CONFIG_BOOT_UNPACK_TIMING
+	unsigned long t = get_tbl(), total;
+	int inlen = *lenp;
+#endif
+
+#if defined(CONFIG_ZIMAGE_LZO)
+	unlzo(dst, dstlen, src, lenp);
+#elif defined(CONFIG_ZIMAGE_NONE)
+	if (*lenp > dstlen) {
+		puts("kernel image too big\n");
+		exit();
+	}
+	memmove(dst, src, *lenp);
+#ifdef CONFIG_BOOT_UNPACK_TIMING
+	unpack_copy_ticks = get_tbl() - t;
+#endif
+#else
+	gunzip(dst, dstlen, src, lenp);
+#endif
+
+#ifdef CONFIG_BOOT_UNPACK_TIMING
+	total = get_tbl() - t;
+	_printk("\nunpacked %d -> %d bytes: decompress %d, copy %d ticks"
+		" (%d ns/tick)\n", inlen, *lenp,
+		(int)(total - unpack_copy_ticks), (int)unpack_copy_ticks,
+		(int)timebase_period_ns);
+#endif
+}
+
 void
 puthex(unsigned long val)
 {
@@ -67,7 +67,7 @@ extern unsigned long serial_init(int chan, bd_t *bp);
 extern void serial_close(unsigned long com_port);
 extern unsigned long start;
 extern void flush_instruction_cache(void);
-extern void gunzip(void *, int, unsigned char *, int *);
+extern void unpack_image(void *, int, unsigned char *, int *);
 extern void embed_config(bd_t **bp);
 
 /* Weak function for boards which don't need to build the
@@ -214,7 +214,7 @@ load_kernel(unsigned long load_addr, int num_words, unsigned long cksum, bd_t *b
 	*cp = 0;
 	puts("\nUncompressing Linux...");
 
-	gunzip(0, 0x400000, zimage_start, &zimage_size);
+	unpack_image(0, 0x400000, zimage_start, &zimage_size);
 	flush_instruction_cache();
 	puts("done.\n");
 	{
@@ -72,7 +72,7 @@ extern unsigned long start;
 extern int CRT_tstc(void);
 extern unsigned long serial_init(int chan, void *ignored);
 extern void serial_close(unsigned long com_port);
-extern void gunzip(void *, int, unsigned char *, int *);
+extern void unpack_image(void *, int, unsigned char *, int *);
 extern void serial_fixups(void);
 
 /* Allow get_mem_size to be hooked into.  This is the default. */
@@ -216,7 +216,7 @@ decompress_kernel(unsigned long load_addr, int num_words, unsigned long cksum)
 	puts("\n");
 
 	puts("Uncompressing Linux...");
-	gunzip(NULL, 0x400000, zimage_start, &zimage_size);
+	unpack_image(NULL, 0x400000, zimage_start, &zimage_size);
 	puts("done.\n");
 
 	/* get the bi_rec address */
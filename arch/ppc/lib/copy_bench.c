@@ -0,0 +1,142 @@
+/*
+ * Kernel memcpy benchmark.
+ *
+ * Times memcpy() and cacheable_memcpy() over a range of sizes and
+ * source/destination alignments and prints the results when the module
+ * is loaded.  On 44x with the FPU, pairs whose addresses differ by a
+ * multiple of 8 take the lfd/stfd path from 128 bytes up, while the
+ * "+4" pairs are still word aligned but stay on the integer path, so
+ * the two rows compare the copy loops directly.
+ *
+ * The buffers are reused between iterations, so these are warm-cache
+ * figures; pass cold=1 to step through a 1MB area instead.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/string.h>
+#include <linux/sched.h>
+
+#include <asm/system.h>
+#include <asm/time.h>
+#include <asm/div64.h>
+
+#define BENCH_MAX	16384
+#define BENCH_BYTES	(4 << 20)	/* copied per size and alignment */
+#define COLD_ORDER	8		/* 1MB */
+
+static int cold;
+module_param(cold, bool, 0444);
+MODULE_PARM_DESC(cold, "walk a 1MB area so each copy misses the cache");
+
+static const unsigned int sizes[] = {
+	16, 64, 127, 128, 256, 512, 1024, 1514, 4096, 16384
+};
+
+/* source, destination offsets from a cache line boundary */
+static const struct {
+	unsigned int src, dst;
+} aligns[] = {
+	{ 0, 0 }, { 0, 4 }, { 8, 8 }, { 4, 12 }, { 1, 1 }, { 0, 3 },
+};
+
+static unsigned char *src_area, *dst_area;
+
+typedef void *(*copy_fn)(void *, const void *, unsigned int);
+
+static void *bench_memcpy(void *d, const void *s, unsigned int n)
+{
+	return memcpy(d, s, n);
+}
+
+/* Returns MB/s for copying size bytes with fn */
+static unsigned long bench_one(copy_fn fn, unsigned int size,
+			       unsigned int soff, unsigned int doff)
+{
+	unsigned long area = cold ? (PAGE_SIZE << COLD_ORDER) : BENCH_MAX + 64;
+	unsigned long off = 0, iters, i;
+	unsigned long long ticks, usecs;
+	unsigned long t0;
+
+	iters = BENCH_BYTES / size;
+	preempt_disable();
+	t0 = get_tbl();
+	for (i = 0; i < iters; i++) {
+		fn(dst_area + off + doff, src_area + off + soff, size);
+		if (cold) {
+			off += ALIGN(size + 64, L1_CACHE_BYTES);
+			if (off + BENCH_MAX + 64 > area)
+				off = 0;
+		}
+	}
+	ticks = get_tbl() - t0;
+	preempt_enable();
+
+	usecs = ticks;
+	do_div(usecs, tb_ticks_per_jiffy / (1000000 / HZ));
+	if (!usecs)
+		usecs = 1;
+	ticks = (unsigned long long)iters * size;	/* bytes/us == MB/s */
+	do_div(ticks, (unsigned long)usecs);
+	return ticks;
+}
+
+static void bench_fn(const char *name, copy_fn fn)
+{
+	char line[128];
+	int i, j, n;
+
+	printk(KERN_INFO "copy_bench: %s, MB/s (src+off/dst+off by size)\n",
+	       name);
+	n = sprintf(line, "%-8s", "");
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		n += sprintf(line + n, "%6u", sizes[i]);
+	printk(KERN_INFO "copy_bench: %s\n", line);
+
+	for (j = 0; j < ARRAY_SIZE(aligns); j++) {
+		n = sprintf(line, "+%u/+%-4u", aligns[j].src, aligns[j].dst);
+		for (i = 0; i < ARRAY_SIZE(sizes); i++)
+			n += sprintf(line + n, "%6lu", bench_one(fn, sizes[i],
+					aligns[j].src, aligns[j].dst));
+		printk(KERN_INFO "copy_bench: %s\n", line);
+		cond_resched();
+	}
+}
+
+static int __init copy_bench_init(void)
+{
+	unsigned int order = cold ? COLD_ORDER : get_order(BENCH_MAX + 64);
+
+	src_area = (unsigned char *)__get_free_pages(GFP_KERNEL, order);
+	dst_area = (unsigned char *)__get_free_pages(GFP_KERNEL, order);
+	if (!src_area || !dst_area) {
+		free_pages((unsigned long)src_area, order);
+		free_pages((unsigned long)dst_area, order);
+		return -ENOMEM;
+	}
+	memset(src_area, 0x5a, PAGE_SIZE << order);
+
+	bench_fn("memcpy", bench_memcpy);
+	bench_fn("cacheable_memcpy", cacheable_memcpy);
+
+	free_pages((unsigned long)src_area, order);
+	free_pages((unsigned long)dst_area, order);
+	return 0;
+}
+
+static void __exit copy_bench_exit(void)
+{
+}
+
+module_init(copy_bench_init);
+module_exit(copy_bench_exit);
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("memcpy/cacheable_memcpy benchmark");
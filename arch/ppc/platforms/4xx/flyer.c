@@ -37,6 +37,8 @@
 #include <linux/mtd/nand.h>
 #include <linux/mtd/ndfc.h>
 #include <linux/mtd/physmap.h>
+#include <linux/notifier.h>
+#include <linux/module.h>
 
 #include <asm/time.h>
 #include <asm/todc.h>
@@ -126,6 +128,32 @@ static int __init flyer_spi_init(void)
 device_initcall(flyer_spi_init);
 #endif
 
+/*
+ * Host aborts.  The USB gadget calls flyer_notify_abort() from interrupt
+ * context when the host's abort message arrives; the Xilinx driver
+ * registers here to wake its sleepers.  Either module loads without the
+ * other.
+ */
+static ATOMIC_NOTIFIER_HEAD(flyer_abort_chain);
+
+int flyer_register_abort_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&flyer_abort_chain, nb);
+}
+EXPORT_SYMBOL(flyer_register_abort_notifier);
+
+int flyer_unregister_abort_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&flyer_abort_chain, nb);
+}
+EXPORT_SYMBOL(flyer_unregister_abort_notifier);
+
+void flyer_notify_abort(void)
+{
+	atomic_notifier_call_chain(&flyer_abort_chain, 0, NULL);
+}
+EXPORT_SYMBOL(flyer_notify_abort);
+
 static void __init
 flyer_calibrate_decr(void)
 {
@@ -84,5 +84,14 @@
 #define FLYER_PCIL0_PTM2MS          0x038
 #define FLYER_PCIL0_PTM2LA          0x03C
 
+#ifndef __ASSEMBLY__
+struct notifier_block;
+
+/* Host abort notification, see flyer.c */
+extern int flyer_register_abort_notifier(struct notifier_block *nb);
+extern int flyer_unregister_abort_notifier(struct notifier_block *nb);
+extern void flyer_notify_abort(void);
+#endif
+
 #endif                          /* __ASM_FLYER_H__ */
 #endif                          /* __KERNEL__ */
@@ -18,6 +18,9 @@
 #include <linux/serial.h>
 #include <linux/module.h>
 #include <linux/initrd.h>
+#include <linux/mm.h>
+#include <linux/kexec.h>
+#include <linux/string.h>
 
 #include <asm/ibm44x.h>
 #include <asm/mmu.h>
@@ -27,6 +30,9 @@
 #include <asm/param.h>
 #include <asm/bootinfo.h>
 #include <asm/ppcboot.h>
+#include <asm/cacheflush.h>
+#include <asm/uaccess.h>
+#include <asm/div64.h>
 
 #include <syslib/gen550.h>
 
@@ -77,11 +83,73 @@ phys_addr_t fixup_bigphys_addr(phys_addr_t addr, phys_addr_t size)
 };
 EXPORT_SYMBOL(fixup_bigphys_addr);
 
+/* The timebase as ibm44x_calibrate_decr() found it, before zeroing it */
+static unsigned long long __initdata ibm44x_tb_init;
+
+#ifdef CONFIG_KEXEC
+/*
+ * Restart timing: ibm44x_machine_kexec() appends "kexec_tb=" with the
+ * timebase at the jump, and the timebase keeps counting until we zero
+ * it below, so the difference is the time from the jump to time_init().
+ */
+static unsigned long __initdata kexec_tb_jump;
+static int __initdata kexec_tb_valid;
+
+static int __init ibm44x_kexec_tb_setup(char *str)
+{
+	kexec_tb_jump = simple_strtoul(str, NULL, 0);
+	kexec_tb_valid = 1;
+	return 1;
+}
+__setup("kexec_tb=", ibm44x_kexec_tb_setup);
+#endif /* CONFIG_KEXEC */
+
+#if defined(CONFIG_KEXEC) || defined(CONFIG_BOOT_UNPACK_TIMING)
+/*
+ * After a kexec restart, report the time from the jump.  Otherwise, with
+ * BOOT_UNPACK_TIMING, report the timebase itself: U-Boot zeroes it at
+ * reset, so that is the time U-Boot took, including loading and
+ * unpacking a uImage, plus the kernel's own start up to time_init().
+ */
+static int __init ibm44x_tb_report(void)
+{
+	unsigned long long us = ibm44x_tb_init;
+	unsigned long rem;
+
+#ifdef CONFIG_KEXEC
+	if (kexec_tb_valid) {
+		us = (unsigned long)ibm44x_tb_init - kexec_tb_jump;
+		do_div(us, tb_ticks_per_jiffy / (1000000 / HZ));
+		rem = do_div(us, 1000);
+		printk(KERN_INFO "kexec: %lu.%03lu ms from the jump to "
+		       "time_init\n", (unsigned long)us, rem);
+		return 0;
+	}
+#endif
+#ifdef CONFIG_BOOT_UNPACK_TIMING
+	do_div(us, tb_ticks_per_jiffy / (1000000 / HZ));
+	rem = do_div(us, 1000);
+	printk(KERN_INFO "boot: %lu.%03lu ms from reset to time_init\n",
+	       (unsigned long)us, rem);
+#endif
+	return 0;
+}
+late_initcall(ibm44x_tb_report);
+#endif
+
 void __init ibm44x_calibrate_decr(unsigned int freq)
 {
+	unsigned long tbu, tbl;
+
 	tb_ticks_per_jiffy = freq / HZ;
 	tb_to_us = mulhwu_scale_factor(freq, 1000000);
 
+	do {
+		tbu = get_tbu();
+		tbl = get_tbl();
+	} while (get_tbu() != tbu);
+	ibm44x_tb_init = ((unsigned long long)tbu << 32) | tbl;
+
 	/* Set the time base to zero */
 	mtspr(SPRN_TBWL, 0);
 	mtspr(SPRN_TBWU, 0);
@@ -113,6 +181,160 @@ static void ibm44x_halt(void)
 	for(;;);
 }
 
+#ifdef CONFIG_KEXEC
+/*
+ * The 44x core cannot run with translation off, so relocate_new_kernel
+ * maps lowmem 1:1 and copies the new image from there.  The new kernel
+ * is entered as U-Boot would enter it: r3 points at a copy of our bd_t
+ * and r6/r7 bracket a copy of the command line.  Both live at the top
+ * of the control page, which is never a copy destination, just below
+ * the stack word relocate_new_kernel writes.
+ */
+struct ibm44x_kexec_args {
+	unsigned long	regs[5];	/* r3-r7 for the new kernel */
+	bd_t		bd;
+	char		cmdline[COMMAND_LINE_SIZE];
+};
+
+#define IBM44x_KEXEC_ARGS_OFFSET \
+	((KEXEC_CONTROL_CODE_SIZE - 8 - sizeof(struct ibm44x_kexec_args)) & ~7)
+
+typedef NORET_TYPE void (*relocate_new_kernel_44x_t)(
+				unsigned long indirection_page,
+				unsigned long reboot_code_buffer,
+				unsigned long start_address,
+				unsigned long boot_args,
+				unsigned long lowmem_pins) ATTRIB_NORET;
+
+extern const unsigned char relocate_new_kernel[];
+extern const unsigned int relocate_new_kernel_size;
+
+static struct ibm44x_kexec_args *ibm44x_kexec_args(struct kimage *image)
+{
+	return page_address(image->control_code_page) +
+		IBM44x_KEXEC_ARGS_OFFSET;
+}
+
+/*
+ * kexec-tools hands over the new command line as a segment of its own,
+ * holding the string prefixed with "kexec " (the convention MIPS uses).
+ * It is kept in the image's own control page, so a failed or later load
+ * cannot change the command line of the image already loaded.  Without
+ * such a segment the new kernel gets our command line.
+ */
+#define IBM44x_KEXEC_CMDLINE_TAG	"kexec "
+
+static int ibm44x_kexec_find_cmdline(struct kimage *image, char *buf)
+{
+	const size_t tag = sizeof(IBM44x_KEXEC_CMDLINE_TAG) - 1;
+	size_t len;
+	int i;
+
+	for (i = 0; i < image->nr_segments; i++) {
+		len = min_t(size_t, image->segment[i].bufsz,
+			    COMMAND_LINE_SIZE - 1);
+		if (len < tag)
+			continue;
+		if (copy_from_user(buf, image->segment[i].buf, len)) {
+			buf[0] = '\0';
+			return -EFAULT;
+		}
+		buf[len] = '\0';
+		if (!strncmp(buf, IBM44x_KEXEC_CMDLINE_TAG, tag)) {
+			memmove(buf, buf + tag, strlen(buf + tag) + 1);
+			return 0;
+		}
+	}
+	buf[0] = '\0';
+	return 0;
+}
+
+static int ibm44x_machine_kexec_prepare(struct kimage *image)
+{
+	unsigned long limit = __pa(high_memory);
+	int i;
+
+	if (relocate_new_kernel_size > IBM44x_KEXEC_ARGS_OFFSET)
+		return -ENOMEM;
+
+	/* Only lowmem is mapped while the copy runs */
+	if (image->start >= limit)
+		return -EINVAL;
+	for (i = 0; i < image->nr_segments; i++)
+		if (image->segment[i].mem + image->segment[i].memsz > limit)
+			return -EINVAL;
+
+	return ibm44x_kexec_find_cmdline(image,
+					 ibm44x_kexec_args(image)->cmdline);
+}
+
+/*
+ * Drop the kexec_tb= an earlier restart left on the command line, so
+ * the line doesn't grow with every kexec and only our value is seen.
+ */
+static void ibm44x_kexec_strip_tb(char *cmdline)
+{
+	char *p = cmdline, *end;
+	size_t len;
+
+	while ((p = strstr(p, "kexec_tb=")) != NULL) {
+		if (p != cmdline && p[-1] != ' ') {
+			p++;
+			continue;
+		}
+		end = p + strcspn(p, " ");
+		end += strspn(end, " ");
+		memmove(p, end, strlen(end) + 1);
+	}
+	len = strlen(cmdline);
+	while (len && cmdline[len - 1] == ' ')
+		cmdline[--len] = '\0';
+}
+
+static void ibm44x_machine_kexec(struct kimage *image)
+{
+	unsigned long reboot_code_buffer, reboot_code_buffer_phys;
+	struct ibm44x_kexec_args *args;
+	relocate_new_kernel_44x_t rnk;
+	char tb[24];
+	size_t len;
+
+	local_irq_disable();
+
+	reboot_code_buffer =
+			(unsigned long)page_address(image->control_code_page);
+	reboot_code_buffer_phys = virt_to_phys((void *)reboot_code_buffer);
+
+	memcpy((void *)reboot_code_buffer, relocate_new_kernel,
+						relocate_new_kernel_size);
+
+	args = ibm44x_kexec_args(image);
+	args->bd = __res;
+	if (!args->cmdline[0])
+		strlcpy(args->cmdline, saved_command_line,
+			sizeof(args->cmdline));
+	ibm44x_kexec_strip_tb(args->cmdline);
+	/* Leave it off rather than truncate it to a wrong value */
+	len = snprintf(tb, sizeof(tb), " kexec_tb=%lu", get_tbl());
+	if (strlen(args->cmdline) + len < sizeof(args->cmdline))
+		strcat(args->cmdline, tb);
+	args->regs[0] = virt_to_phys(&args->bd);
+	args->regs[1] = 0;
+	args->regs[2] = 0;
+	args->regs[3] = virt_to_phys(args->cmdline);
+	args->regs[4] = args->regs[3] + strlen(args->cmdline);
+
+	flush_icache_range(reboot_code_buffer,
+				reboot_code_buffer + KEXEC_CONTROL_CODE_SIZE);
+	printk(KERN_INFO "Bye!\n");
+
+	rnk = (relocate_new_kernel_44x_t) reboot_code_buffer;
+	(*rnk)(image->head, reboot_code_buffer_phys, image->start,
+	       virt_to_phys(args),
+	       (__pa(high_memory) + PPC_PIN_SIZE - 1) >> PPC44x_PIN_SHIFT);
+}
+#endif /* CONFIG_KEXEC */
+
 /*
  * Read the 44x memory controller to get size of system memory.
  */
@@ -206,6 +428,10 @@ void __init ibm44x_platform_init(unsigned long r3, unsigned long r4, unsigned lo
 	ppc_md.restart = ibm44x_restart;
 	ppc_md.power_off = ibm44x_power_off;
 	ppc_md.halt = ibm44x_halt;
+#ifdef CONFIG_KEXEC
+	ppc_md.machine_kexec_prepare = ibm44x_machine_kexec_prepare;
+	ppc_md.machine_kexec = ibm44x_machine_kexec;
+#endif
 
 #ifdef CONFIG_SERIAL_TEXT_DEBUG
 	ppc_md.progress = gen550_progress;
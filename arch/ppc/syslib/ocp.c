@@ -190,6 +190,16 @@ ocp_device_resume(struct device *dev)
 	return 0;
 }
 
+static void
+ocp_device_shutdown(struct device *dev)
+{
+	struct ocp_device *ocp_dev = to_ocp_dev(dev);
+	struct ocp_driver *ocp_drv = to_ocp_drv(dev->driver);
+
+	if (dev->driver && ocp_drv->shutdown)
+		ocp_drv->shutdown(ocp_dev);
+}
+
 struct bus_type ocp_bus_type = {
 	.name = "ocp",
 	.match = ocp_device_match,
@@ -197,6 +207,7 @@ struct bus_type ocp_bus_type = {
 	.remove = ocp_device_remove,
 	.suspend = ocp_device_suspend,
 	.resume = ocp_device_resume,
+	.shutdown = ocp_device_shutdown,
 };
 
 /**
@@ -28,7 +28,17 @@
 #include <linux/ioctl.h>
 #include <linux/interrupt.h>
 #include <linux/completion.h>
+#include <linux/leds.h>
+#include <linux/spinlock.h>
+#include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/reboot.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <asm/io.h>
+#include <asm/time.h>
+#include <asm/div64.h>
 #include <asm/uaccess.h>
 #include <asm/Flyer_Xilinx.h>
 #include <asm/FlyerII.h>
@@ -95,20 +105,7 @@
 
 #define FLYER_XILINX_BASE 0xfb000000
 
-/*LED defines*/
-/*
-#define USB_RED_LINE           BIT32(28)
-#define USB_GREEN_LINE         BIT32(26)
-#define STAT_RED_LINE          BIT32(16)
-#define STAT_GREEN_LINE        BIT32(15)
-*/
-
-#define USB_RED_LINE           BIT32(26)
-#define USB_GREEN_LINE         BIT32(28)
-#define STAT_RED_LINE          BIT32(15)
-#define STAT_GREEN_LINE        BIT32(16)
-#define MAX_FREQ 10
-/*END LED defines*/
+/* The status and USB LEDs are driven by drivers/leds/leds-flyer.c */
 
 char* readBuf;
 char* writeBuf;
@@ -118,7 +115,6 @@ DECLARE_WAIT_QUEUE_HEAD(io_queue);
 DECLARE_WAIT_QUEUE_HEAD(track_queue);
 
 static irqreturn_t flyer_xil_interrupt(int irq, void *dev_id);
-static irqreturn_t flyer_xil_status_led_interrupt(int irq, void *dev_id);
 static irqreturn_t flyer_xil_encoder_interrupt(int irq, void *dev_id);
 
 static pAMCC440EP_GPIO __iomem pGPIO0 = NULL;
@@ -130,44 +126,56 @@ static pAMCC440EP_GPT_MASK __iomem pGPT_MASK= NULL;
 static AMCC_REG* __iomem pGPT_DCT0= NULL;
 static AMCC_REG* __iomem pGPT_DCIS= NULL;
 
-enum LEDState
-{
-    Off = 0,
-    On = 1,
-    Blink = 2
-};
-enum LEDColor
-{
-    None = 0,
-    Green = 1,
-    Red = 2
-};
-
-int curstate = Off;
-int newstate = Off;
-int encstate = Off;
-
-int curcolor = None;
-int newcolor = None;
-u8 toggle = 0xFF;
 u8 enctoggle = 0x0;
 
-int bLEDChanged = 0;
-int curfreq = 0,newfreq = 0;
+/*
+ * Encoder interrupt timing, to compare the jitter with the status LED
+ * blinking and not.  debugfs flyer_xil/encoder shows the spread of the
+ * intervals between encoder interrupts and a histogram of how much each
+ * interval differs from the one before; write to it to start over.
+ */
+#define ENC_HIST 16
+static struct {
+    unsigned long intervals;
+    int have_last, have_prev;
+    u32 last, prev;		/* timebase at the last interrupt, last interval */
+    u32 min, max;
+    u64 sum;
+    unsigned long hist[ENC_HIST];	/* buckets 0, 1, 2-3, 4-7, ... ticks */
+} enc_timing;
+
+static void enc_timing_sample(u32 now)
+{
+    u32 interval, dev;
+
+    if (enc_timing.have_last)
+    {
+	interval = now - enc_timing.last;
+	if (!enc_timing.intervals || interval < enc_timing.min)
+	    enc_timing.min = interval;
+	if (interval > enc_timing.max)
+	    enc_timing.max = interval;
+	enc_timing.sum += interval;
+	enc_timing.intervals++;
+	if (enc_timing.have_prev)
+	{
+	    dev = interval > enc_timing.prev ? interval - enc_timing.prev : enc_timing.prev - interval;
+	    enc_timing.hist[min(fls(dev), ENC_HIST - 1)]++;
+	}
+	enc_timing.prev = interval;
+	enc_timing.have_prev = 1;
+    }
+    enc_timing.last = now;
+    enc_timing.have_last = 1;
+}
 
 const int clock = 32768;//slow clock
 
 void init_registers(void);
 void init_gpio(void);
 void set_usb_led(int state);
-void setup_status_timer(u32 freq);
 void setup_encoder_timer(u32 freq);
-void enable_status_timer(void);
-void disable_status_timer(void);
-//void init_status_time(void);
 void set_status_led(int state);
-void set_status_color(int color);
-void setLED(int freq,int red,int green);
 int checkSwitch(int switchNum);
 //static const int Xilinx_Size = 78756;
 static const int Xilinx_Size = 54664;
@@ -186,6 +194,37 @@ unsigned short enc_cfg = 0;
 unsigned long interrupt_type = 0;
 u32 encodercount = 0;
 
+/*
+ * XIL_WAIT_EVENTS bookkeeping.  Every interrupt source a waiter can arm
+ * has a generation count and the time it last fired.  A waiter takes a
+ * snapshot of the counts before arming the hardware and sleeps until
+ * one of its counts moves, so any number of waiters can share an event
+ * and none of them depends on waitIOSuccess.
+ */
+static unsigned int xil_event_gen[XIL_NR_EVENTS];
+static struct timespec xil_event_time[XIL_NR_EVENTS];
+static DEFINE_SPINLOCK(xil_event_lock);
+static DECLARE_WAIT_QUEUE_HEAD(event_queue);
+/*
+ * The Xilinx has one wait digital register; waiters must agree on it.
+ * The interrupt clears it, so xil_digital_armed tells the next waiter to
+ * set it again.  Legacy XIL_SET_WAIT_DIGITAL callers program the register
+ * themselves, so while any are in (xil_digital_legacy) digital waits
+ * through XIL_WAIT_EVENTS get -EBUSY, and the other way round.
+ */
+static int xil_digital_waiters = 0;
+static int xil_digital_armed = 0;
+static int xil_digital_legacy = 0;
+static unsigned short xil_digital_state = 0;
+
+/*
+ * Leave the FPGA configured across a reboot into a kexec'd kernel, so
+ * the application can see it alive and skip downloading the bitstream.
+ */
+static int keep_fpga = 0;
+module_param(keep_fpga, bool, 0644);
+MODULE_PARM_DESC(keep_fpga, "Keep the FPGA configured across kexec");
+
 __inline unsigned short u16_le_to_be(unsigned short a)
 {
     return(((a>>8)&0xff)+((a<<8)&0xff00));
@@ -329,52 +368,6 @@ void init_gpio(void)
  
 }
 
-void setup_status_timer(u32 freq)
-{
-    u32 opb_freq;
-    u32 timercounts;
-    u32 comparemask;
-    u32 interruptmask;
-    u32 interruptenable;
-  
-    /* get the clock (Hz) for the OPB. Set in flyer_setup_arch() */
-    opb_freq = ocp_sys_info.opb_bus_freq;
-    //printk("\nopb_freq = %d\n",opb_freq);
-    //printk("\nfreq = %d\n",freq);
-    
-    timercounts = opb_freq/freq;
-    //comparemask = 0xFF << 7;
-    comparemask = 0xFE000000;
-    // Load the compare register
-    //pGPT_COMP->comp0 = timercounts;
-    pGPT_COMP->comp0 = timercounts;
-    // Load up the compare mask
-    pGPT_MASK->mask0 = comparemask;
-    //Unmask the interrupt
-    interruptmask = pGPT_INT->im;
-    
-    interruptmask &= ~BIT32(16);
-    pGPT_INT->im = interruptmask;
-    interruptenable = pGPT_INT->ie;
-    interruptenable |= BIT32(16);
-    
-   
-    pGPT_INT->ie = interruptenable;
-    *pGPT_TBC = 0;
-    /*
-    printk("UIC Registers - After\n");
-    printk("UIC0_ER: 0x%x\n",mfdcr(DCRN_UIC_ER(UIC0)));
-    printk("UIC1_ER: 0x%x\n",mfdcr(DCRN_UIC_ER(UIC1)));
-    printk("UIC0_CR: 0x%x\n",mfdcr(DCRN_UIC_CR(UIC0)));
-    printk("UIC1_CR: 0x%x\n",mfdcr(DCRN_UIC_CR(UIC1)));
-    printk("UIC0_PR: 0x%x\n",mfdcr(DCRN_UIC_PR(UIC0)));
-    printk("UIC1_PR: 0x%x\n",mfdcr(DCRN_UIC_PR(UIC1)));
-    printk("UIC0_TR: 0x%x\n",mfdcr(DCRN_UIC_TR(UIC0)));
-    printk("UIC1_TR: 0x%x\n",mfdcr(DCRN_UIC_TR(UIC1)));
-    */
-    //printk("Done with timer init\n");    
-}
-
 void setup_encoder_timer(u32 timercounts)
 {
     u32 reg;
@@ -483,204 +476,52 @@ void flyer_xil_send(int size, char* buf)
 
 void set_usb_led(int state)
 {        
-    if (state & SOLID_GREEN)
-	pGPIO0->orr = pGPIO0->orr | USB_GREEN_LINE;
-    else
-	pGPIO0->orr = pGPIO0->orr & ~USB_GREEN_LINE;
-    if (state & SOLID_RED)
-	pGPIO0->orr = pGPIO0->orr | USB_RED_LINE;
-    else
-	pGPIO0->orr = pGPIO0->orr & ~USB_RED_LINE;
-}
-
-void set_status_color(int color)
-{
-    if(color==Red)
-    {
-	pGPIO1->orr = pGPIO1->orr | STAT_RED_LINE;
-	pGPIO1->orr = pGPIO1->orr & ~STAT_GREEN_LINE;
-    }
-    else if(color==Green)
-    {
-	pGPIO1->orr = pGPIO1->orr | STAT_GREEN_LINE;
-	pGPIO1->orr = pGPIO1->orr & ~STAT_RED_LINE;
-    }
-    else
-    {
-	pGPIO1->orr = pGPIO1->orr & ~STAT_GREEN_LINE;
-	pGPIO1->orr = pGPIO1->orr & ~STAT_RED_LINE;
-    }  
+    flyer_led_set_usb(state);
 }
 
+// The status LED blinks from the "marking" (green) and "fault" (red) LED
+// triggers.  FREQ_MASK is the number of LED changes per second, 0 is solid.
+// It shows one colour at a time and red wins, as it always has.
 void set_status_led(int state)
 {
-    setLED((state & FREQ_MASK) >> 2,state & SOLID_RED,state & SOLID_GREEN);
-}
+    int freq = (state & FREQ_MASK) >> 2;
+    int mode = freq ? freq : -1;
 
-//if freq is <= 0, light is solid.
-//if both colors are 0 and freq is <=0 turns off LED
-void setLED(int freq,int red,int green)
-{
-    // Turn LED off
-    //printk("led color is %s  freq = %d\n",red?"Red":"Green", freq);
-    if( !red && !green && freq <= 0)
+    if (state & SOLID_RED)
     {
-	
-	if(curstate == On)
-	{
-	    set_status_color(Off);
-	    curstate = Off;
-	    curcolor = None;
-	}
-	else if(curstate == Blink)
-	{
-	    newstate = Off;
-	    newcolor = None;
-	}
-	curfreq = 0;
-	return;
+	flyer_led_marking(0);
+	flyer_led_fault(mode);
     }
-    // Turn Led solid on
-    if(freq <=0)
+    else if (state & SOLID_GREEN)
     {
-	
-	if(curstate == Off)
-	{
-	    if(red)
-	    {
-		set_status_color(Red);
-		curcolor = Red;
-	    }
-	    else
-	    {
-		set_status_color(Green);
-		curcolor = Green;		
-	    }
-	    curstate = On;
-	}
-	else if(curstate == Blink)
-	{
-	    newstate = On;
-	    newcolor = red?Red:Green;
-	}
-	curfreq = 0;
-	return;
+	flyer_led_fault(0);
+	flyer_led_marking(mode);
     }
-
-    // Set LED to Blink
-    newstate = Blink;
-    newcolor = red?Red:Green;
-    newfreq = freq;
-    
-    if(curstate != Blink)
+    else
     {
-	// changing frequency color or both
-	if(red)
-	{
-	    set_status_color(Red);
-	}
-	else
-	{
-	    set_status_color(Green);
-	}
-		
-	curstate = newstate;
-	curcolor = newcolor;
-	curfreq = newfreq;
-	toggle = 0xFF;
-	
-	setup_status_timer(freq);
-	
+	flyer_led_fault(0);
+	flyer_led_marking(0);
     }
- 
 }
 
-static irqreturn_t flyer_xil_status_led_interrupt(int irq, void *dev_id)
-{    
-    u32 encstatus = 0;
-    u32 ledstatus = 0;
-
-    int ledcolor;
-    u32 newcount = 0;
-    ledstatus = pGPT_INT->isc;
-    ledstatus &= BIT32(16);
-    encstatus = *pGPT_DCIS;
-    encstatus &= BIT32(0);   
-
-    
-    if(ledstatus)
-    {
-	
-	pGPT_INT->isc = ledstatus;
-	//pGPT_INT->isc = pGPT_INT->isc | BIT32(16);
-	toggle = ~toggle;
-	
-	if(newstate == curstate && newcolor == curcolor && newfreq == curfreq)
-	{
-	    // Toggle the LED and return
-	    toggle?(ledcolor=curcolor):(ledcolor=None);
-	    set_status_color(ledcolor);
-	   //*pGPT_TBC = 0;
-	    //return IRQ_HANDLED;
-	}
-	    
-	if(newstate != curstate)
-	{
-	    // No longer blinking disable the interrupt and set the color
-	    pGPT_INT->ie &= ~BIT32(16);
-	    set_status_color(newcolor);
-	    curcolor = newcolor;
-	    curstate = newstate;
-	}
-	else	     
-	{
-	    // check for a change in frequency
-	   
-	    if(newfreq != curfreq)
-	    {
-		pGPT_INT->ie &= ~BIT32(16);		
-		// Toggle the LED
-		curfreq = newfreq;
-		newcount = (ocp_sys_info.opb_bus_freq)/newfreq;
-		pGPT_COMP->comp0 = newcount;
-		if(newcolor != curcolor)
-		    toggle?(ledcolor=newcolor):(ledcolor=None);
-		else
-		    toggle?(ledcolor=curcolor):(ledcolor=None);
-		set_status_color(ledcolor);
-		pGPT_INT->ie |= BIT32(16);
-	    }
-	    else
-	    {
-		//color change
-		toggle?(ledcolor=curcolor):(ledcolor=None);
-		set_status_color(ledcolor);
-	    }	    
-	
-	}
-    }
-    
-   	
-
-    return IRQ_HANDLED;
-}
 static irqreturn_t flyer_xil_encoder_interrupt(int irq, void *dev_id)
 {
     
     u32 encstatus = 0;
-    u32 ledstatus = 0;
+    u32 intstatus = 0;
     u32 reg = 0;
     encstatus = *pGPT_DCIS;
     encstatus &= BIT32(0);   
-    ledstatus = pGPT_INT->isc;
-    ledstatus &= BIT32(17);
-    pGPT_INT->isc = ledstatus;
+    intstatus = pGPT_INT->isc;
+    intstatus &= BIT32(17);
+    pGPT_INT->isc = intstatus;
     
     
 
     //printk("0x%x  %d\n", encstatus, *pGPT_DCT0);
     if(encstatus)
     {
+	enc_timing_sample(get_tbl());
 	//printk("\nvalid encoder interrupt  %d     %d\n", *pGPT_DCIS, *pGPT_DCT0);
 	*pGPT_DCIS = encstatus;
 	*pGPT_DCT0 = encodercount;
@@ -793,6 +634,171 @@ static int flyer_xil_release(struct inode* inode, struct file* file)
     return 0;
 }
 
+static void xil_post_event(unsigned int event)
+{
+    unsigned long flags;
+    int i = ffs(event) - 1;
+
+    spin_lock_irqsave(&xil_event_lock, flags);
+    xil_event_gen[i]++;
+    ktime_get_ts(&xil_event_time[i]);
+    spin_unlock_irqrestore(&xil_event_lock, flags);
+    wake_up_interruptible(&event_queue);
+}
+
+/* Which of the armed events fired since gen[] was taken, and when the first did */
+static unsigned int xil_events_fired(unsigned int events, const unsigned int *gen, struct timespec *ts)
+{
+    unsigned int fired = 0;
+    unsigned long flags;
+    int i;
+
+    spin_lock_irqsave(&xil_event_lock, flags);
+    for (i = 0; i < XIL_NR_EVENTS; i++)
+    {
+	if (!(events & (1 << i)) || xil_event_gen[i] == gen[i])
+	    continue;
+	if (!fired || timespec_compare(&xil_event_time[i], ts) < 0)
+	    *ts = xil_event_time[i];
+	fired |= 1 << i;
+    }
+    spin_unlock_irqrestore(&xil_event_lock, flags);
+    return fired;
+}
+
+/*
+ * Abort: wake everything sleeping on IO or tracking and post
+ * XIL_EVENT_ABORT.  Also run from interrupt context, through the board's
+ * abort notifier, when the host's abort arrives on the USB urgent
+ * endpoint.
+ */
+static void xil_wake_io_sleepers(void)
+{
+    wake_up_interruptible(&io_queue);
+    wake_up_interruptible(&track_queue);
+    xil_post_event(XIL_EVENT_ABORT);
+}
+
+static int xil_abort_notify(struct notifier_block *nb, unsigned long event,
+			    void *unused)
+{
+    xil_wake_io_sleepers();
+    return NOTIFY_OK;
+}
+
+static struct notifier_block xil_abort_nb = {
+    .notifier_call = xil_abort_notify,
+};
+
+static int flyer_xil_wait_events(waitEventStruct __user *uwait)
+{
+    waitEventStruct Wait;
+    unsigned int gen[XIL_NR_EVENTS];
+    struct hrtimer_sleeper timeout;
+    DEFINE_WAIT(wait);
+    unsigned int fired = 0;
+    int deadline, resume;
+    long ret = 0;
+
+    if (copy_from_user(&Wait, uwait, sizeof(Wait)))
+	return -EFAULT;
+    resume = Wait.dwEvents & XIL_EVENT_RESUME;
+    Wait.dwEvents &= XIL_EVENT_DIGITAL | XIL_EVENT_PART | XIL_EVENT_ABORT;
+    deadline = Wait.tsDeadline.tv_sec || Wait.tsDeadline.tv_nsec;
+    if (!deadline && !Wait.dwEvents)
+	return -EINVAL;
+
+    spin_lock_irq(&xil_event_lock);
+    if (Wait.dwEvents & XIL_EVENT_DIGITAL)
+    {
+	if (xil_digital_legacy ||
+	    (xil_digital_waiters && xil_digital_state != (unsigned short)Wait.dwState))
+	{
+	    spin_unlock_irq(&xil_event_lock);
+	    return -EBUSY;
+	}
+	xil_digital_waiters++;
+	xil_digital_state = (unsigned short)Wait.dwState;
+    }
+    // A restarted wait keeps its snapshot, so an event during the handler isn't lost
+    if (resume)
+	memcpy(gen, Wait.dwGen, sizeof(gen));
+    else
+	memcpy(gen, xil_event_gen, sizeof(gen));
+    // Arm the hardware only after the snapshot so an immediate interrupt isn't lost
+    if ((Wait.dwEvents & XIL_EVENT_DIGITAL) && !xil_digital_armed)
+    {
+	xil_digital_armed = 1;
+	*((unsigned short*)xil_addr_base + XIL_WAIT_DIGITAL_OFFSET) = ConvertEndian(xil_digital_state);
+    }
+    spin_unlock_irq(&xil_event_lock);
+
+    if (Wait.dwEvents & XIL_EVENT_PART)
+    {
+	pGPIO0->orr = pGPIO0->orr & ~BIT32(DSP_IRQ_LINE_PIN);//tell the DSP we are ready for the tracking interrupt
+	pGPIO0->orr = pGPIO0->orr | BIT32(DSP_IRQ_LINE_PIN);
+    }
+
+    // The deadline is absolute, so a high resolution timer ends the wait on time
+    if (deadline)
+    {
+	hrtimer_init(&timeout.timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	hrtimer_init_sleeper(&timeout, current);
+	timeout.timer.expires = timespec_to_ktime(Wait.tsDeadline);
+	hrtimer_start(&timeout.timer, timeout.timer.expires, HRTIMER_MODE_ABS);
+	if (!hrtimer_active(&timeout.timer))
+	    timeout.task = NULL;
+    }
+    for (;;)
+    {
+	prepare_to_wait(&event_queue, &wait, TASK_INTERRUPTIBLE);
+	fired = xil_events_fired(Wait.dwEvents, gen, &Wait.tsFired);
+	if (fired || (deadline && !timeout.task))
+	    break;
+	if (signal_pending(current))
+	{
+	    ret = -ERESTARTSYS;
+	    break;
+	}
+	schedule();
+    }
+    finish_wait(&event_queue, &wait);
+    if (deadline)
+	hrtimer_cancel(&timeout.timer);
+
+    if (Wait.dwEvents & XIL_EVENT_DIGITAL)
+    {
+	spin_lock_irq(&xil_event_lock);
+	if (!--xil_digital_waiters && xil_digital_armed)
+	{
+	    xil_digital_armed = 0;
+	    *((unsigned short*)xil_addr_base + XIL_WAIT_DIGITAL_OFFSET) = 0;//nobody left, clear the mask
+	}
+	spin_unlock_irq(&xil_event_lock);
+    }
+    if (ret < 0)
+    {
+	Wait.dwEvents |= XIL_EVENT_RESUME;
+	memcpy(Wait.dwGen, gen, sizeof(gen));
+	if (copy_to_user(&uwait->dwEvents, &Wait.dwEvents, sizeof(Wait.dwEvents)) ||
+	    copy_to_user(uwait->dwGen, Wait.dwGen, sizeof(Wait.dwGen)))
+	    return -EFAULT;
+	return ret;
+    }
+    if (resume && put_user(Wait.dwEvents, &uwait->dwEvents))
+	return -EFAULT;
+    if (!fired)
+    {
+	fired = XIL_EVENT_DEADLINE;
+	ktime_get_ts(&Wait.tsFired);
+    }
+    Wait.dwFired = fired;
+    if (copy_to_user(&uwait->dwFired, &Wait.dwFired, sizeof(Wait.dwFired)) ||
+	copy_to_user(&uwait->tsFired, &Wait.tsFired, sizeof(Wait.tsFired)))
+	return -EFAULT;
+    return 0;
+}
+
 static int flyer_xil_ioctl(struct inode* inode, struct file* file, unsigned int cmd, unsigned long arg)
 {
     /*
@@ -855,9 +861,7 @@ static int flyer_xil_ioctl(struct inode* inode, struct file* file, unsigned int
 	return arg;
 	 
     case XIL_WAKE_IO_SLEEPERS: //called by the thread that accepts data from WinMark on an abort.
-	wake_up_interruptible(&io_queue);
-	wake_up_interruptible(&track_queue);
-	
+	xil_wake_io_sleepers();
 	break;
 	
     case XIL_TESTMARK_DONE: //called so that the driver knows the testmark is complete..
@@ -1012,6 +1016,14 @@ static int flyer_xil_ioctl(struct inode* inode, struct file* file, unsigned int
     case XIL_SET_WAIT_DIGITAL://This will cause the calling process to be placed on the IO wait queue...
 	if (xil_addr_base)
 	{
+	    spin_lock_irq(&xil_event_lock);
+	    if (xil_digital_waiters)//XIL_WAIT_EVENTS owns the wait digital register
+	    {
+		spin_unlock_irq(&xil_event_lock);
+		return -EBUSY;
+	    }
+	    xil_digital_legacy++;
+	    spin_unlock_irq(&xil_event_lock);
 	    waitIOSuccess = 0;
 	    Wait = * (waitStruct*)(arg);
 	    if (Wait.iTimeout == 0)//shouldn't happen, but handle it just as well...
@@ -1063,6 +1075,10 @@ static int flyer_xil_ioctl(struct inode* inode, struct file* file, unsigned int
 	    }
 	    set_current_state(TASK_RUNNING);
 	    remove_wait_queue(&io_queue,&wait);
+	    spin_lock_irq(&xil_event_lock);
+	    if (!--xil_digital_legacy)
+		*((unsigned short*)xil_addr_base + XIL_WAIT_DIGITAL_OFFSET) = 0;//don't leave our mask for XIL_WAIT_EVENTS
+	    spin_unlock_irq(&xil_event_lock);
 	    if (waitIOSuccess)
 		return 0;
 	    else
@@ -1165,6 +1181,10 @@ static int flyer_xil_ioctl(struct inode* inode, struct file* file, unsigned int
 	else
 	    arg = -1;
 	return arg;
+    case XIL_WAIT_EVENTS://Arm several conditions at once, see waitEventStruct
+	if (!xil_addr_base)
+	    return -1;
+	return flyer_xil_wait_events((waitEventStruct __user *)arg);
     case XIL_GET_DIODE_PTR:
 	if (xil_addr_base)
 	{
@@ -1213,6 +1233,120 @@ static struct file_operations flyer_xil_fops = {
     release:	        flyer_xil_release,
     };
 
+/*
+ * Quiesce before reboot or kexec: stop the encoder timer and mask the
+ * FPGA and GPT interrupts so nothing fires into the next kernel before
+ * it has installed handlers.  Unless keep_fpga is set, pulse PROGRAM so
+ * the FPGA comes up unconfigured, as it does from a cold boot.
+ */
+static int flyer_xil_reboot(struct notifier_block *nb, unsigned long event,
+			    void *unused)
+{
+    disable_irq(GPT1_IRQ);
+    disable_irq(XILINX_IRQ);
+    setup_encoder_timer(0);
+    *((unsigned short*)xil_addr_base + XIL_WAIT_DIGITAL_OFFSET) = 0x0000;
+
+    if (!keep_fpga)
+    {
+	pGPIO0->orr = pGPIO0->orr & ~XILINX_PROGRAM;
+	udelay(25);
+	pGPIO0->orr = pGPIO0->orr | XILINX_PROGRAM;
+    }
+    return NOTIFY_DONE;
+}
+
+static struct notifier_block flyer_xil_reboot_nb = {
+    .notifier_call = flyer_xil_reboot,
+};
+
+/*-----------------------------Debugfs encoder timing-------------------------------*/
+#ifdef CONFIG_DEBUG_FS
+
+static struct dentry *xil_debugfs_dir, *xil_debugfs_encoder;
+
+static int enc_timing_show(struct seq_file *s, void *unused)
+{
+    unsigned long hist[ENC_HIST], intervals, flags;
+    u32 min, max;
+    u64 mean;
+    int i;
+
+    local_irq_save(flags);
+    intervals = enc_timing.intervals;
+    min = enc_timing.min;
+    max = enc_timing.max;
+    mean = enc_timing.sum;
+    memcpy(hist, enc_timing.hist, sizeof(hist));
+    local_irq_restore(flags);
+
+    seq_printf(s, "timebase       %u ticks/us\n",
+	       tb_ticks_per_jiffy / (1000000 / HZ));
+    seq_printf(s, "intervals      %lu\n", intervals);
+    if (intervals)
+    {
+	do_div(mean, intervals);
+	seq_printf(s, "min/mean/max   %u %llu %u ticks\n", min,
+		   (unsigned long long)mean, max);
+    }
+    seq_printf(s, "change from previous interval, buckets 0, 1, 2-3, 4-7, ... ticks\n");
+    for (i = 0; i < ENC_HIST; i++)
+	seq_printf(s, " %lu", hist[i]);
+    seq_putc(s, '\n');
+    return 0;
+}
+
+static int enc_timing_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, enc_timing_show, inode->i_private);
+}
+
+/* any write clears the statistics */
+static ssize_t enc_timing_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+    unsigned long flags;
+
+    local_irq_save(flags);
+    memset(&enc_timing, 0, sizeof(enc_timing));
+    local_irq_restore(flags);
+    return count;
+}
+
+static const struct file_operations enc_timing_fops = {
+    .owner	= THIS_MODULE,
+    .open	= enc_timing_open,
+    .read	= seq_read,
+    .write	= enc_timing_write,
+    .llseek	= seq_lseek,
+    .release	= single_release,
+};
+
+static void create_debugfs_files(void)
+{
+    xil_debugfs_dir = debugfs_create_dir("flyer_xil", NULL);
+    if (IS_ERR(xil_debugfs_dir) || !xil_debugfs_dir)
+    {
+	xil_debugfs_dir = NULL;
+	return;
+    }
+    xil_debugfs_encoder = debugfs_create_file("encoder", S_IRUGO | S_IWUSR, xil_debugfs_dir,
+					      NULL, &enc_timing_fops);
+}
+
+static void remove_debugfs_files(void)
+{
+    debugfs_remove(xil_debugfs_encoder);
+    debugfs_remove(xil_debugfs_dir);
+}
+
+#else
+
+static inline void create_debugfs_files(void) { }
+static inline void remove_debugfs_files(void) { }
+
+#endif /* CONFIG_DEBUG_FS */
+/*-----------------------------End debugfs encoder timing---------------------------*/
+
 static int __init flyer_xil_init_module(void)
 {
     int res = 0;
@@ -1341,6 +1475,9 @@ static int __init flyer_xil_init_module(void)
     
     init_gpio();
     
+    // The GPT belongs to the encoder; make sure the old LED compare is off
+    pGPT_INT->ie &= ~BIT32(16);
+    
     
     //set_usb_led(SOLID_GREEN);
     
@@ -1354,13 +1491,6 @@ static int __init flyer_xil_init_module(void)
     } 
     
       
-    status = request_irq(GPT0_IRQ, flyer_xil_status_led_interrupt, 0, "flyer_xil",0);
-    if (status) 
-    {
-	printk(KERN_ERR "flyer_xil: IRQ %d status_led_interrupt request failed - status %d!\n", GPT0_IRQ, status);
-	return -EBUSY;
-    } 
-    
     status = request_irq(GPT1_IRQ, flyer_xil_encoder_interrupt, 0, "flyer_xil",0);
     if (status) 
     {
@@ -1370,6 +1500,9 @@ static int __init flyer_xil_init_module(void)
    
     
     *((unsigned short*)xil_addr_base + XIL_IO_CHANGE_OFFSET) = 0;
+    register_reboot_notifier(&flyer_xil_reboot_nb);
+    flyer_register_abort_notifier(&xil_abort_nb);
+    create_debugfs_files();
     printk(KERN_INFO "FlyerII Xilinx driver v%s  %s\n",
 	   XILINX_VERSION, __DATE__);   
     return 0;
@@ -1378,6 +1511,9 @@ static int __init flyer_xil_init_module(void)
 static void __exit flyer_xil_exit_module(void)
 {
     printk( KERN_DEBUG "Module flyer_xil exit\n" );
+    remove_debugfs_files();
+    flyer_unregister_abort_notifier(&xil_abort_nb);
+    unregister_reboot_notifier(&flyer_xil_reboot_nb);
     if (readBuf)
 	kfree(readBuf);
     if (writeBuf)
@@ -1398,6 +1534,7 @@ static irqreturn_t flyer_xil_interrupt(int irq, void *dev_id)
     
     unsigned short int_table = 0;
     unsigned char io_stat;
+    int legacy;
     //if(!enable_main_interrupts)
 	//return IRQ_HANDLED;
     
@@ -1415,15 +1552,24 @@ static irqreturn_t flyer_xil_interrupt(int irq, void *dev_id)
 	interrupt_type = IO_INTERRUPT;
 	int_table &= ~TIMEOUT_INTERRUPT;
 	waitIOSuccess = 1;
+	spin_lock(&xil_event_lock);
+	legacy = xil_digital_legacy;
+	xil_digital_armed = 0;
 	*((unsigned short*)xil_addr_base + XIL_WAIT_DIGITAL_OFFSET) = 0;//clear the mask!
+	spin_unlock(&xil_event_lock);
 	wake_up_interruptible(&io_queue);//wake up the waiting process(es)
+	if (!legacy)//the mask was XIL_WAIT_EVENTS'
+	    xil_post_event(XIL_EVENT_DIGITAL);
     }
     if ( (int_table & TIMEOUT_INTERRUPT) )
     {
 	//printk("TIMEOUT_INTERRUPT\n");
 	waitIOSuccess = 0;
 	interrupt_type = TIMEOUT_INTERRUPT;
+	spin_lock(&xil_event_lock);
+	xil_digital_armed = 0;
 	*((unsigned short*)xil_addr_base + XIL_WAIT_DIGITAL_OFFSET) = 0;//clear the mask!
+	spin_unlock(&xil_event_lock);
 	wake_up_interruptible(&io_queue);//wake up the waiting process(es)
     }
     if ( (int_table & TRACK_INTERRUPT) )
@@ -1431,6 +1577,7 @@ static irqreturn_t flyer_xil_interrupt(int irq, void *dev_id)
 	//printk("TRACK_INTERRUPT\n");
 	interrupt_type = TRACK_INTERRUPT;
 	wake_up_interruptible(&track_queue);//wake up the waiting process(es)
+	xil_post_event(XIL_EVENT_PART);
     }
     
     if (int_table & KEY_INTERRUPT)
@@ -1478,6 +1625,7 @@ static irqreturn_t flyer_xil_interrupt(int irq, void *dev_id)
 	io_stat = *((unsigned char*)xil_addr_base + XIL_SWITCHES);
 	//printk("ABORT_INTERRUPT\n");
 	interrupt_type = ABORT_INTERRUPT;
+	xil_post_event(XIL_EVENT_ABORT);
 	//printk("Got Abort %x  : %d  :%x\n",int_table, SIG_IOCHANGE, io_stat);
 	if (main_pid)
 	    kill_proc(main_pid,SIG_IOCHANGE,1);
@@ -0,0 +1,511 @@
+/*
+ * n_cmd.c - line discipline for framed serial command channels
+ *
+ * Collects received bytes into commands ending in a delimiter byte and
+ * hands them to userspace one per read(), each stamped with the time
+ * its delimiter arrived.  CMDIOCBULKREAD returns every queued command,
+ * with its stamp, in a single call.  See <linux/n_cmd.h>.
+ *
+ * Stamps are taken in receive_buf.  Normally that runs from the tty
+ * flip work, up to a tick after the interrupt.  With ASYNC_LOW_LATENCY
+ * set on the port ("setserial /dev/ttyS1 low_latency") it runs straight
+ * from the receive interrupt, so the reader is woken and the stamp taken
+ * there; 8250 ports also drop their receive FIFO trigger to one byte.
+ *
+ * The completed commands sit in a fixed ring of nframes slots of
+ * maxframe bytes.  When the ring is full, new commands are dropped.
+ *
+ * This software may be used and distributed according to the terms of
+ * the GNU General Public License, incorporated herein by reference.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/types.h>
+#include <linux/fcntl.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/errno.h>
+#include <linux/string.h>
+#include <linux/mutex.h>
+#include <linux/n_cmd.h>
+
+#include <asm/uaccess.h>
+
+#define N_CMD_MAGIC	0x4e43
+
+static int maxframe = 256;
+static int nframes = 32;
+
+struct n_cmd_frame {
+	struct timespec	stamp;
+	unsigned int	len;
+	unsigned int	flags;
+	unsigned char	data[0];
+};
+
+struct n_cmd {
+	int			magic;
+	struct tty_struct	*tty;
+	spinlock_t		lock;
+	struct mutex		read_mutex;	/* one reader owns the tail */
+	unsigned char		delim;
+	/* slot indices, 0 .. nframes - 1 */
+	unsigned int		head;		/* slot being filled */
+	unsigned int		tail;		/* oldest complete command */
+	unsigned int		frame_size;	/* bytes per slot */
+	unsigned long		dropped;
+	struct timespec		last_stamp;	/* of the last read() */
+	unsigned char		*ring;
+};
+
+static inline struct n_cmd_frame *n_cmd_slot(struct n_cmd *n, unsigned int i)
+{
+	return (struct n_cmd_frame *)(n->ring + i * n->frame_size);
+}
+
+static inline unsigned int n_cmd_next(unsigned int i)
+{
+	return i + 1 < nframes ? i + 1 : 0;
+}
+
+/* complete commands in the ring */
+static inline unsigned int n_cmd_queued(struct n_cmd *n)
+{
+	if (n->head >= n->tail)
+		return n->head - n->tail;
+	return n->head + nframes - n->tail;
+}
+
+static inline int n_cmd_avail(struct n_cmd *n)
+{
+	return n->head != n->tail;
+}
+
+static void n_cmd_reset(struct n_cmd *n)
+{
+	struct n_cmd_frame *f;
+
+	n->head = n->tail = 0;
+	f = n_cmd_slot(n, 0);
+	f->len = 0;
+	f->flags = 0;
+}
+
+static int n_cmd_open(struct tty_struct *tty)
+{
+	struct n_cmd *n;
+
+	if (tty->disc_data)
+		return -EEXIST;
+
+	n = kzalloc(sizeof(*n), GFP_KERNEL);
+	if (!n)
+		return -ENOMEM;
+
+	n->frame_size = ALIGN(sizeof(struct n_cmd_frame) + maxframe,
+			      sizeof(long));
+	n->ring = kmalloc(n->frame_size * nframes, GFP_KERNEL);
+	if (!n->ring) {
+		kfree(n);
+		return -ENOMEM;
+	}
+
+	n->magic = N_CMD_MAGIC;
+	n->tty = tty;
+	n->delim = '\r';
+	spin_lock_init(&n->lock);
+	mutex_init(&n->read_mutex);
+	n_cmd_reset(n);
+
+	tty->disc_data = n;
+	/* We never throttle; a full ring drops commands instead */
+	tty->receive_room = 65536;
+
+	if (tty->driver->flush_buffer)
+		tty->driver->flush_buffer(tty);
+
+	return 0;
+}
+
+static void n_cmd_close(struct tty_struct *tty)
+{
+	struct n_cmd *n = tty->disc_data;
+
+	if (!n || n->magic != N_CMD_MAGIC)
+		return;
+
+	tty->disc_data = NULL;
+	if (n->dropped)
+		printk(KERN_INFO "n_cmd: %s: %lu commands dropped\n",
+		       tty->name, n->dropped);
+	kfree(n->ring);
+	kfree(n);
+}
+
+static void n_cmd_flush_buffer(struct tty_struct *tty)
+{
+	struct n_cmd *n = tty->disc_data;
+	unsigned long flags;
+
+	if (!n)
+		return;
+
+	spin_lock_irqsave(&n->lock, flags);
+	n_cmd_reset(n);
+	spin_unlock_irqrestore(&n->lock, flags);
+}
+
+static ssize_t n_cmd_chars_in_buffer(struct tty_struct *tty)
+{
+	struct n_cmd *n = tty->disc_data;
+	unsigned long flags;
+	unsigned int i;
+	ssize_t count = 0;
+
+	if (!n)
+		return 0;
+
+	spin_lock_irqsave(&n->lock, flags);
+	for (i = n->tail; i != n->head; i = n_cmd_next(i))
+		count += n_cmd_slot(n, i)->len;
+	spin_unlock_irqrestore(&n->lock, flags);
+	return count;
+}
+
+/*
+ * Called from the flip work, or from the receive interrupt in low
+ * latency mode.  The head slot is ours; the tail is only moved by
+ * readers, which never touch the head slot.
+ */
+static void n_cmd_receive_buf(struct tty_struct *tty, const unsigned char *cp,
+			      char *fp, int count)
+{
+	struct n_cmd *n = tty->disc_data;
+	struct n_cmd_frame *f;
+	unsigned long flags;
+	int i, wake = 0;
+
+	if (!n || n->magic != N_CMD_MAGIC)
+		return;
+
+	spin_lock_irqsave(&n->lock, flags);
+	f = n_cmd_slot(n, n->head);
+	for (i = 0; i < count; i++) {
+		if (fp && fp[i] != TTY_NORMAL) {
+			f->flags |= CMD_FRAME_ERROR;
+			continue;
+		}
+		if (f->len < maxframe)
+			f->data[f->len++] = cp[i];
+		else
+			f->flags |= CMD_FRAME_TRUNCATED;
+		if (cp[i] != n->delim)
+			continue;
+
+		if (n_cmd_queued(n) >= nframes - 1) {
+			n->dropped++;
+		} else {
+			ktime_get_ts(&f->stamp);
+			n->head = n_cmd_next(n->head);
+			wake = 1;
+		}
+		f = n_cmd_slot(n, n->head);
+		f->len = 0;
+		f->flags = 0;
+	}
+	spin_unlock_irqrestore(&n->lock, flags);
+
+	if (wake) {
+		wake_up_interruptible(&tty->read_wait);
+		kill_fasync(&tty->fasync, SIGIO, POLL_IN);
+	}
+}
+
+/*
+ * Wait for a complete command.  Called with read_mutex held, which is
+ * dropped while sleeping.
+ */
+static int n_cmd_wait(struct n_cmd *n, struct tty_struct *tty,
+		      struct file *file)
+{
+	int ret;
+
+	while (!n_cmd_avail(n)) {
+		if (test_bit(TTY_OTHER_CLOSED, &tty->flags) ||
+		    tty_hung_up_p(file))
+			return -EIO;
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		mutex_unlock(&n->read_mutex);
+		ret = wait_event_interruptible(tty->read_wait,
+				n_cmd_avail(n) ||
+				test_bit(TTY_OTHER_CLOSED, &tty->flags) ||
+				tty_hung_up_p(file));
+		mutex_lock(&n->read_mutex);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static void n_cmd_consume(struct n_cmd *n, struct n_cmd_frame *f)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&n->lock, flags);
+	n->last_stamp = f->stamp;
+	/* A flush while we copied may have emptied the ring */
+	if (n_cmd_avail(n))
+		n->tail = n_cmd_next(n->tail);
+	spin_unlock_irqrestore(&n->lock, flags);
+}
+
+static ssize_t n_cmd_read(struct tty_struct *tty, struct file *file,
+			  unsigned char __user *buf, size_t nr)
+{
+	struct n_cmd *n = tty->disc_data;
+	struct n_cmd_frame *f;
+	ssize_t ret;
+
+	if (!n || n->magic != N_CMD_MAGIC)
+		return -EIO;
+
+	if (mutex_lock_interruptible(&n->read_mutex))
+		return -ERESTARTSYS;
+
+	ret = n_cmd_wait(n, tty, file);
+	if (ret)
+		goto out;
+
+	f = n_cmd_slot(n, n->tail);
+	if (f->len > nr)
+		/* Command too large for caller's buffer (discard it) */
+		ret = -EOVERFLOW;
+	else if (copy_to_user(buf, f->data, f->len))
+		ret = -EFAULT;
+	else
+		ret = f->len;
+	n_cmd_consume(n, f);
+out:
+	mutex_unlock(&n->read_mutex);
+	return ret;
+}
+
+/*
+ * Copy out as many queued commands as fit in the caller's buffer, at
+ * least one.  Returns the number of bytes used.
+ */
+static int n_cmd_bulk_read(struct n_cmd *n, struct tty_struct *tty,
+			   struct file *file, struct cmd_bulk_read __user *arg)
+{
+	struct cmd_bulk_read req;
+	struct cmd_frame_hdr hdr;
+	struct n_cmd_frame *f;
+	char __user *p;
+	size_t rec, used = 0;
+	int ret;
+
+	if (copy_from_user(&req, arg, sizeof(req)))
+		return -EFAULT;
+	p = req.buf;
+	req.frames = 0;
+
+	if (mutex_lock_interruptible(&n->read_mutex))
+		return -ERESTARTSYS;
+
+	ret = n_cmd_wait(n, tty, file);
+	if (ret)
+		goto out;
+
+	while (n_cmd_avail(n)) {
+		f = n_cmd_slot(n, n->tail);
+		rec = ALIGN(sizeof(hdr) + f->len, CMD_FRAME_ALIGN);
+		if (used + rec > req.size) {
+			if (!req.frames)
+				ret = -EOVERFLOW;
+			break;
+		}
+
+		hdr.stamp = f->stamp;
+		hdr.len = f->len;
+		hdr.flags = f->flags;
+		if (copy_to_user(p + used, &hdr, sizeof(hdr)) ||
+		    copy_to_user(p + used + sizeof(hdr), f->data, f->len)) {
+			ret = -EFAULT;
+			break;
+		}
+		n_cmd_consume(n, f);
+		used += rec;
+		req.frames++;
+	}
+
+	if (req.frames) {
+		if (put_user(req.frames, &arg->frames))
+			ret = -EFAULT;
+		else
+			ret = used;
+	}
+out:
+	mutex_unlock(&n->read_mutex);
+	return ret;
+}
+
+static ssize_t n_cmd_write(struct tty_struct *tty, struct file *file,
+			   const unsigned char *buf, size_t nr)
+{
+	DECLARE_WAITQUEUE(wait, current);
+	const unsigned char *b = buf;
+	ssize_t ret = 0;
+	int c;
+
+	add_wait_queue(&tty->write_wait, &wait);
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (signal_pending(current)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		if (tty_hung_up_p(file)) {
+			ret = -EIO;
+			break;
+		}
+		c = tty->driver->write(tty, b, nr);
+		if (c < 0) {
+			ret = c;
+			break;
+		}
+		b += c;
+		nr -= c;
+		if (!nr)
+			break;
+		if (file->f_flags & O_NONBLOCK) {
+			ret = -EAGAIN;
+			break;
+		}
+		schedule();
+	}
+	__set_current_state(TASK_RUNNING);
+	remove_wait_queue(&tty->write_wait, &wait);
+
+	return b - buf ? b - buf : ret;
+}
+
+static int n_cmd_ioctl(struct tty_struct *tty, struct file *file,
+		       unsigned int cmd, unsigned long arg)
+{
+	struct n_cmd *n = tty->disc_data;
+	void __user *argp = (void __user *)arg;
+	unsigned long flags;
+	struct timespec ts;
+	int val;
+
+	if (!n || n->magic != N_CMD_MAGIC)
+		return -EBADF;
+
+	switch (cmd) {
+	case FIONREAD:
+		/* Size of the next command, if any */
+		spin_lock_irqsave(&n->lock, flags);
+		val = n_cmd_avail(n) ? n_cmd_slot(n, n->tail)->len : 0;
+		spin_unlock_irqrestore(&n->lock, flags);
+		return put_user(val, (int __user *)argp);
+
+	case CMDIOCGSTAMP:
+		spin_lock_irqsave(&n->lock, flags);
+		ts = n->last_stamp;
+		spin_unlock_irqrestore(&n->lock, flags);
+		return copy_to_user(argp, &ts, sizeof(ts)) ? -EFAULT : 0;
+
+	case CMDIOCGDELIM:
+		return put_user(n->delim, (int __user *)argp);
+
+	case CMDIOCSDELIM:
+		if (get_user(val, (int __user *)argp))
+			return -EFAULT;
+		if (val & ~0xff)
+			return -EINVAL;
+		n->delim = val;
+		return 0;
+
+	case CMDIOCBULKREAD:
+		return n_cmd_bulk_read(n, tty, file, argp);
+
+	default:
+		return n_tty_ioctl(tty, file, cmd, arg);
+	}
+}
+
+static unsigned int n_cmd_poll(struct tty_struct *tty, struct file *file,
+			       poll_table *wait)
+{
+	struct n_cmd *n = tty->disc_data;
+	unsigned int mask = 0;
+
+	if (!n || n->magic != N_CMD_MAGIC)
+		return POLLERR;
+
+	poll_wait(file, &tty->read_wait, wait);
+	poll_wait(file, &tty->write_wait, wait);
+
+	if (n_cmd_avail(n))
+		mask |= POLLIN | POLLRDNORM;
+	if (test_bit(TTY_OTHER_CLOSED, &tty->flags) || tty_hung_up_p(file))
+		mask |= POLLHUP;
+	if (tty->driver->write_room(tty) > 0)
+		mask |= POLLOUT | POLLWRNORM;
+	return mask;
+}
+
+static struct tty_ldisc n_cmd_ldisc = {
+	.owner		 = THIS_MODULE,
+	.magic		 = TTY_LDISC_MAGIC,
+	.name		 = "n_cmd",
+	.open		 = n_cmd_open,
+	.close		 = n_cmd_close,
+	.flush_buffer	 = n_cmd_flush_buffer,
+	.chars_in_buffer = n_cmd_chars_in_buffer,
+	.read		 = n_cmd_read,
+	.write		 = n_cmd_write,
+	.ioctl		 = n_cmd_ioctl,
+	.poll		 = n_cmd_poll,
+	.receive_buf	 = n_cmd_receive_buf,
+};
+
+static int __init n_cmd_init(void)
+{
+	int status;
+
+	maxframe = min(max(maxframe, 16), 65535);
+	nframes = min(max(nframes, 2), 1024);
+
+	status = tty_register_ldisc(N_CMD, &n_cmd_ldisc);
+	if (status)
+		printk(KERN_ERR "n_cmd: can't register line discipline "
+		       "(err = %d)\n", status);
+	return status;
+}
+
+static void __exit n_cmd_exit(void)
+{
+	int status = tty_unregister_ldisc(N_CMD);
+
+	if (status)
+		printk(KERN_ERR "n_cmd: can't unregister line discipline "
+		       "(err = %d)\n", status);
+}
+
+module_init(n_cmd_init);
+module_exit(n_cmd_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Framed serial command line discipline");
+module_param(maxframe, int, 0);
+MODULE_PARM_DESC(maxframe, "Longest command kept, in bytes");
+module_param(nframes, int, 0);
+MODULE_PARM_DESC(nframes, "Commands queued before new ones are dropped");
+MODULE_ALIAS_LDISC(N_CMD);
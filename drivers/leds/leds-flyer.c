@@ -0,0 +1,306 @@
+/*
+ * LEDs driver for the Synrad Flyer II (AMCC 440EP)
+ *
+ * The Flyer has two bicolour LEDs, "status" and "usb", each wired to a
+ * red and a green GPIO.  Blinking used to be driven from a GPT compare
+ * interrupt inside the Xilinx driver, sharing the GPT interrupt status
+ * with the encoder pulse timer.  Here it is done from kernel timers
+ * through three LED triggers, which leaves the GPT to the encoder:
+ *
+ *   "marking"      - blinks while the marking application asks for it
+ *   "fault"        - blinks or lights for fault conditions
+ *   "usb-activity" - flashes on Flyer USB gadget traffic
+ *
+ * Kernel timers run off the decrementer, so the blink rates (at most
+ * 10 Hz) need no timer of their own; the 440EP's only other general
+ * purpose timer is the GPT this driver frees for the encoder.
+ *
+ * The USB LED shows the connection state set with XIL_LED_SET_USB, so
+ * "usb-activity" is not its default trigger; select it from
+ * /sys/class/leds/flyer:green:usb/trigger to see traffic instead.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/leds.h>
+#include <linux/timer.h>
+#include <linux/jiffies.h>
+#include <linux/err.h>
+#include <asm/io.h>
+#include <asm/Flyer_Xilinx.h>
+#include <asm/FlyerII.h>
+
+#define DRVNAME "flyer-led"
+
+#define USB_RED_LINE		BIT32(26)	/* GPIO 0 */
+#define USB_GREEN_LINE		BIT32(28)	/* GPIO 0 */
+#define STAT_RED_LINE		BIT32(15)	/* GPIO 1 */
+#define STAT_GREEN_LINE		BIT32(16)	/* GPIO 1 */
+
+static struct platform_device *pdev;
+static pAMCC440EP_GPIO __iomem gpio0;
+static pAMCC440EP_GPIO __iomem gpio1;
+
+struct flyer_led {
+	struct led_classdev	cdev;
+	pAMCC440EP_GPIO		*gpio;		/* &gpio0 or &gpio1 */
+	u32			line;
+};
+
+/*
+ * The output registers are shared with the Xilinx driver, which also
+ * touches them from interrupt context, so do the read-modify-write with
+ * interrupts off.
+ */
+static void flyer_led_set(struct led_classdev *led_cdev,
+			  enum led_brightness value)
+{
+	struct flyer_led *led = container_of(led_cdev, struct flyer_led, cdev);
+	pAMCC440EP_GPIO gpio = *led->gpio;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	if (value)
+		gpio->orr = gpio->orr | led->line;
+	else
+		gpio->orr = gpio->orr & ~led->line;
+	local_irq_restore(flags);
+}
+
+static struct flyer_led flyer_leds[] = {
+	{
+		.cdev = {
+			.name		 = "flyer:green:status",
+			.brightness_set	 = flyer_led_set,
+			.default_trigger = "marking",
+		},
+		.gpio = &gpio1,
+		.line = STAT_GREEN_LINE,
+	},
+	{
+		.cdev = {
+			.name		 = "flyer:red:status",
+			.brightness_set	 = flyer_led_set,
+			.default_trigger = "fault",
+		},
+		.gpio = &gpio1,
+		.line = STAT_RED_LINE,
+	},
+	{
+		.cdev = {
+			.name		 = "flyer:green:usb",
+			.brightness_set	 = flyer_led_set,
+		},
+		.gpio = &gpio0,
+		.line = USB_GREEN_LINE,
+	},
+	{
+		.cdev = {
+			.name		 = "flyer:red:usb",
+			.brightness_set	 = flyer_led_set,
+		},
+		.gpio = &gpio0,
+		.line = USB_RED_LINE,
+	},
+};
+
+#define FLYER_LED_GREEN_USB	2
+#define FLYER_LED_RED_USB	3
+
+/*
+ * Blinking triggers.  hz follows the old XIL_LED_SET_STATUS encoding:
+ * the LED changes state hz times a second, 0 turns it off and a
+ * negative value lights it solid.
+ */
+struct flyer_blink {
+	struct led_trigger	*trig;
+	struct timer_list	timer;
+	unsigned long		period;
+	int			on;
+};
+
+static void flyer_blink_timerfunc(unsigned long data)
+{
+	struct flyer_blink *b = (struct flyer_blink *)data;
+
+	b->on = !b->on;
+	led_trigger_event(b->trig, b->on ? LED_FULL : LED_OFF);
+	mod_timer(&b->timer, jiffies + b->period);
+}
+
+static void flyer_blink_set(struct flyer_blink *b, int hz)
+{
+	del_timer_sync(&b->timer);
+	if (hz <= 0) {
+		b->on = hz < 0;
+		led_trigger_event(b->trig, b->on ? LED_FULL : LED_OFF);
+		return;
+	}
+	b->period = max(HZ / hz, 1);
+	if (!b->on) {
+		b->on = 1;
+		led_trigger_event(b->trig, LED_FULL);
+	}
+	mod_timer(&b->timer, jiffies + b->period);
+}
+
+static struct flyer_blink marking_blink;
+static struct flyer_blink fault_blink;
+
+void flyer_led_marking(int hz)
+{
+	flyer_blink_set(&marking_blink, hz);
+}
+EXPORT_SYMBOL(flyer_led_marking);
+
+void flyer_led_fault(int hz)
+{
+	flyer_blink_set(&fault_blink, hz);
+}
+EXPORT_SYMBOL(flyer_led_fault);
+
+/* Activity flash, same scheme as the ide-disk trigger */
+DEFINE_LED_TRIGGER(usb_trigger);
+static void flyer_usb_timerfunc(unsigned long data);
+static DEFINE_TIMER(flyer_usb_timer, flyer_usb_timerfunc, 0, 0);
+static int usb_activity;
+static int usb_lastactivity;
+
+void flyer_led_usb_activity(void)
+{
+	usb_activity++;
+	if (!timer_pending(&flyer_usb_timer))
+		mod_timer(&flyer_usb_timer, jiffies + msecs_to_jiffies(10));
+}
+EXPORT_SYMBOL(flyer_led_usb_activity);
+
+static void flyer_usb_timerfunc(unsigned long data)
+{
+	if (usb_lastactivity != usb_activity) {
+		usb_lastactivity = usb_activity;
+		led_trigger_event(usb_trigger, LED_FULL);
+		mod_timer(&flyer_usb_timer, jiffies + msecs_to_jiffies(10));
+	} else {
+		led_trigger_event(usb_trigger, LED_OFF);
+	}
+}
+
+/* Solid colour for the USB LED, XIL_LED_SET_USB encoding */
+void flyer_led_set_usb(int state)
+{
+	flyer_led_set(&flyer_leds[FLYER_LED_GREEN_USB].cdev,
+		      (state & SOLID_GREEN) ? LED_FULL : LED_OFF);
+	flyer_led_set(&flyer_leds[FLYER_LED_RED_USB].cdev,
+		      (state & SOLID_RED) ? LED_FULL : LED_OFF);
+}
+EXPORT_SYMBOL(flyer_led_set_usb);
+
+static void flyer_blink_init(struct flyer_blink *b, const char *name)
+{
+	setup_timer(&b->timer, flyer_blink_timerfunc, (unsigned long)b);
+	led_trigger_register_simple(name, &b->trig);
+}
+
+static void flyer_blink_exit(struct flyer_blink *b)
+{
+	del_timer_sync(&b->timer);
+	led_trigger_unregister_simple(b->trig);
+}
+
+static int flyer_led_probe(struct platform_device *pdev)
+{
+	int i, ret;
+
+	for (i = 0; i < ARRAY_SIZE(flyer_leds); i++) {
+		ret = led_classdev_register(&pdev->dev, &flyer_leds[i].cdev);
+		if (ret < 0)
+			goto err;
+	}
+	return 0;
+
+err:
+	while (--i >= 0)
+		led_classdev_unregister(&flyer_leds[i].cdev);
+	return ret;
+}
+
+static int flyer_led_remove(struct platform_device *pdev)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(flyer_leds); i++)
+		led_classdev_unregister(&flyer_leds[i].cdev);
+	return 0;
+}
+
+static struct platform_driver flyer_led_driver = {
+	.probe		= flyer_led_probe,
+	.remove		= flyer_led_remove,
+	.driver		= {
+		.name		= DRVNAME,
+		.owner		= THIS_MODULE,
+	},
+};
+
+static int __init flyer_led_init(void)
+{
+	int ret;
+
+	gpio0 = ioremap(GPIO_0_PHYS_START, GPIO_0_PHYS_END - GPIO_0_PHYS_START + 1);
+	gpio1 = ioremap(GPIO_1_PHYS_START, GPIO_1_PHYS_END - GPIO_1_PHYS_START + 1);
+	if (!gpio0 || !gpio1) {
+		ret = -ENOMEM;
+		goto out_unmap;
+	}
+
+	flyer_blink_init(&marking_blink, "marking");
+	flyer_blink_init(&fault_blink, "fault");
+	led_trigger_register_simple("usb-activity", &usb_trigger);
+
+	ret = platform_driver_register(&flyer_led_driver);
+	if (ret < 0)
+		goto out_trig;
+
+	pdev = platform_device_register_simple(DRVNAME, -1, NULL, 0);
+	if (IS_ERR(pdev)) {
+		ret = PTR_ERR(pdev);
+		platform_driver_unregister(&flyer_led_driver);
+		goto out_trig;
+	}
+	return 0;
+
+out_trig:
+	led_trigger_unregister_simple(usb_trigger);
+	flyer_blink_exit(&fault_blink);
+	flyer_blink_exit(&marking_blink);
+out_unmap:
+	if (gpio1)
+		iounmap(gpio1);
+	if (gpio0)
+		iounmap(gpio0);
+	return ret;
+}
+
+static void __exit flyer_led_exit(void)
+{
+	platform_device_unregister(pdev);
+	platform_driver_unregister(&flyer_led_driver);
+	del_timer_sync(&flyer_usb_timer);
+	led_trigger_unregister_simple(usb_trigger);
+	flyer_blink_exit(&fault_blink);
+	flyer_blink_exit(&marking_blink);
+	iounmap(gpio1);
+	iounmap(gpio0);
+}
+
+module_init(flyer_led_init);
+module_exit(flyer_led_exit);
+
+MODULE_DESCRIPTION("Flyer II status and USB LED driver");
+MODULE_LICENSE("GPL");
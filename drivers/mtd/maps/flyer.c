@@ -158,7 +158,8 @@ static void __exit cleanup_flyer_flash(void)
 	
 }
 
-module_init(init_flyer_flash);
+/* CFI probing of both windows is slow; nothing but the root mount needs it */
+async_initcall(init_flyer_flash);
 module_exit(cleanup_flyer_flash);
 
 MODULE_LICENSE("GPL");
@@ -1870,6 +1870,28 @@ static void emac_remove(struct ocp_device *ocpdev)
 	kfree(dev->ndev);
 }
 
+/* Stop DMA so a kexec'd kernel doesn't get its memory scribbled on */
+static void emac_shutdown(struct ocp_device *ocpdev)
+{
+	struct ocp_enet_private *dev = ocp_get_drvdata(ocpdev);
+	struct ocp_func_emac_data *emacdata;
+
+	if (!dev)
+		return;
+
+	DBG("%d: shutdown" NL, dev->def->index);
+
+	if (dev->phy.address >= 0)
+		del_timer_sync(&dev->link_timer);
+
+	emacdata = dev->def->additions;
+	netif_device_detach(dev->ndev);
+	emac_rx_disable(dev);
+	emac_tx_disable(dev);
+	mal_disable_rx_channel(dev->mal, emacdata->mal_rx_chan);
+	mal_disable_tx_channel(dev->mal, emacdata->mal_tx_chan);
+}
+
 static struct mal_commac_ops emac_commac_ops = {
 	.poll_tx = &emac_poll_tx,
 	.poll_rx = &emac_poll_rx,
@@ -2612,6 +2634,7 @@ static struct ocp_driver emac_driver = {
 	.id_table = emac_ids,
 	.probe = emac_probe,
 	.remove = emac_remove,
+	.shutdown = emac_shutdown,
 };
 
 static int __init emac_init(void)
@@ -2651,5 +2674,5 @@ static void __exit emac_exit(void)
 	emac_fini_debug();
 }
 
-module_init(emac_init);
+async_initcall(emac_init);
 module_exit(emac_exit);
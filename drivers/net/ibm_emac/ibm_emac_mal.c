@@ -602,6 +602,18 @@ static void __exit mal_remove(struct ocp_device *ocpdev)
 	kfree(mal);
 }
 
+static void mal_shutdown(struct ocp_device *ocpdev)
+{
+	struct ibm_ocp_mal *mal = ocp_get_drvdata(ocpdev);
+
+	if (!mal)
+		return;
+
+	MAL_DBG("%d: shutdown" NL, mal->def->index);
+
+	mal_reset(mal);
+}
+
 /* Structure for a device driver */
 static struct ocp_device_id mal_ids[] = {
 	{ .vendor = OCP_VENDOR_IBM, .function = OCP_FUNC_MAL },
@@ -614,6 +626,7 @@ static struct ocp_driver mal_driver = {
 
 	.probe = mal_probe,
 	.remove = mal_remove,
+	.shutdown = mal_shutdown,
 };
 
 int __init mal_init(void)
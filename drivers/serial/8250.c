@@ -2201,7 +2201,12 @@ serial8250_set_termios(struct uart_port *port, struct ktermios *termios,
 		quot ++;
 
 	if (up->capabilities & UART_CAP_FIFO && up->port.fifosize > 1) {
-		if (baud < 2400)
+		/*
+		 * A low latency port wants each byte as it arrives rather
+		 * than after the trigger level or the receive timeout of
+		 * four character times.
+		 */
+		if (baud < 2400 || (up->port.flags & UPF_LOW_LATENCY))
 			fcr = UART_FCR_ENABLE_FIFO | UART_FCR_TRIGGER_1;
 		else
 			fcr = uart_config[up->port.type].fcr;
@@ -826,6 +826,9 @@ static int uart_set_info(struct uart_state *state,
 				       tty_name(state->info->tty, buf));
 			}
 			uart_change_speed(state, NULL);
+		} else if ((old_flags ^ port->flags) & UPF_LOW_LATENCY) {
+			/* Let the driver retune its receive FIFO */
+			uart_change_speed(state, NULL);
 		}
 	} else
 		retval = uart_startup(state, 1);
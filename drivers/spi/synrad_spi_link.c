@@ -26,6 +26,10 @@
 #include <linux/module.h>
 #include <asm/uaccess.h>
 #include <linux/delay.h>
+#include <linux/vmalloc.h>
+#include <linux/spinlock.h>
+#include <linux/log2.h>
+#include <linux/ktime.h>
 
 #include <linux/spi/synrad_spi.h>
 #include <asm/Flyer_Xilinx.h>
@@ -88,6 +92,18 @@ char* readBuf;
 char* writeBuf;
 void* xil_addr;
 
+/* Per-axis servo status rings, see <linux/spi/synrad_spi.h> */
+static unsigned int status_ring = 4096;
+module_param(status_ring, uint, S_IRUGO);
+MODULE_PARM_DESC(status_ring, "Status records kept per axis");
+
+struct spi_status_log {
+    struct spi_status_ring *ring;	/* vmalloc_user(), mmap()able */
+    unsigned int nr;
+    spinlock_t lock;			/* writers */
+};
+static struct spi_status_log status_log[NR_SPI_DEVICES];
+
 /* Allocate a single SPI transfer descriptor.  We're assuming that if multiple
    SPI transfers occur at the same time, spi_access_bus() will serialize them.
    If this is not valid, then either (i) each dataflash 'priv' structure
@@ -201,6 +217,107 @@ void spi_release_bus(short device)
 	
 }
 
+/*
+ * Append a frame's status to the axis' ring.  The slot's seq is set
+ * first and head last, so a reader that finds seq unchanged after
+ * copying a record knows it was not overwritten meanwhile.
+ */
+static void spi_status_log_frame(int minor, unsigned short status, unsigned short xil)
+{
+    struct spi_status_log *log;
+    struct spi_status_ring *ring;
+    struct spi_servo_status *rec;
+    struct timespec ts;
+    u32 seq;
+
+    if (minor < iDev2 || minor > iDev3)
+	return;
+    log = &status_log[minor - iDev2];
+    ring = log->ring;
+    if (!ring)
+	return;
+    ktime_get_ts(&ts);
+    spin_lock(&log->lock);
+    seq = ring->head;
+    rec = &ring->rec[seq & (log->nr - 1)];
+    rec->seq = seq;
+    smp_wmb();
+    rec->status = status;
+    rec->xil = xil;
+    rec->tv_sec = ts.tv_sec;
+    rec->tv_nsec = ts.tv_nsec;
+    smp_wmb();
+    ring->head = seq + 1;
+    spin_unlock(&log->lock);
+}
+
+/* SPI_STATUS_READ: copy out records in batches, never faulting under the lock */
+static int spi_status_read(int minor, struct spi_status_read __user *ureq)
+{
+    struct spi_status_log *log = &status_log[minor - iDev2];
+    struct spi_servo_status batch[32];
+    struct spi_status_read req;
+    u32 seq, head, done = 0;
+    unsigned int n, i;
+
+    if (!log->ring)
+	return -ENODEV;
+    if (copy_from_user(&req, ureq, sizeof(req)))
+	return -EFAULT;
+
+    spin_lock(&log->lock);
+    head = log->ring->head;
+    /* start at the oldest record still held if 'from' is gone or in the future */
+    seq = req.from;
+    if (head - seq > log->nr)
+	seq = head - min(head, log->nr);
+    spin_unlock(&log->lock);
+    req.from = seq;
+
+    while (done < req.count)
+    {
+	spin_lock(&log->lock);
+	head = log->ring->head;
+	if (head - seq > log->nr)	/* overtaken while we copied */
+	    seq = head - log->nr;
+	if (!done)
+	    req.from = seq;
+	n = min(min(req.count - done, head - seq), (u32)ARRAY_SIZE(batch));
+	for (i = 0; i < n; i++)
+	    batch[i] = log->ring->rec[(seq + i) & (log->nr - 1)];
+	spin_unlock(&log->lock);
+
+	if (!n)
+	    break;
+	if (copy_to_user(req.buf + done, batch, n * sizeof(batch[0])))
+	    return -EFAULT;
+	done += n;
+	seq += n;
+    }
+
+    req.count = done;
+    req.next = seq;
+    if (copy_to_user(ureq, &req, sizeof(req)))
+	return -EFAULT;
+    return done;
+}
+
+static int spi_link_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    int minor = *((int*)file->private_data);
+    struct spi_status_log *log;
+
+    if (minor < iDev2 || minor > iDev3)
+	return -ENODEV;
+    log = &status_log[minor - iDev2];
+    if (!log->ring)
+	return -ENODEV;
+    if (vma->vm_flags & VM_WRITE)
+	return -EPERM;
+    vma->vm_flags &= ~VM_MAYWRITE;
+    return remap_vmalloc_range(vma, log->ring, vma->vm_pgoff);
+}
+
 //read is used for the asynchronous write
 static ssize_t spi_link_read(struct file* file, char* buf, size_t count, loff_t *offset)
 {
@@ -264,6 +381,7 @@ static ssize_t spi_link_read(struct file* file, char* buf, size_t count, loff_t
 	m_iStatus = ((int)xil << 16) + (temp & 0xffff);
     else if (minor == iDev3)
 	m_iZStatus = ((int)xil << 16) + (temp & 0xffff);
+    spi_status_log_frame(minor, temp & 0xffff, xil);
 
      ret = (ssize_t)( (int)xil << 16);
 
@@ -339,6 +457,7 @@ static ssize_t spi_link_write(struct file* file, const char* buf, size_t count,
 	//xil = *((unsigned short*)xil_addr + XIL_Z_STATUS_OFFSET);
     //printk("dev = %d  xil = %d\n",minor,xil);
     m_lastTxfer = ((unsigned short*)readBuf)[writeCount/2 -1];
+    spi_status_log_frame(minor, m_lastTxfer, xil);
     ret = (ssize_t)( ((int)xil << 16) + m_lastTxfer);
     //printk("\nwrite ret = %x\n",ret);
     
@@ -479,6 +598,10 @@ static int spi_link_ioctl(struct inode* inode, struct file* file, unsigned int c
     case SPI_Z_SERVO_STATUS:
 	return m_iZStatus;
 	break;
+    case SPI_STATUS_READ:
+	if (iMinor < iDev2 || iMinor > iDev3)
+	    return -ENODEV;
+	return spi_status_read(iMinor, (struct spi_status_read __user *)arg);
     case SPI_DISABLE:
 	// Disable the peripheral pins make them IO
 	printk("Disabling SPI\n");
@@ -507,6 +630,7 @@ owner:		THIS_MODULE,
 read:		spi_link_read,
 write:		spi_link_write,
 ioctl:		spi_link_ioctl,
+mmap:		spi_link_mmap,
 open:		spi_link_open,
 release:	spi_link_release,
 };
@@ -523,6 +647,7 @@ static int __init synrad_spi_link_init_module(void)
 	unsigned char cdm;
 	int scr;
 	u8 regval = SPMODE_ENABLE;
+	int i;
 	xil_addr = NULL;
 	MSG("Module synrad_spi_link init\n" );
 	init_MUTEX(&spi_lock);
@@ -546,6 +671,7 @@ static int __init synrad_spi_link_init_module(void)
 	if (!chipselect)
 	{
 	printk(KERN_ERR "Synrad GPIO ioremap FAILED\n");
+	res = -ENXIO;
 	goto out_unmap_controller;
         }
 	
@@ -554,8 +680,27 @@ static int __init synrad_spi_link_init_module(void)
 	//spi_transfer_desc = kmalloc(sizeof(struct spi_transfer_list), GFP_KERNEL);
 	//spi_dev = kmalloc(sizeof(struct spi_local), GFP_KERNEL);
 	if (!readBuf || !writeBuf)
-		return -ENOMEM;
+	{
+		res = -ENOMEM;
+		goto out_free_bufs;
+	}
 	memset(readBuf,0,BUFSIZE);//clear the read buffer
+
+	for (i = 0; i < NR_SPI_DEVICES; i++)
+	{
+	    struct spi_status_log *log = &status_log[i];
+
+	    spin_lock_init(&log->lock);
+	    log->nr = roundup_pow_of_two(max(status_ring, 16U));
+	    /* zeroed, and whole pages so it can be mapped */
+	    log->ring = vmalloc_user(spi_status_ring_size(log->nr));
+	    if (!log->ring)
+	    {
+		res = -ENOMEM;
+		goto out_free_rings;
+	    }
+	    log->ring->nr = log->nr;
+	}
 	printk(KERN_DEBUG "readBuf:0x%x, writeBuf:0x%x\n",(int)readBuf,(int)writeBuf);
 	/*register the device with the kernel*/	
 	
@@ -612,11 +757,7 @@ static int __init synrad_spi_link_init_module(void)
 	if (res)
 	{
 		MSG("Can't register device spi_link with kernel.\n");
-		
-		iounmap(chipselect);
-		iounmap(controller);
-		
-		return res;
+		goto out_free_rings;
 	}
 	#endif
 	
@@ -627,22 +768,29 @@ static int __init synrad_spi_link_init_module(void)
 	if (res)
 	{
 		MSG("Can't register device spi_link with kernel.\n");
-		
-		#ifdef ENABLE_INT
-		free_irq(irq, 0);
-		#endif
-		iounmap(chipselect);
-		iounmap(controller);
-		
-		return res;
+		goto out_free_irq;
 	}
 	 printk("Synrad SPI Registered 16-Sep-2010 -A\n");
 	return 0;
 
+out_free_irq:
+	#ifdef ENABLE_INT
+	free_irq(irq, 0);
+	#endif
+out_free_rings:
+	for (i = 0; i < NR_SPI_DEVICES; i++)
+	{
+	    vfree(status_log[i].ring);
+	    status_log[i].ring = NULL;
+	}
+out_free_bufs:
+	kfree(writeBuf);
+	kfree(readBuf);
+	writeBuf = readBuf = NULL;
+	iounmap(chipselect);
 out_unmap_controller:
-    iounmap(controller);
-	
-    return 0;
+	iounmap(controller);
+	return res;
 
 }
 
@@ -661,11 +809,13 @@ static void __exit synrad_spi_link_exit_module(void)
 		kfree(writeBuf);
 	}
 	
-	iounmap(chipselect);
-	iounmap(controller);
-	
 	/*unregister the device with the kernel*/	
 	unregister_chrdev(SPI_LINK_MAJOR,"spi_link");
+
+	vfree(status_log[0].ring);
+	vfree(status_log[1].ring);
+	iounmap(chipselect);
+	iounmap(controller);
 	
 }
 
@@ -68,12 +68,21 @@
 #include <linux/fs.h>
 #include <linux/poll.h>
 #include <linux/wait.h>
+#include <linux/leds.h>
+#include <linux/pagemap.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/splice.h>
+#include <linux/mutex.h>
+#include <linux/log2.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
 
 #include <asm/byteorder.h>
 #include <asm/io.h>
 #include <asm/irq.h>
 #include <asm/system.h>
 #include <asm/unaligned.h>
+#include <asm/div64.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 
@@ -84,13 +93,28 @@
 
 #include "gadget_chips.h"
 
+#ifdef CONFIG_FLYER
+#define FLYER_XIL_ABORT		/* flyer_notify_abort() */
+#endif
+
 #define URGENT_QUEUE_LEN 4
+#define URGENT_MSG_MAX 512	/* high speed bulk maxpacket */
+#define URGENT_MATCH_MAX 16
 
 #define FLYER_MAJOR 243
 #define FLYER_IOCTL_BASE 0xAE
 #define FLYER_CONNECTED _IO(FLYER_IOCTL_BASE,0x20)
 #define FLYER_INITIATE_CONNECT _IO(FLYER_IOCTL_BASE,0x21)
 
+/* urgent minor only */
+struct flyer_urgent_match
+{
+    unsigned int len;		/* 0 disables */
+    unsigned char data[URGENT_MATCH_MAX];
+};
+#define FLYER_URGENT_GSTAMP _IOR(FLYER_IOCTL_BASE,0x22,struct timespec)
+#define FLYER_URGENT_ABORT_MATCH _IOW(FLYER_IOCTL_BASE,0x23,struct flyer_urgent_match)
+
 #define FLYER_PCIL0_BASE            0x00000000ef400000ULL
 #define FLYER_PCIL0_SIZE            0x40
 
@@ -110,6 +134,7 @@ struct proc_dir_entry   *g_flyer_pde = NULL;
 
 static ssize_t at91_flyer_read(struct file* file, char* buf, size_t count, loff_t *offset);
 static ssize_t at91_flyer_write(struct file* file, const char* buf, size_t count, loff_t *offset);
+static ssize_t at91_flyer_splice_read(struct file* file, loff_t *ppos, struct pipe_inode_info *pipe, size_t len, unsigned int flags);
 static int     at91_flyer_open(struct inode* inode, struct file* file);
 static int     at91_flyer_release(struct inode* inode, struct file* file);
 static int     at91_flyer_ioctl(struct inode* inode, struct file* file, unsigned int cmd, unsigned long arg);
@@ -125,12 +150,37 @@ struct gs_buf {
 	struct usb_ep		*ep;
 };
 
-/* struct for urgent buffer received */
+/*
+ * Urgent channel.  Every transfer the host sends on the urgent OUT
+ * endpoint is one message and read() returns one message.  The
+ * completion handler copies it into the ring and resubmits the request
+ * straight away, so the endpoint is never left without requests while
+ * the reader is slow.  head is only advanced by the completion handler
+ * and tail only by readers (under read_mutex), so readers copy out of
+ * the ring with interrupts enabled.  A full ring drops new messages.
+ *
+ * Messages starting with abort_match also go to the board's abort
+ * notifier, which wakes the Xilinx driver's sleepers as
+ * XIL_WAKE_IO_SLEEPERS would, without waiting for the application to
+ * read them.
+ */
+struct flyer_urg_msg
+{
+    struct timespec	stamp;		/* completion time, CLOCK_MONOTONIC */
+    unsigned int	len;
+    unsigned char	data[URGENT_MSG_MAX];
+};
+
 struct g_urg_queue
 {
-    int 		count;
     int			listening;
-    struct usb_request *pBuf[URGENT_QUEUE_LEN];
+    unsigned int	head, tail;	/* free running, slot is & (depth-1) */
+    unsigned int	depth;
+    unsigned long	dropped;
+    struct flyer_urg_msg *msg;
+    struct mutex	read_mutex;
+    struct timespec	last_stamp;	/* of the message last read */
+    struct flyer_urgent_match abort_match;	/* under flyer_dev.lock */
 };
     
 static struct gs_buf *gs_buf_alloc(unsigned int size, int kmalloc_flags);
@@ -233,6 +283,15 @@ static unsigned qlen = 16;
 module_param (buflen, uint, S_IRUGO|S_IWUSR);
 module_param (qlen, uint, S_IRUGO|S_IWUSR);
 
+/*
+ * urgent_qlen requests stay queued on the urgent OUT endpoint and up to
+ * urgent_depth messages (rounded up to a power of 2) wait for the reader.
+ */
+static unsigned urgent_qlen = URGENT_QUEUE_LEN;
+static unsigned urgent_depth = 32;
+module_param (urgent_qlen, uint, S_IRUGO);
+module_param (urgent_depth, uint, S_IRUGO);
+
 /*
  * if it's nonzero, autoresume says how many seconds to wait
  * before trying to wake up the host after suspend.
@@ -560,6 +619,147 @@ static void free_ep_req (struct usb_ep *ep, struct usb_request *req)
 
 /*-------------------------------------------------------------------------*/
 
+/*-----------------------------Statistics------------------------------------------*/
+
+/*
+ * Per-endpoint traffic and main OUT backpressure counters, shown in
+ * debugfs as flyer_usb/stats (write to it to clear them).  Counters
+ * are always kept; the hold timing and fill level history also read
+ * the clock and are only kept while flyer_usb/enable is set.  Without
+ * CONFIG_DEBUG_FS none of it is built.
+ */
+#ifdef CONFIG_DEBUG_FS
+
+enum { FLYER_EP_IN_MAIN, FLYER_EP_OUT_MAIN, FLYER_EP_IN_URGENT, FLYER_EP_OUT_URGENT, FLYER_NR_EPS };
+
+#define FLYER_HIST 16		/* log2 buckets */
+#define FLYER_FILL_HIST 8	/* eighths of main_buf */
+#define FLYER_FILL_SAMPLES 64
+#define FLYER_FILL_PERIOD (HZ / 10)
+
+struct flyer_ep_stats
+{
+    u64			bytes;
+    unsigned long	reqs;
+    unsigned long	errors;
+    unsigned long	size_hist[FLYER_HIST];	/* transfer length, log2 bytes */
+};
+
+struct flyer_stats
+{
+    struct flyer_ep_stats ep[FLYER_NR_EPS];
+
+    /* requests gs_buf_requeue set aside because main_buf was nearly full */
+    unsigned long	held;
+    unsigned int	held_max;		/* most held at one time */
+    unsigned long	hold_periods;
+    u64			held_ns;		/* total time with any held */
+    unsigned long	hold_hist[FLYER_HIST];	/* hold period, log2 us */
+    ktime_t		held_since;
+
+    unsigned long	put_retries;		/* gs_buf_put loops in flyer_main_complete */
+
+    /* main_buf fill level, one sample per main OUT completion */
+    unsigned long	fill_hist[FLYER_FILL_HIST];
+    unsigned int	fill_max;
+    /* and one every FLYER_FILL_PERIOD while there is traffic, in percent */
+    u8			fill_samples[FLYER_FILL_SAMPLES];
+    unsigned int	fill_next;
+    unsigned long	fill_due;
+};
+
+static struct flyer_stats flyer_stats;
+static u32 flyer_stats_enable;
+
+static inline int flyer_hist_bucket(unsigned long v)
+{
+    return v ? min(ilog2(v) + 1, FLYER_HIST - 1) : 0;
+}
+
+static inline void flyer_stat_xfer(int ep, unsigned int len)
+{
+    struct flyer_ep_stats *e = &flyer_stats.ep[ep];
+
+    e->bytes += len;
+    e->reqs++;
+    e->size_hist[flyer_hist_bucket(len)]++;
+}
+
+static inline int flyer_ep_index(struct flyer_dev *dev, struct usb_ep *ep)
+{
+    if (ep == dev->out_main_ep)
+	return FLYER_EP_OUT_MAIN;
+    if (ep == dev->in_urgent_ep)
+	return FLYER_EP_IN_URGENT;
+    if (ep == dev->out_urgent_ep)
+	return FLYER_EP_OUT_URGENT;
+    return FLYER_EP_IN_MAIN;
+}
+
+static inline void flyer_stat_error(int ep)
+{
+    flyer_stats.ep[ep].errors++;
+}
+
+static inline void flyer_stat_retry(void)
+{
+    flyer_stats.put_retries++;
+}
+
+/* Called with interrupts off, held is the new number of held requests */
+static inline void flyer_stat_hold(unsigned int held)
+{
+    flyer_stats.held++;
+    if (held > flyer_stats.held_max)
+	flyer_stats.held_max = held;
+    if (held == 1 && flyer_stats_enable)
+	flyer_stats.held_since = ktime_get();
+}
+
+/* Called with interrupts off when gs_buf_clear_hold requeues */
+static inline void flyer_stat_release(void)
+{
+    u64 ns, us;
+
+    if (!flyer_stats.held_since.tv64)
+	return;
+    ns = ktime_to_ns(ktime_sub(ktime_get(), flyer_stats.held_since));
+    flyer_stats.held_since.tv64 = 0;
+    flyer_stats.hold_periods++;
+    flyer_stats.held_ns += ns;
+    us = ns;
+    do_div(us, 1000);
+    flyer_stats.hold_hist[flyer_hist_bucket((unsigned long)us)]++;
+}
+
+static inline void flyer_stat_fill(struct gs_buf *gb)
+{
+    unsigned int used = gb->buf_size - 1 - gs_buf_space_avail(gb);
+
+    flyer_stats.fill_hist[(used * FLYER_FILL_HIST) / gb->buf_size]++;
+    if (used > flyer_stats.fill_max)
+	flyer_stats.fill_max = used;
+    if (flyer_stats_enable && time_after_eq(jiffies, flyer_stats.fill_due))
+    {
+	flyer_stats.fill_samples[flyer_stats.fill_next++ % FLYER_FILL_SAMPLES] =
+	    (used * 100) / gb->buf_size;
+	flyer_stats.fill_due = jiffies + FLYER_FILL_PERIOD;
+    }
+}
+
+#else
+
+#define flyer_stat_xfer(ep, len) do { } while (0)
+#define flyer_stat_error(ep) do { } while (0)
+#define flyer_stat_retry() do { } while (0)
+#define flyer_stat_hold(held) do { } while (0)
+#define flyer_stat_release() do { } while (0)
+#define flyer_stat_fill(gb) do { } while (0)
+
+#endif /* CONFIG_DEBUG_FS */
+
+/*-----------------------------End Statistics--------------------------------------*/
+
 /* if there is only one request in the queue, there'll always be an
  * irq delay between end of one request and start of the next.
  * that prevents using hardware dma queues.
@@ -573,18 +773,24 @@ static void flyer_main_complete (struct usb_ep *ep, struct usb_request *req)
     {
 	
 	case 0: 			/* normal completion? */
+	flyer_led_usb_activity();
 	if (ep == dev->out_main_ep)
 	{
 	    //received some vector data, place it in the right place...
 	    //printk (KERN_ERR "Got main data size:%d\n",req->actual);
+	    flyer_stat_xfer(FLYER_EP_OUT_MAIN, req->actual);
 	    do
 	    {
 		ret = gs_buf_put(dev->main_buf, req->buf,req->actual);
 		if (!ret)
+		{
 		    INFO (pFlyerDev, "gs_buf_put failed\n");
+		    flyer_stat_retry();
+		}
 		wake_up_interruptible(&dev->wait);    
 	    }
 	    while(!ret);
+	    flyer_stat_fill(dev->main_buf);
 	    
 	    status = gs_buf_requeue(dev->main_buf,ep, req);
 	    if (status == 0)
@@ -593,6 +799,7 @@ static void flyer_main_complete (struct usb_ep *ep, struct usb_request *req)
 	else if (ep == dev->in_main_ep)
 	{
 	    //sent something over the main data line...	    
+	    flyer_stat_xfer(FLYER_EP_IN_MAIN, req->actual);
 	    free_ep_req (ep, req); //free the request
 	    return;
 	}
@@ -618,6 +825,7 @@ static void flyer_main_complete (struct usb_ep *ep, struct usb_request *req)
 	     status, req->actual, req->length);
 #endif
 	case -EREMOTEIO:		/* short read */
+	flyer_stat_error(flyer_ep_index(dev, ep));
 	break;
     }
     
@@ -630,6 +838,44 @@ static void flyer_main_complete (struct usb_ep *ep, struct usb_request *req)
     }
 }
 
+static inline unsigned int flyer_urgent_pending(struct g_urg_queue *q)
+{
+    return q->head - q->tail;
+}
+
+/* Called from the urgent OUT completion, in interrupt context */
+static void flyer_urgent_rx(struct flyer_dev *dev, struct usb_request *req)
+{
+    struct g_urg_queue *q = &dev->urg_queue;
+    struct flyer_urg_msg *m;
+    unsigned int len = min_t(unsigned int, req->actual, URGENT_MSG_MAX);
+#ifdef FLYER_XIL_ABORT
+    int abort;
+
+    spin_lock(&dev->lock);
+    abort = q->abort_match.len && len >= q->abort_match.len &&
+	!memcmp(req->buf, q->abort_match.data, q->abort_match.len);
+    spin_unlock(&dev->lock);
+    if (abort)
+	flyer_notify_abort();
+#endif
+
+    if (!q->listening)
+	return;
+    if (flyer_urgent_pending(q) >= q->depth)
+    {
+	q->dropped++;
+	return;
+    }
+    m = &q->msg[q->head & (q->depth - 1)];
+    ktime_get_ts(&m->stamp);
+    m->len = len;
+    memcpy(m->data, req->buf, len);
+    smp_wmb();		/* message before head */
+    q->head++;
+    wake_up_interruptible(&dev->wait);
+}
+
 /* if there is only one request in the queue, there'll always be an
  * irq delay between end of one request and start of the next.
  * that prevents using hardware dma queues.
@@ -645,29 +891,15 @@ static void flyer_urgent_complete (struct usb_ep *ep, struct usb_request *req)
 	case 0: 			/* normal completion? */
 	if (ep == dev->out_urgent_ep)
 	{
-	    //received some urgent data, probably a response to something we sent
-	    //this leaves the urb out of the queue until it is read instead of using a circular buffer.
-	    //printk (KERN_ERR "Got urgent data  size:%d\n",req->actual);
-	    if (dev->urg_queue.listening)
-	    {
-		dev->urg_queue.pBuf[dev->urg_queue.count] = req;
-		dev->urg_queue.count ++;
-		if (dev->urg_queue.count > URGENT_QUEUE_LEN)
-		{
-		    printk(KERN_ERR "count is :%d in flyer_urgent_complete!!!\n",dev->urg_queue.count);
-		    dev->urg_queue.count = URGENT_QUEUE_LEN;
-		}
-		wake_up_interruptible(&dev->wait);
-	    }
-	    else
-	    {
-		status = usb_ep_queue (ep, req, GFP_ATOMIC);
-	    }
-	    return;
+	    //received some urgent data, copy it out and give the request straight back
+	    flyer_stat_xfer(FLYER_EP_OUT_URGENT, req->actual);
+	    flyer_urgent_rx(dev, req);
+	    break;
 	}
 	else if (ep == dev->in_urgent_ep)
 	{
 	    //send something over the urgent data line...
+	    flyer_stat_xfer(FLYER_EP_IN_URGENT, req->actual);
 	    free_ep_req (ep, req); //free the request
 	    return;
 	}
@@ -693,6 +925,7 @@ static void flyer_urgent_complete (struct usb_ep *ep, struct usb_request *req)
 	     status, req->actual, req->length);
 #endif
 	case -EREMOTEIO:		/* short read */
+	flyer_stat_error(flyer_ep_index(dev, ep));
 	break;
     }
     
@@ -819,9 +1052,9 @@ static int set_flyer_config (struct flyer_dev *dev, int gfp_flags)
 		} else
 		    result = -ENOMEM;
 	    }
-	    //for the urgent queue, just do qlen/8 or default to 4 in the queue, this will be enough
+	    //urgent messages are copied out on completion, so a few requests are enough
 	    ep = dev->out_urgent_ep;
-	    for (i = 0; i < URGENT_QUEUE_LEN && result == 0; i++) 
+	    for (i = 0; i < urgent_qlen && result == 0; i++) 
 	    {
 		req = alloc_ep_req (ep, ep->maxpacket);
 		if (req) 
@@ -1201,7 +1434,7 @@ flyer_unbind (struct usb_gadget *gadget)
     del_timer_sync (&dev->resume);
     gs_buf_clear(dev->main_buf);
     gs_buf_free(dev->main_buf);
-    dev->urg_queue.count = 0;
+    kfree(dev->urg_queue.msg);
     pFlyerDev = NULL;
     wake_up_interruptible(&dev->wait);
     kfree (dev);
@@ -1270,9 +1503,13 @@ flyer_bind (struct usb_gadget *gadget)
     //initialize the buffers...
     dev->main_buf = gs_buf_alloc(buflen, GFP_KERNEL);
     gs_buf_clear(dev->main_buf);
-    dev->urg_queue.count = 0;
     if (!dev->main_buf )
 	goto enomem;
+    mutex_init(&dev->urg_queue.read_mutex);
+    dev->urg_queue.depth = roundup_pow_of_two(max(urgent_depth, 2U));
+    dev->urg_queue.msg = kmalloc(dev->urg_queue.depth * sizeof(struct flyer_urg_msg), GFP_KERNEL);
+    if (!dev->urg_queue.msg)
+	goto enomem;
     init_waitqueue_head(&dev->wait);
     dev->gadget = gadget;
     set_gadget_data (gadget, dev);
@@ -1391,20 +1628,48 @@ static struct file_operations flyer_fops = {
 owner:		THIS_MODULE,
 read:		at91_flyer_read,
 write:		at91_flyer_write,
+splice_read:	at91_flyer_splice_read,
 ioctl:		at91_flyer_ioctl,
 open:		at91_flyer_open,
 release:	at91_flyer_release,
 poll:		at91_flyer_poll
 };
 
+/*
+ * One urgent message per call; 0 when none is queued (poll first).  A
+ * buffer too small for the next message gets -EMSGSIZE and the message
+ * stays queued.
+ */
+static ssize_t flyer_urgent_read(struct g_urg_queue *q, char __user *buf, size_t count)
+{
+    struct flyer_urg_msg *m;
+    ssize_t ret = 0;
+
+    if (mutex_lock_interruptible(&q->read_mutex))
+	return -ERESTARTSYS;
+    if (flyer_urgent_pending(q))
+    {
+	smp_rmb();	/* head before message */
+	m = &q->msg[q->tail & (q->depth - 1)];
+	if (m->len > count)
+	    ret = -EMSGSIZE;
+	else if (copy_to_user(buf, m->data, m->len))
+	    ret = -EFAULT;
+	else
+	{
+	    ret = m->len;
+	    q->last_stamp = m->stamp;
+	    smp_mb();	/* done with the slot before handing it back */
+	    q->tail++;
+	}
+    }
+    mutex_unlock(&q->read_mutex);
+    return ret;
+}
+
 static ssize_t at91_flyer_read(struct file* file, char* buf, size_t count, loff_t *offset)
 {
-    int status = 0;
-    int rxamount, finalCount = 0;
-    char* pCurBuf = buf;
-    int index = 0;
-    int i = 0;
-    unsigned long flags;
+    int rxamount;
     int *pMinor = (int*)file->private_data;
     if (*pMinor == iDevMain)
     {
@@ -1421,32 +1686,7 @@ static ssize_t at91_flyer_read(struct file* file, char* buf, size_t count, loff_
     {
 	if (!pFlyerDev || !pFlyerDev->out_urgent_ep)
 	    return -ENODEV;
-	//we are expecting that the program is asking to read more than the maximum amount of 64 * 4 bytes
-	if (count < (pFlyerDev->out_urgent_ep->maxpacket * URGENT_QUEUE_LEN))
-	    return 0;
-	//check for data to read from the urgent queue...
-	
-	local_irq_save(flags);
-	while (index < pFlyerDev->urg_queue.count )
-	{
-	    rxamount = pFlyerDev->urg_queue.pBuf[index]->actual;
-	    memcpy(pCurBuf,pFlyerDev->urg_queue.pBuf[index]->buf,rxamount);
-	    pCurBuf = (char*)((int)pCurBuf + rxamount);
-	    index++;
-	    finalCount += rxamount;
-	}
-	index = pFlyerDev->urg_queue.count;
-	pFlyerDev->urg_queue.count = 0;
-	for (i=0;i<index;i++)
-	{
-	    status = usb_ep_queue (pFlyerDev->out_urgent_ep, pFlyerDev->urg_queue.pBuf[i], GFP_ATOMIC);
-	    if (status)
-		INFO(pFlyerDev,"Problem re-queueing urgent data request block 0x%x\n",
-		     (int)pFlyerDev->urg_queue.pBuf[i]);
-	}
-	
-	local_irq_restore(flags);
-	return finalCount;
+	return flyer_urgent_read(&pFlyerDev->urg_queue, buf, count);
     }
     else
     {
@@ -1455,6 +1695,91 @@ static ssize_t at91_flyer_read(struct file* file, char* buf, size_t count, loff_
     return 0;
 }
 
+/*
+ * splice() from the main minor: the received data is copied out of the
+ * circular buffer into freshly allocated pages which are handed to the
+ * pipe, so a job upload can go on to a file or socket without passing
+ * through user space.  Like read() this never sleeps waiting for data,
+ * it returns 0 when the buffer is empty and the caller polls.
+ */
+static void flyer_pipe_buf_release(struct pipe_inode_info *pipe, struct pipe_buffer *buf)
+{
+    page_cache_release(buf->page);
+}
+
+static const struct pipe_buf_operations flyer_pipe_buf_ops = {
+    .can_merge = 0,
+    .map = generic_pipe_buf_map,
+    .unmap = generic_pipe_buf_unmap,
+    .confirm = generic_pipe_buf_confirm,
+    .release = flyer_pipe_buf_release,
+    .steal = generic_pipe_buf_steal,
+    .get = generic_pipe_buf_get,
+};
+
+static ssize_t at91_flyer_splice_read(struct file* file, loff_t *ppos, struct pipe_inode_info *pipe, size_t len, unsigned int flags)
+{
+    struct page *pages[PIPE_DEF_BUFFERS];
+    struct partial_page partial[PIPE_DEF_BUFFERS];
+    struct splice_pipe_desc spd = {
+	.pages = pages,
+	.partial = partial,
+	.flags = flags,
+	.ops = &flyer_pipe_buf_ops,
+    };
+    int *pMinor = (int*)file->private_data;
+    unsigned int avail, slots, n;
+    ssize_t ret;
+    
+    if (*pMinor != iDevMain)
+	return -EINVAL;
+    if (!pFlyerDev)
+	return -ENODEV;
+    
+    avail = gs_buf_data_avail(pFlyerDev->main_buf);
+    if (len > avail)
+	len = avail;
+    /*
+     * Data taken out of the circular buffer can't be put back, so only
+     * fill as many pages as the pipe has free slots.  The count is taken
+     * under the pipe's lock, but another writer may still get in before
+     * splice_to_pipe() takes it again, so don't let that one return
+     * -EAGAIN and drop the pages: it waits for room instead.
+     */
+    if (pipe->inode)
+	mutex_lock(&pipe->inode->i_mutex);
+    slots = pipe->buffers - pipe->nrbufs;
+    if (pipe->inode)
+	mutex_unlock(&pipe->inode->i_mutex);
+    if (len && !slots)
+	return -EAGAIN;
+    spd.flags &= ~SPLICE_F_NONBLOCK;
+    if (splice_grow_spd(pipe, &spd))
+	return -ENOMEM;
+    slots = min(slots, spd.nr_pages_max);
+    
+    while (len && spd.nr_pages < slots)
+    {
+	struct page *page = alloc_page(GFP_KERNEL);
+	if (!page)
+	    break;
+	n = min_t(size_t, len, PAGE_SIZE);
+	n = gs_buf_get(pFlyerDev->main_buf, page_address(page), n);
+	spd.pages[spd.nr_pages] = page;
+	spd.partial[spd.nr_pages].offset = 0;
+	spd.partial[spd.nr_pages].len = n;
+	spd.nr_pages++;
+	len -= n;
+    }
+    
+    if (spd.nr_pages)
+	ret = splice_to_pipe(pipe, &spd);
+    else
+	ret = len ? -ENOMEM : 0;
+    splice_shrink_spd(&spd);
+    return ret;
+}
+
 #define PACKET_WRITE 768
 static ssize_t at91_flyer_write(struct file* file, const char* buf, size_t count, loff_t *offset)
 {     
@@ -1546,7 +1871,7 @@ static unsigned int at91_flyer_poll(struct file* file, poll_table* wait)
     }
     else if (iDevCurrent == iDevUrgent)
     {
-	if (pFlyerDev->urg_queue.count)
+	if (flyer_urgent_pending(&pFlyerDev->urg_queue))
 	    mask |= (POLLIN | POLLRDNORM);
 	
     }
@@ -1563,7 +1888,7 @@ static unsigned int at91_flyer_poll(struct file* file, poll_table* wait)
 	}
 	else if (iDevCurrent == iDevUrgent)
 	{
-	    if (pFlyerDev->urg_queue.count)
+	    if (flyer_urgent_pending(&pFlyerDev->urg_queue))
 		mask |= (POLLIN | POLLRDNORM);
 	    
 	}
@@ -1588,26 +1913,16 @@ static int at91_flyer_open(struct inode* inode, struct file* file)
 
 static int at91_flyer_release(struct inode* inode, struct file* file)
 {
-    int i = 0,status = 0;
     if (!pFlyerDev || !pFlyerDev->out_urgent_ep)
 	return -ENODEV;
-    //we are expecting that the program is asking to read more than the maximum amount of 64 * 4 bytes
     
     if (iminor(inode) == iDevUrgent)
     {
-	//check for data to read from the urgent queue...
-	unsigned long flags;
-	local_irq_save(flags);
+	//stop queueing and throw away whatever nobody read
 	pFlyerDev->urg_queue.listening = 0;
-	for (i=0;i<pFlyerDev->urg_queue.count;i++)
-	{
-	    status = usb_ep_queue (pFlyerDev->out_urgent_ep, pFlyerDev->urg_queue.pBuf[i], GFP_ATOMIC);
-	    if (status)
-		INFO(pFlyerDev,"Problem re-queueing urgent data request block 0x%x\n",
-		     (int)pFlyerDev->urg_queue.pBuf[i]);
-	}
-	pFlyerDev->urg_queue.count = 0;
-	local_irq_restore(flags);
+	mutex_lock(&pFlyerDev->urg_queue.read_mutex);
+	pFlyerDev->urg_queue.tail = pFlyerDev->urg_queue.head;
+	mutex_unlock(&pFlyerDev->urg_queue.read_mutex);
     }
     return 0;
 }
@@ -1615,12 +1930,34 @@ static int at91_flyer_release(struct inode* inode, struct file* file)
 static int at91_flyer_ioctl(struct inode* inode, struct file* file, unsigned int cmd, unsigned long arg)
 {
     int iArg;
+    struct flyer_urgent_match match;
+    unsigned long flags;
     /* Make sure the command belongs to us*/
     if (_IOC_TYPE(cmd) != FLYER_IOCTL_BASE)
     	return -ENOTTY;
     iArg = (int)arg;
     switch(cmd )
     {
+    case FLYER_URGENT_GSTAMP://arrival time of the urgent message last read
+	if (!pFlyerDev)
+	    return -ENODEV;
+	return copy_to_user((void __user *)arg, &pFlyerDev->urg_queue.last_stamp,
+			    sizeof(struct timespec)) ? -EFAULT : 0;
+    case FLYER_URGENT_ABORT_MATCH:
+	if (!pFlyerDev)
+	    return -ENODEV;
+	if (copy_from_user(&match, (void __user *)arg, sizeof(match)))
+	    return -EFAULT;
+	if (match.len > URGENT_MATCH_MAX)
+	    return -EINVAL;
+#ifndef FLYER_XIL_ABORT
+	if (match.len)
+	    return -EOPNOTSUPP;
+#endif
+	spin_lock_irqsave(&pFlyerDev->lock, flags);
+	pFlyerDev->urg_queue.abort_match = match;
+	spin_unlock_irqrestore(&pFlyerDev->lock, flags);
+	return 0;
     case FLYER_CONNECTED:
     	return g_bUSBConnected;
     case FLYER_INITIATE_CONNECT://-1 to disconnect on a FAULT, 0 to check and 1 to connect...
@@ -1820,6 +2157,7 @@ unsigned int gs_buf_requeue(struct gs_buf *gb,struct usb_ep *ep, struct usb_requ
 	//printk(KERN_ERR "Holding onto a req, count:%d\n",gb->count);
 	gb->pUrb[gb->count] = req;
 	gb->count++;
+	flyer_stat_hold(gb->count);
 	status = 0;
 	local_irq_restore(flags);
     }
@@ -1853,6 +2191,7 @@ unsigned int gs_buf_clear_hold(struct gs_buf *gb)
 	}
 	//printk(KERN_ERR"Setting gb->count to 0 from %d\n",gb->count);
 	gb->count = 0;
+	flyer_stat_release();
 	local_irq_restore(flags);	
     }
     return i;
@@ -1961,6 +2300,128 @@ static void remove_debug_file(void)
 }
 /*-----------------------------End proc stuff---------------------------------------*/
 
+/*-----------------------------Debugfs stats----------------------------------------*/
+#ifdef CONFIG_DEBUG_FS
+
+static struct dentry *flyer_debugfs_dir, *flyer_debugfs_stats, *flyer_debugfs_enable;
+
+static const char *flyer_ep_names[FLYER_NR_EPS] = {
+    "main in", "main out", "urgent in", "urgent out",
+};
+
+static void flyer_hist_show(struct seq_file *s, const char *name, const unsigned long *hist, int n)
+{
+    int i;
+
+    seq_printf(s, "%-14s", name);
+    for (i = 0; i < n; i++)
+	seq_printf(s, " %lu", hist[i]);
+    seq_putc(s, '\n');
+}
+
+static int flyer_stats_show(struct seq_file *s, void *unused)
+{
+    struct flyer_stats *st;
+    unsigned int i, n;
+    unsigned long flags;
+    u64 held_us;
+
+    /* take a consistent copy, the completions update it from irq context */
+    st = kmalloc(sizeof(*st), GFP_KERNEL);
+    if (!st)
+	return -ENOMEM;
+    local_irq_save(flags);
+    *st = flyer_stats;
+    local_irq_restore(flags);
+
+    seq_printf(s, "%-14s %12s %10s %8s\n", "endpoint", "bytes", "requests", "errors");
+    for (i = 0; i < FLYER_NR_EPS; i++)
+	seq_printf(s, "%-14s %12llu %10lu %8lu\n", flyer_ep_names[i],
+		   (unsigned long long)st->ep[i].bytes, st->ep[i].reqs, st->ep[i].errors);
+
+    seq_printf(s, "\ntransfer size histograms, buckets 0, 1, 2-3, 4-7, ... bytes\n");
+    for (i = 0; i < FLYER_NR_EPS; i++)
+	flyer_hist_show(s, flyer_ep_names[i], st->ep[i].size_hist, FLYER_HIST);
+
+    seq_printf(s, "\nmain out backpressure\n");
+    seq_printf(s, "held requests  %lu (max %u at once)\n", st->held, st->held_max);
+    held_us = st->held_ns;
+    do_div(held_us, 1000);
+    seq_printf(s, "hold periods   %lu, %llu us held in total\n", st->hold_periods,
+	       (unsigned long long)held_us);
+    flyer_hist_show(s, "hold us", st->hold_hist, FLYER_HIST);
+    seq_printf(s, "put retries    %lu\n", st->put_retries);
+    if (pFlyerDev)
+	seq_printf(s, "urgent dropped %lu\n", pFlyerDev->urg_queue.dropped);
+
+    seq_printf(s, "\nmain buffer fill, max %u bytes\n", st->fill_max);
+    flyer_hist_show(s, "eighths", st->fill_hist, FLYER_FILL_HIST);
+    n = min(st->fill_next, (unsigned int)FLYER_FILL_SAMPLES);
+    seq_printf(s, "%-14s", "recent %");
+    for (i = st->fill_next - n; i != st->fill_next; i++)
+	seq_printf(s, " %u", st->fill_samples[i % FLYER_FILL_SAMPLES]);
+    seq_putc(s, '\n');
+
+    kfree(st);
+    return 0;
+}
+
+static int flyer_stats_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, flyer_stats_show, inode->i_private);
+}
+
+/* any write clears the statistics */
+static ssize_t flyer_stats_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+    unsigned long flags;
+
+    local_irq_save(flags);
+    memset(&flyer_stats, 0, sizeof(flyer_stats));
+    if (pFlyerDev && pFlyerDev->main_buf && pFlyerDev->main_buf->count)
+	flyer_stats.held_since = ktime_get();
+    local_irq_restore(flags);
+    return count;
+}
+
+static const struct file_operations flyer_stats_fops = {
+    .owner	= THIS_MODULE,
+    .open	= flyer_stats_open,
+    .read	= seq_read,
+    .write	= flyer_stats_write,
+    .llseek	= seq_lseek,
+    .release	= single_release,
+};
+
+static void create_debugfs_files(void)
+{
+    flyer_debugfs_dir = debugfs_create_dir(shortname, NULL);
+    if (IS_ERR(flyer_debugfs_dir) || !flyer_debugfs_dir)
+    {
+	flyer_debugfs_dir = NULL;
+	return;
+    }
+    flyer_debugfs_stats = debugfs_create_file("stats", S_IRUGO | S_IWUSR, flyer_debugfs_dir,
+					      NULL, &flyer_stats_fops);
+    flyer_debugfs_enable = debugfs_create_bool("enable", S_IRUGO | S_IWUSR, flyer_debugfs_dir,
+					       &flyer_stats_enable);
+}
+
+static void remove_debugfs_files(void)
+{
+    debugfs_remove(flyer_debugfs_enable);
+    debugfs_remove(flyer_debugfs_stats);
+    debugfs_remove(flyer_debugfs_dir);
+}
+
+#else
+
+static inline void create_debugfs_files(void) { }
+static inline void remove_debugfs_files(void) { }
+
+#endif /* CONFIG_DEBUG_FS */
+/*-----------------------------End debugfs stats------------------------------------*/
+
 MODULE_AUTHOR ("Jeff Warren");
 MODULE_LICENSE ("GPL");
 
@@ -1999,6 +2460,7 @@ static int __init init (void)
     }
     
     create_debug_file();
+    create_debugfs_files();
     
     return char_ret;
 }
@@ -2013,6 +2475,7 @@ static void __exit cleanup (void)
 	//printk(KERN_ERR "flyer_usb: Can't unregister device at91_ssc_temp with kernel.\n");
     //}
     usb_gadget_unregister_driver (&flyer_driver);
+    remove_debugfs_files();
     remove_debug_file();
 }
 module_exit (cleanup);
@@ -105,11 +105,15 @@ struct eth_dev {
 
 	spinlock_t		req_lock;
 	struct list_head	tx_reqs, rx_reqs;
+	struct usb_request	*tx_pack;	/* RNDIS tx being packed */
 
 	struct net_device	*net;
 	struct net_device_stats	stats;
 	atomic_t		tx_qlen;
 
+	struct napi_struct	napi;
+	struct sk_buff_head	rx_frames;	/* for eth_poll() */
+
 	struct work_struct	work;
 	unsigned		zlp:1;
 	unsigned		cdc:1;
@@ -357,6 +361,18 @@ static inline int BITRATE(struct usb_gadget *g)
 }
 #endif
 
+/* RNDIS can carry several packets per transfer, both ways; this is the
+ * most we take from the host, and send it if it lets us.
+ */
+static unsigned rndis_pkts = 4;
+module_param (rndis_pkts, uint, S_IRUGO);
+MODULE_PARM_DESC (rndis_pkts, "RNDIS packets per transfer, 1 to disable");
+
+#define ETH_NAPI_WEIGHT	16
+
+/* how many frames a tx skb carries */
+#define TX_FRAMES(skb)	(*(unsigned *) (skb)->cb)
+
 
 /*-------------------------------------------------------------------------*/
 
@@ -1012,6 +1028,7 @@ config_buf(struct usb_gadget *g, u8 *buf, u8 type, unsigned index, int is_otg)
 
 static void eth_start (struct eth_dev *dev, gfp_t gfp_flags);
 static int alloc_requests (struct eth_dev *dev, unsigned n, gfp_t gfp_flags);
+static void tx_pack_discard (struct eth_dev *dev);
 
 static int
 set_ether_config (struct eth_dev *dev, gfp_t gfp_flags)
@@ -1117,6 +1134,7 @@ static void eth_reset_config (struct eth_dev *dev)
 	 */
 	if (dev->in) {
 		usb_ep_disable (dev->in_ep);
+		tx_pack_discard (dev);
 		spin_lock(&dev->req_lock);
 		while (likely (!list_empty (&dev->tx_reqs))) {
 			req = container_of (dev->tx_reqs.next,
@@ -1687,12 +1705,16 @@ rx_submit (struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 *
 	 * RNDIS uses internal framing, and explicitly allows senders to
 	 * pad to end-of-packet.  That's potentially nice for speed,
-	 * but means receivers can't recover synch on their own.
+	 * but means receivers can't recover synch on their own.  It
+	 * also lets the host pack up to rndis_pkts packets per transfer
+	 * once RNDIS initialization has offered it that.  These requests
+	 * are queued before that, so they are always sized for rndis_pkts.
 	 */
-	size = (sizeof (struct ethhdr) + dev->net->mtu + RX_EXTRA);
-	size += dev->out_ep->maxpacket - 1;
 	if (rndis_active(dev))
-		size += sizeof (struct rndis_packet_msg_type);
+		size = rndis_max_transfer (dev->rndis_config);
+	else
+		size = (sizeof (struct ethhdr) + dev->net->mtu + RX_EXTRA);
+	size += dev->out_ep->maxpacket - 1;
 	size -= size % dev->out_ep->maxpacket;
 
 	skb = alloc_skb(size + NET_IP_ALIGN, gfp_flags);
@@ -1732,33 +1754,43 @@ static void rx_complete (struct usb_ep *ep, struct usb_request *req)
 	struct sk_buff	*skb = req->context;
 	struct eth_dev	*dev = ep->driver_data;
 	int		status = req->status;
+	struct sk_buff_head frames;
 
 	switch (status) {
 
 	/* normal completion */
 	case 0:
 		skb_put (skb, req->actual);
-		/* we know MaxPacketsPerTransfer == 1 here */
+		skb_queue_head_init (&frames);
 		if (rndis_active(dev))
-			status = rndis_rm_hdr (skb);
-		if (status < 0
-				|| ETH_HLEN > skb->len
-				|| skb->len > ETH_FRAME_LEN) {
+			status = rndis_rm_hdr (skb, &frames);
+		else
+			__skb_queue_tail (&frames, skb);
+		if (status < 0) {
 			dev->stats.rx_errors++;
-			dev->stats.rx_length_errors++;
-			DEBUG (dev, "rx length %d\n", skb->len);
-			break;
+			dev->stats.rx_frame_errors++;
+			DEBUG (dev, "rx rndis status %d\n", status);
 		}
 
-		skb->protocol = eth_type_trans (skb, dev->net);
-		dev->stats.rx_packets++;
-		dev->stats.rx_bytes += skb->len;
+		while ((skb = __skb_dequeue (&frames)) != NULL) {
+			if (ETH_HLEN > skb->len || skb->len > ETH_FRAME_LEN) {
+				dev->stats.rx_errors++;
+				dev->stats.rx_length_errors++;
+				DEBUG (dev, "rx length %d\n", skb->len);
+				dev_kfree_skb_any (skb);
+				continue;
+			}
 
-		/* no buffer copies needed, unless hardware can't
-		 * use skb buffers.
+			/* no buffer copies needed, unless hardware can't
+			 * use skb buffers.
+			 */
+			skb_queue_tail (&dev->rx_frames, skb);
+		}
+
+		/* hand them to the stack from eth_poll(), not from here
+		 * (usually the UDC's IRQ handler)
 		 */
-		status = netif_rx (skb);
-		skb = NULL;
+		netif_rx_schedule (dev->net, &dev->napi);
 		break;
 
 	/* software-driven interface shutdown */
@@ -1799,6 +1831,38 @@ clean:
 		rx_submit (dev, req, GFP_ATOMIC);
 }
 
+static int eth_poll (struct napi_struct *napi, int budget)
+{
+	struct eth_dev	*dev = container_of (napi, struct eth_dev, napi);
+	struct sk_buff	*skb;
+	unsigned long	flags;
+	int		work = 0;
+
+again:
+	while (work < budget
+			&& (skb = skb_dequeue (&dev->rx_frames)) != NULL) {
+		skb->protocol = eth_type_trans (skb, dev->net);
+		dev->stats.rx_packets++;
+		dev->stats.rx_bytes += skb->len;
+		netif_receive_skb (skb);
+		work++;
+	}
+
+	if (work < budget) {
+		/* rx_complete() queues frames under the same lock, so it
+		 * either sees us still scheduled or reschedules us
+		 */
+		spin_lock_irqsave (&dev->rx_frames.lock, flags);
+		if (!skb_queue_empty (&dev->rx_frames)) {
+			spin_unlock_irqrestore (&dev->rx_frames.lock, flags);
+			goto again;
+		}
+		__netif_rx_complete (dev->net, napi);
+		spin_unlock_irqrestore (&dev->rx_frames.lock, flags);
+	}
+	return work;
+}
+
 static int prealloc (struct list_head *list, struct usb_ep *ep,
 			unsigned n, gfp_t gfp_flags)
 {
@@ -1894,12 +1958,15 @@ static void eth_work (struct work_struct *work)
 		DEBUG (dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void tx_pack_flush (struct eth_dev *dev);
+
 static void tx_complete (struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context;
 	struct eth_dev	*dev = ep->driver_data;
+	int		status = req->status;
 
-	switch (req->status) {
+	switch (status) {
 	default:
 		dev->stats.tx_errors++;
 		VDEBUG (dev, "tx err %d\n", req->status);
@@ -1910,7 +1977,7 @@ static void tx_complete (struct usb_ep *ep, struct usb_request *req)
 	case 0:
 		dev->stats.tx_bytes += skb->len;
 	}
-	dev->stats.tx_packets++;
+	dev->stats.tx_packets += TX_FRAMES(skb);
 
 	spin_lock(&dev->req_lock);
 	list_add (&req->list, &dev->tx_reqs);
@@ -1918,6 +1985,11 @@ static void tx_complete (struct usb_ep *ep, struct usb_request *req)
 	dev_kfree_skb_any (skb);
 
 	atomic_dec (&dev->tx_qlen);
+
+	/* send whatever got packed while this one was in flight */
+	if (status != -ESHUTDOWN && status != -ECONNRESET)
+		tx_pack_flush (dev);
+
 	if (netif_carrier_ok (dev->net))
 		netif_wake_queue (dev->net);
 }
@@ -1930,11 +2002,185 @@ static inline int eth_is_promisc (struct eth_dev *dev)
 	return dev->cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
-static int eth_start_xmit (struct sk_buff *skb, struct net_device *net)
+/* give back an unused tx request */
+static void tx_req_put (struct eth_dev *dev, struct usb_request *req)
 {
-	struct eth_dev		*dev = netdev_priv(net);
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (list_empty (&dev->tx_reqs))
+		netif_start_queue (dev->net);
+	list_add (&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
+/* queue a tx request whose context is the skb to send */
+static void tx_submit (struct eth_dev *dev, struct usb_request *req)
+{
+	struct sk_buff		*skb = req->context;
 	int			length = skb->len;
 	int			retval;
+
+	req->buf = skb->data;
+	req->complete = tx_complete;
+
+	/* use zlp framing on tx for strict CDC-Ether conformance,
+	 * though any robust network rx path ignores extra padding.
+	 * and some hardware doesn't like to write zlps.
+	 */
+	req->zero = 1;
+	if (!dev->zlp && (length % dev->in_ep->maxpacket) == 0)
+		length++;
+
+	req->length = length;
+
+	/* throttle highspeed IRQ rate back slightly */
+	if (gadget_is_dualspeed(dev->gadget))
+		req->no_interrupt = (dev->gadget->speed == USB_SPEED_HIGH)
+			? ((atomic_read(&dev->tx_qlen) % qmult) != 0)
+			: 0;
+
+	retval = usb_ep_queue (dev->in_ep, req, GFP_ATOMIC);
+	switch (retval) {
+	default:
+		DEBUG (dev, "tx queue err %d\n", retval);
+		dev->stats.tx_dropped += TX_FRAMES(skb);
+		dev_kfree_skb_any (skb);
+		tx_req_put (dev, req);
+		break;
+	case 0:
+		dev->net->trans_start = jiffies;
+		atomic_inc (&dev->tx_qlen);
+	}
+}
+
+/*
+ * RNDIS tx batching.  While a transfer is in flight, frames are packed
+ * into dev->tx_pack as consecutive packet messages, and tx_complete()
+ * sends whatever has accumulated.  With nothing in flight a frame goes
+ * out at once, so a lightly loaded link sees no added latency.
+ *
+ * Returns how many bytes one transfer may hold, or zero when packing
+ * is off: rndis_pkts is 1, or the host hasn't said it takes more than
+ * one packet per transfer (Linux hosts don't).
+ */
+static unsigned tx_pack_max (struct eth_dev *dev)
+{
+	u32		max;
+
+	max = min_t (u32, rndis_host_max_transfer (dev->rndis_config),
+		     rndis_pkts * RNDIS_PACKET_LEN (ETH_FRAME_LEN));
+	/* tx_submit() may add a byte to avoid a zlp */
+	if (rndis_pkts < 2
+			|| max < 2 * RNDIS_PACKET_LEN (ETH_HLEN + dev->net->mtu))
+		return 0;
+	return max - 1;
+}
+
+static void tx_pack_flush (struct eth_dev *dev)
+{
+	struct usb_request	*req;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = dev->tx_pack;
+	dev->tx_pack = NULL;
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (req)
+		tx_submit (dev, req);
+}
+
+/* the tx queue is stopped and the IN endpoint disabled */
+static void tx_pack_discard (struct eth_dev *dev)
+{
+	struct usb_request	*req;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = dev->tx_pack;
+	dev->tx_pack = NULL;
+	if (req) {
+		dev->stats.tx_dropped +=
+			TX_FRAMES((struct sk_buff *) req->context);
+		dev_kfree_skb_any (req->context);
+		list_add (&req->list, &dev->tx_reqs);
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
+static int tx_pack (struct eth_dev *dev, struct sk_buff *skb, unsigned max)
+{
+	struct usb_request	*req, *full = NULL;
+	struct sk_buff		*xfer = NULL;
+	unsigned		len = RNDIS_PACKET_LEN (skb->len);
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+
+	req = dev->tx_pack;
+	if (req) {
+		xfer = req->context;
+		if (xfer->len + len > max) {
+			/* the full one goes once there's a request for
+			 * this frame; else tx_complete() sends it
+			 */
+			if (list_empty (&dev->tx_reqs)) {
+				netif_stop_queue (dev->net);
+				spin_unlock_irqrestore(&dev->req_lock, flags);
+				return 1;
+			}
+			full = req;
+			req = NULL;
+		}
+	} else if (list_empty (&dev->tx_reqs)) {
+		/* all requests in flight, see eth_start_xmit() */
+		netif_stop_queue (dev->net);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return 1;
+	}
+
+	if (!req) {
+		xfer = alloc_skb (max + 1, GFP_ATOMIC);
+		if (!xfer) {
+			dev->tx_pack = NULL;
+			spin_unlock_irqrestore(&dev->req_lock, flags);
+			dev->stats.tx_dropped++;
+			dev_kfree_skb_any (skb);
+			if (full)
+				tx_submit (dev, full);
+			return 0;
+		}
+		TX_FRAMES(xfer) = 0;
+
+		req = container_of (dev->tx_reqs.next,
+				struct usb_request, list);
+		list_del (&req->list);
+		req->context = xfer;
+		dev->tx_pack = req;
+	}
+
+	rndis_append_packet (xfer, skb);
+	TX_FRAMES(xfer)++;
+
+	/* nothing in flight to wait for? */
+	if (!full && !atomic_read (&dev->tx_qlen))
+		dev->tx_pack = NULL;
+	else
+		req = NULL;
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	dev_kfree_skb_any (skb);
+	if (full)
+		tx_submit (dev, full);
+	if (req)
+		tx_submit (dev, req);
+	return 0;
+}
+
+static int eth_start_xmit (struct sk_buff *skb, struct net_device *net)
+{
+	struct eth_dev		*dev = netdev_priv(net);
 	struct usb_request	*req = NULL;
 	unsigned long		flags;
 
@@ -1960,6 +2206,13 @@ static int eth_start_xmit (struct sk_buff *skb, struct net_device *net)
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	if (rndis_active(dev)) {
+		unsigned	max = tx_pack_max (dev);
+
+		if (max && RNDIS_PACKET_LEN (skb->len) <= max)
+			return tx_pack (dev, skb, max);
+	}
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -1994,48 +2247,16 @@ static int eth_start_xmit (struct sk_buff *skb, struct net_device *net)
 		dev_kfree_skb_any (skb);
 		skb = skb_rndis;
 		rndis_add_hdr (skb);
-		length = skb->len;
 	}
-	req->buf = skb->data;
+	TX_FRAMES(skb) = 1;
 	req->context = skb;
-	req->complete = tx_complete;
-
-	/* use zlp framing on tx for strict CDC-Ether conformance,
-	 * though any robust network rx path ignores extra padding.
-	 * and some hardware doesn't like to write zlps.
-	 */
-	req->zero = 1;
-	if (!dev->zlp && (length % dev->in_ep->maxpacket) == 0)
-		length++;
-
-	req->length = length;
-
-	/* throttle highspeed IRQ rate back slightly */
-	if (gadget_is_dualspeed(dev->gadget))
-		req->no_interrupt = (dev->gadget->speed == USB_SPEED_HIGH)
-			? ((atomic_read(&dev->tx_qlen) % qmult) != 0)
-			: 0;
-
-	retval = usb_ep_queue (dev->in_ep, req, GFP_ATOMIC);
-	switch (retval) {
-	default:
-		DEBUG (dev, "tx queue err %d\n", retval);
-		break;
-	case 0:
-		net->trans_start = jiffies;
-		atomic_inc (&dev->tx_qlen);
-	}
+	tx_submit (dev, req);
+	return 0;
 
-	if (retval) {
 drop:
-		dev->stats.tx_dropped++;
-		dev_kfree_skb_any (skb);
-		spin_lock_irqsave(&dev->req_lock, flags);
-		if (list_empty (&dev->tx_reqs))
-			netif_start_queue (net);
-		list_add (&req->list, &dev->tx_reqs);
-		spin_unlock_irqrestore(&dev->req_lock, flags);
-	}
+	dev->stats.tx_dropped++;
+	dev_kfree_skb_any (skb);
+	tx_req_put (dev, req);
 	return 0;
 }
 
@@ -2137,6 +2358,7 @@ static int eth_open (struct net_device *net)
 	struct eth_dev		*dev = netdev_priv(net);
 
 	DEBUG (dev, "%s\n", __FUNCTION__);
+	napi_enable (&dev->napi);
 	if (netif_carrier_ok (dev->net))
 		eth_start (dev, GFP_KERNEL);
 	return 0;
@@ -2158,6 +2380,7 @@ static int eth_stop (struct net_device *net)
 	if (dev->config) {
 		usb_ep_disable (dev->in_ep);
 		usb_ep_disable (dev->out_ep);
+		tx_pack_discard (dev);
 		if (netif_carrier_ok (dev->net)) {
 			DEBUG (dev, "host still using in/out endpoints\n");
 			// FIXME idiom may leave toggle wrong here
@@ -2175,6 +2398,9 @@ static int eth_stop (struct net_device *net)
 		(void) rndis_signal_disconnect (dev->rndis_config);
 	}
 
+	napi_disable (&dev->napi);
+	skb_queue_purge (&dev->rx_frames);
+
 	return 0;
 }
 
@@ -2465,6 +2691,7 @@ autoconf_fail:
 	INIT_WORK (&dev->work, eth_work);
 	INIT_LIST_HEAD (&dev->tx_reqs);
 	INIT_LIST_HEAD (&dev->rx_reqs);
+	skb_queue_head_init (&dev->rx_frames);
 
 	/* network device setup */
 	dev->net = net;
@@ -2507,6 +2734,7 @@ autoconf_fail:
 	net->hard_start_xmit = eth_start_xmit;
 	net->open = eth_open;
 	net->stop = eth_stop;
+	netif_napi_add (net, &dev->napi, eth_poll, ETH_NAPI_WEIGHT);
 	// watchdog_timeo, tx_timeout ...
 	// set_multicast_list
 	SET_ETHTOOL_OPS(net, &ops);
@@ -2588,6 +2816,8 @@ fail0:
 		if (rndis_set_param_medium(dev->rndis_config,
 					NDIS_MEDIUM_802_3, 0))
 			goto fail0;
+		if (rndis_set_param_transfer(dev->rndis_config, rndis_pkts))
+			goto fail0;
 		INFO (dev, "RNDIS ready\n");
 	}
 
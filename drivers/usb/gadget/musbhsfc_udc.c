@@ -26,6 +26,7 @@
  */
 
 #include <linux/platform_device.h>
+#include <linux/completion.h>
 #include "musbhsfc_udc.h"
 #include <asm/dcr-native.h>
 #include <asm/FlyerII.h>
@@ -50,6 +51,9 @@
 
 struct musbhsfc_udc *the_controller;
 
+/* udc_init() runs as an async initcall; completed once it has probed */
+static DECLARE_COMPLETION(udc_init_done);
+
 static const char driver_name[] = "musbhsfc_udc";
 static const char driver_desc[] = DRIVER_DESC;
 static const char ep0name[] = "ep0-control";
@@ -477,7 +481,7 @@ static void udc_enable(struct musbhsfc_udc *dev)
 */
 int usb_gadget_register_driver(struct usb_gadget_driver *driver)
 {
-	struct musbhsfc_udc *dev = the_controller;
+	struct musbhsfc_udc *dev;
 	int retval;
 
 	DEBUG("%s: %s\n", __FUNCTION__, driver->driver.name);
@@ -487,6 +491,10 @@ int usb_gadget_register_driver(struct usb_gadget_driver *driver)
 	    || (driver->speed > USB_SPEED_HIGH)
 	    || !driver->bind || !driver->disconnect || !driver->setup)
 		return -EINVAL;
+
+	/* A built-in gadget driver may get here before udc_init() is done */
+	wait_for_completion(&udc_init_done);
+	dev = the_controller;
 	if (!dev)
 		return -ENODEV;
 	if (dev->driver)
@@ -2373,11 +2381,29 @@ static int musbhsfc_udc_remove(struct platform_device *pdev)
 	return 0;
 }
 
+/*
+ * Before reboot or kexec, drop off the bus so the host sees a disconnect
+ * and enumerates whatever comes up next from scratch.
+ */
+static void musbhsfc_udc_shutdown(struct platform_device *pdev)
+{
+	struct musbhsfc_udc *dev = platform_get_drvdata(pdev);
+
+	DEBUG("%s: %p\n", __FUNCTION__, dev);
+
+	if (!dev)
+		return;
+
+	musbhsfc_udc_pullup(&dev->gadget, 0);
+	udc_disable(dev);
+}
+
 /*-------------------------------------------------------------------------*/
 
 static struct platform_driver udc_driver = {
 	.probe = musbhsfc_udc_probe,
 	.remove = musbhsfc_udc_remove,
+	.shutdown = musbhsfc_udc_shutdown,
 	    /* FIXME power management support */
 	    /* .suspend = ... disable UDC */
 	    /* .resume = ... re-enable UDC */
@@ -2391,6 +2417,7 @@ static int __init udc_init(void)
 {
 	
 	u32 temp;
+	int ret;
 	printk("%s: %s version %s\n", __FUNCTION__, driver_name, DRIVER_VERSION);
 	temp = SDR_READ(DCRN_SDR_USB0);
 	temp = temp | 0x2;
@@ -2398,7 +2425,10 @@ static int __init udc_init(void)
 	temp = SDR_READ(DCRN_SDR_USB0);
 	
 	printk("%s: %s version %s\n", __FUNCTION__, driver_name, DRIVER_VERSION);
-	return platform_driver_register(&udc_driver);
+	ret = platform_driver_register(&udc_driver);
+	/* the probe has run (or failed), the_controller is final */
+	complete_all(&udc_init_done);
+	return ret;
 }
 
 static void __exit udc_exit(void)
@@ -2406,7 +2436,7 @@ static void __exit udc_exit(void)
 	platform_driver_unregister(&udc_driver);
 }
 
-module_init(udc_init);
+async_initcall(udc_init);
 module_exit(udc_exit);
 
 MODULE_DESCRIPTION(DRIVER_DESC);
@@ -815,10 +815,17 @@ update_linkstate:
  * Response Functions
  */
 
+/* one packet, with its RNDIS header, as the host may send it */
+static u32 rndis_packet_len (rndis_params *params)
+{
+	return RNDIS_PACKET_LEN (params->dev->mtu + sizeof (struct ethhdr) + 22);
+}
+
 static int rndis_init_response (int configNr, rndis_init_msg_type *buf)
 {
 	rndis_init_cmplt_type	*resp;
 	rndis_resp_t            *r;
+	rndis_params		*params = rndis_per_dev_params + configNr;
 
 	if (!rndis_per_dev_params [configNr].dev) return -ENOTSUPP;
 
@@ -827,6 +834,19 @@ static int rndis_init_response (int configNr, rndis_init_msg_type *buf)
 		return -ENOMEM;
 	resp = (rndis_init_cmplt_type *) r->buf;
 
+	/* how much we may pack into one transfer to the host */
+	params->host_max_transfer = le32_to_cpu (buf->MaxTransferSize);
+
+	/* Only offer multi-packet transfers to a host that takes them
+	 * itself; the others (Linux rndis_host) send one packet per
+	 * transfer, and get rx buffers sized for that.
+	 */
+	if (params->host_max_transfer >= 2 * RNDIS_PACKET_LEN (
+			params->dev->mtu + sizeof (struct ethhdr)))
+		params->pkts = params->max_pkts;
+	else
+		params->pkts = 1;
+
 	resp->MessageType = __constant_cpu_to_le32 (
 			REMOTE_NDIS_INITIALIZE_CMPLT);
 	resp->MessageLength = __constant_cpu_to_le32 (52);
@@ -836,13 +856,11 @@ static int rndis_init_response (int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = __constant_cpu_to_le32 (RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = __constant_cpu_to_le32 (RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = __constant_cpu_to_le32 (RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = __constant_cpu_to_le32 (1);
-	resp->MaxTransferSize = cpu_to_le32 (
-		  rndis_per_dev_params [configNr].dev->mtu
-		+ sizeof (struct ethhdr)
-		+ sizeof (struct rndis_packet_msg_type)
-		+ 22);
-	resp->PacketAlignmentFactor = __constant_cpu_to_le32 (0);
+	resp->MaxPacketsPerTransfer = cpu_to_le32 (params->pkts);
+	resp->MaxTransferSize = cpu_to_le32 (params->pkts
+			* rndis_packet_len (params));
+	/* 2^3 == RNDIS_PACKET_ALIGN */
+	resp->PacketAlignmentFactor = __constant_cpu_to_le32 (3);
 	resp->AFListOffset = __constant_cpu_to_le32 (0);
 	resp->AFListSize = __constant_cpu_to_le32 (0);
 
@@ -1043,6 +1061,8 @@ void rndis_uninit (int configNr)
 		return;
 	rndis_per_dev_params [configNr].used = 0;
 	rndis_per_dev_params [configNr].state = RNDIS_UNINITIALIZED;
+	rndis_per_dev_params [configNr].host_max_transfer = 0;
+	rndis_per_dev_params [configNr].pkts = 1;
 
 	/* drain the response queue */
 	while ((buf = rndis_get_next_response(configNr, &length)))
@@ -1220,6 +1240,33 @@ int rndis_set_param_medium (u8 configNr, u32 medium, u32 speed)
 	return 0;
 }
 
+int rndis_set_param_transfer (u8 configNr, u32 max_pkts)
+{
+	DBG("%s: %u\n", __FUNCTION__, max_pkts);
+	if (configNr >= RNDIS_MAX_CONFIGS) return -1;
+
+	rndis_per_dev_params [configNr].max_pkts = max_pkts ? : 1;
+
+	return 0;
+}
+
+/* largest transfer the host may send us; the receive buffer size.
+ * Sized for max_pkts from the start: the rx requests are queued at
+ * SET_CONFIGURATION, before INITIALIZE decides what the host is offered.
+ */
+u32 rndis_max_transfer (int configNr)
+{
+	rndis_params	*params = rndis_per_dev_params + configNr;
+
+	return params->max_pkts * rndis_packet_len (params);
+}
+
+/* largest transfer we may send the host, zero before it initialized us */
+u32 rndis_host_max_transfer (int configNr)
+{
+	return rndis_per_dev_params [configNr].host_max_transfer;
+}
+
 void rndis_add_hdr (struct sk_buff *skb)
 {
 	struct rndis_packet_msg_type	*header;
@@ -1234,6 +1281,27 @@ void rndis_add_hdr (struct sk_buff *skb)
 	header->DataLength = cpu_to_le32(skb->len - sizeof *header);
 }
 
+/* Append skb as one more packet message of a multi-packet transfer; the
+ * caller has made sure RNDIS_PACKET_LEN(skb->len) bytes are free in xfer.
+ */
+void rndis_append_packet (struct sk_buff *xfer, const struct sk_buff *skb)
+{
+	struct rndis_packet_msg_type	*header;
+	unsigned			len = RNDIS_PACKET_LEN (skb->len);
+	u8				*data;
+
+	header = (void *) skb_put (xfer, len);
+	memset (header, 0, sizeof *header);
+	header->MessageType = __constant_cpu_to_le32(REMOTE_NDIS_PACKET_MSG);
+	header->MessageLength = cpu_to_le32(len);
+	header->DataOffset = __constant_cpu_to_le32 (36);
+	header->DataLength = cpu_to_le32(skb->len);
+
+	data = (u8 *) (header + 1);
+	skb_copy_bits (skb, 0, data, skb->len);
+	memset (data + skb->len, 0, len - sizeof *header - skb->len);
+}
+
 void rndis_free_response (int configNr, u8 *buf)
 {
 	rndis_resp_t		*r;
@@ -1288,24 +1356,68 @@ static rndis_resp_t *rndis_add_response (int configNr, u32 length)
 	return r;
 }
 
-int rndis_rm_hdr(struct sk_buff *skb)
+/* Split a received transfer into its packet messages and queue their
+ * frames on the frames list; skb itself is consumed.  The last frame
+ * takes over skb, the others are copied out of it: a clone would carry
+ * the whole transfer buffer's truesize and overcharge socket buffers.
+ * Returns the number of frames queued, or a negative errno if the
+ * transfer is bad (frames before the bad message are still queued).
+ */
+int rndis_rm_hdr(struct sk_buff *skb, struct sk_buff_head *frames)
 {
-	/* tmp points to a struct rndis_packet_msg_type */
-	__le32		*tmp = (void *) skb->data;
+	int		count = 0;
+	int		status = 0;
+
+	/* senders may pad the transfer after the last message */
+	while (skb->len >= sizeof (struct rndis_packet_msg_type)) {
+		/* tmp points to a struct rndis_packet_msg_type */
+		__le32		*tmp = (void *) skb->data;
+		u32		msg_len, data_offset, data_len;
+		struct sk_buff	*frame;
+
+		/* MessageType, MessageLength */
+		if (__constant_cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				!= get_unaligned(tmp++)) {
+			if (!count)
+				status = -EINVAL;
+			break;
+		}
+		msg_len = le32_to_cpu(get_unaligned(tmp++));
+
+		/* DataOffset, DataLength */
+		data_offset = le32_to_cpu(get_unaligned(tmp++))
+				+ 8 /* offset of DataOffset */;
+		data_len = le32_to_cpu(get_unaligned(tmp++));
+		if (msg_len < sizeof (struct rndis_packet_msg_type)
+				|| msg_len > skb->len || data_offset > msg_len
+				|| data_len > msg_len - data_offset) {
+			status = -EOVERFLOW;
+			break;
+		}
+
+		if (skb->len - msg_len < sizeof (struct rndis_packet_msg_type)) {
+			skb_pull(skb, data_offset);
+			skb_trim(skb, data_len);
+			__skb_queue_tail(frames, skb);
+			return count + 1;
+		}
 
-	/* MessageType, MessageLength */
-	if (__constant_cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
-			!= get_unaligned(tmp++))
-		return -EINVAL;
-	tmp++;
+		frame = alloc_skb(data_len + NET_IP_ALIGN, GFP_ATOMIC);
+		if (!frame) {
+			status = -ENOMEM;
+			break;
+		}
+		skb_reserve(frame, NET_IP_ALIGN);
+		memcpy(skb_put(frame, data_len), skb->data + data_offset,
+				data_len);
+		__skb_queue_tail(frames, frame);
+		count++;
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, le32_to_cpu(get_unaligned(tmp++))
-			+ 8 /* offset of DataOffset */))
-		return -EOVERFLOW;
-	skb_trim(skb, le32_to_cpu(get_unaligned(tmp++)));
+		skb_pull(skb, msg_len);
+	}
 
-	return 0;
+	dev_kfree_skb_any(skb);
+	return status ? status : count;
 }
 
 #ifdef	CONFIG_USB_GADGET_DEBUG_FILES
@@ -1438,6 +1550,8 @@ int __devinit rndis_init (void)
 		rndis_per_dev_params [i].state = RNDIS_UNINITIALIZED;
 		rndis_per_dev_params [i].media_state
 				= NDIS_MEDIA_STATE_DISCONNECTED;
+		rndis_per_dev_params [i].max_pkts = 1;
+		rndis_per_dev_params [i].pkts = 1;
 		INIT_LIST_HEAD (&(rndis_per_dev_params [i].resp_queue));
 	}
 
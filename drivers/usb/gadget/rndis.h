@@ -197,6 +197,15 @@ struct rndis_packet_msg_type
 	__le32	Reserved;
 } __attribute__ ((packed));
 
+/* Packet messages sharing a transfer each start on this boundary; the
+ * padding is counted in MessageLength.  Eight keeps the IP header of
+ * every packed frame aligned.
+ */
+#define RNDIS_PACKET_ALIGN		8
+#define RNDIS_PACKET_LEN(datalen) \
+	ALIGN(sizeof (struct rndis_packet_msg_type) + (datalen), \
+		RNDIS_PACKET_ALIGN)
+
 struct rndis_config_parameter
 {
 	__le32	ParameterNameOffset;
@@ -241,6 +250,10 @@ typedef struct rndis_params
 	const char		*vendorDescr;
 	int			(*ack) (struct net_device *);
 	struct list_head	resp_queue;
+
+	u32			max_pkts;	/* we take per transfer */
+	u32			pkts;		/* ... and offered the host */
+	u32			host_max_transfer;
 } rndis_params;
 
 /* RNDIS Message parser and other useless functions */
@@ -253,8 +266,12 @@ int  rndis_set_param_dev (u8 configNr, struct net_device *dev,
 int  rndis_set_param_vendor (u8 configNr, u32 vendorID,
 			    const char *vendorDescr);
 int  rndis_set_param_medium (u8 configNr, u32 medium, u32 speed);
+int  rndis_set_param_transfer (u8 configNr, u32 max_pkts);
+u32  rndis_max_transfer (int configNr);
+u32  rndis_host_max_transfer (int configNr);
 void rndis_add_hdr (struct sk_buff *skb);
-int rndis_rm_hdr (struct sk_buff *skb);
+void rndis_append_packet (struct sk_buff *xfer, const struct sk_buff *skb);
+int rndis_rm_hdr (struct sk_buff *skb, struct sk_buff_head *frames);
 u8   *rndis_get_next_response (int configNr, u32 *length);
 void rndis_free_response (int configNr, u8 *buf);
 
@@ -35,6 +35,7 @@
 #include <linux/delay.h>
 #include <linux/kthread.h>
 #include <linux/freezer.h>
+#include <linux/netcache.h>
 #include "cifsfs.h"
 #include "cifspdu.h"
 #define DECLARE_GLOBALS_HERE
@@ -278,12 +279,14 @@ cifs_alloc_inode(struct super_block *sb)
 	   to zero by the VFS */
 /*	cifs_inode->vfs_inode.i_flags = S_NOATIME | S_NOCMTIME;*/
 	INIT_LIST_HEAD(&cifs_inode->openFileList);
+	cifs_inode->netcache = NULL;
 	return &cifs_inode->vfs_inode;
 }
 
 static void
 cifs_destroy_inode(struct inode *inode)
 {
+	netcache_relinquish(CIFS_I(inode)->netcache);
 	kmem_cache_free(cifs_inode_cachep, CIFS_I(inode));
 }
 
@@ -320,8 +323,11 @@ cifs_show_options(struct seq_file *s, struct vfsmount *m)
 		}
 		if (cifs_sb->mnt_cifs_flags & CIFS_MOUNT_POSIX_PATHS)
 			seq_printf(s, ",posixpaths");
+		if (cifs_sb->mnt_cifs_flags & CIFS_MOUNT_FSCACHE)
+			seq_printf(s, ",fsc");
 		seq_printf(s, ",rsize=%d", cifs_sb->rsize);
 		seq_printf(s, ",wsize=%d", cifs_sb->wsize);
+		seq_printf(s, ",pipeline=%d", cifs_sb->pipeline);
 	}
 	return 0;
 }
@@ -887,6 +893,7 @@ static int cifs_oplock_thread(void *dummyarg)
 									 == 0) {
 						waitrc = filemap_fdatawait(inode->i_mapping);
 						invalidate_remote_inode(inode);
+						netcache_stale(CIFS_I(inode)->netcache);
 					}
 					if (rc == 0)
 						rc = waitrc;
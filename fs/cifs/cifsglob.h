@@ -47,6 +47,14 @@
  */
 #define CIFS_MAX_REQ 50
 
+/*
+ * Reads and writes of one file that cifs_readpages and cifs_writepages
+ * keep on the wire at once ("pipeline=" mount option).  1 waits for each
+ * response before sending the next request.
+ */
+#define CIFS_DEF_PIPELINE 4
+#define CIFS_MAX_PIPELINE 16
+
 #define SERVER_NAME_LENGTH 15
 #define SERVER_NAME_LEN_WITH_NULL     (SERVER_NAME_LENGTH + 1)
 
@@ -367,6 +375,7 @@ struct cifsInodeInfo {
 	unsigned clientCanCacheRead:1; /* read oplock */
 	unsigned clientCanCacheAll:1;  /* read and writebehind oplock */
 	unsigned oplockPending:1;
+	struct netcache_cookie *netcache; /* local copy, if mounted with fsc */
 	struct inode vfs_inode;
 };
 
@@ -483,6 +492,7 @@ struct dir_notify_req {
 #define   CIFS_LOG_ERROR    0x010    /* log NT STATUS if non-zero */
 #define   CIFS_LARGE_BUF_OP 0x020    /* large request buffer */
 #define   CIFS_NO_RESP      0x040    /* no response buffer required */
+#define   CIFS_NO_SRV_WAIT  0x080    /* -EBUSY rather than wait for a slot */
 
 /* Security Flags: indicate type of session setup needed */
 #define   CIFSSEC_MAY_SIGN	0x00001
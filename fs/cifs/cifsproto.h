@@ -53,6 +53,13 @@ extern int SendReceiveNoRsp(const unsigned int xid, struct cifsSesInfo *ses,
 extern int SendReceive2(const unsigned int /* xid */ , struct cifsSesInfo *,
 			struct kvec *, int /* nvec to send */,
 			int * /* type of buf returned */ , const int flags);
+extern int cifs_send_async(const unsigned int /* xid */, struct cifsSesInfo *,
+			struct kvec *, int /* nvec to send */,
+			struct mid_q_entry ** /* mid to wait on */,
+			const int flags);
+extern int cifs_wait_async(const unsigned int /* xid */, struct cifsSesInfo *,
+			struct mid_q_entry *, struct kvec *,
+			int * /* type of buf returned */, const int flags);
 extern int SendReceiveBlockingLock(const unsigned int /* xid */ ,
 					struct cifsTconInfo *,
 				struct smb_hdr * /* input */ ,
@@ -266,6 +273,14 @@ extern int CIFSSMBRead(const int xid, struct cifsTconInfo *tcon,
 			const int netfid, unsigned int count,
 			const __u64 lseek, unsigned int *nbytes, char **buf,
 			int *return_buf_type);
+extern int CIFSSMBReadSend(const int xid, struct cifsTconInfo *tcon,
+			const int netfid, const unsigned int count,
+			const __u64 lseek, struct mid_q_entry **ppmidQ,
+			const int flags);
+extern int CIFSSMBReadWait(const int xid, struct cifsTconInfo *tcon,
+			struct mid_q_entry *midQ, const unsigned int count,
+			unsigned int *nbytes, char **buf, int *return_buf_type,
+			const int flags);
 extern int CIFSSMBWrite(const int xid, struct cifsTconInfo *tcon,
 			const int netfid, const unsigned int count,
 			const __u64 lseek, unsigned int *nbytes,
@@ -275,6 +290,13 @@ extern int CIFSSMBWrite2(const int xid, struct cifsTconInfo *tcon,
 			const int netfid, const unsigned int count,
 			const __u64 offset, unsigned int *nbytes,
 			struct kvec *iov, const int nvec, const int long_op);
+extern int CIFSSMBWrite2Send(const int xid, struct cifsTconInfo *tcon,
+			const int netfid, const unsigned int count,
+			const __u64 offset, struct kvec *iov, int n_vec,
+			struct mid_q_entry **ppmidQ, const int flags);
+extern int CIFSSMBWrite2Wait(const int xid, struct cifsTconInfo *tcon,
+			struct mid_q_entry *midQ, unsigned int *nbytes,
+			const int flags);
 extern int CIFSGetSrvInodeNumber(const int xid, struct cifsTconInfo *tcon,
 			const unsigned char *searchName, __u64 *inode_number,
 			const struct nls_table *nls_codepage,
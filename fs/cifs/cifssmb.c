@@ -1383,17 +1383,19 @@ openRetry:
 	return rc;
 }
 
+/*
+ * Send a read request without waiting for the response, so that several
+ * reads of one file can be outstanding at once (see cifs_readpages).  The
+ * caller must collect the result with CIFSSMBReadWait.
+ */
 int
-CIFSSMBRead(const int xid, struct cifsTconInfo *tcon, const int netfid,
-	    const unsigned int count, const __u64 lseek, unsigned int *nbytes,
-	    char **buf, int *pbuf_type)
+CIFSSMBReadSend(const int xid, struct cifsTconInfo *tcon, const int netfid,
+		const unsigned int count, const __u64 lseek,
+		struct mid_q_entry **ppmidQ, const int flags)
 {
 	int rc = -EACCES;
 	READ_REQ *pSMB = NULL;
-	READ_RSP *pSMBr = NULL;
-	char *pReadData = NULL;
 	int wct;
-	int resp_buf_type = 0;
 	struct kvec iov[1];
 
 	cFYI(1, ("Reading %d bytes on fid %d", count, netfid));
@@ -1402,7 +1404,6 @@ CIFSSMBRead(const int xid, struct cifsTconInfo *tcon, const int netfid,
 	else
 		wct = 10; /* old style read */
 
-	*nbytes = 0;
 	rc = small_smb_init(SMB_COM_READ_ANDX, wct, tcon, (void **) &pSMB);
 	if (rc)
 		return rc;
@@ -1433,8 +1434,35 @@ CIFSSMBRead(const int xid, struct cifsTconInfo *tcon, const int netfid,
 
 	iov[0].iov_base = (char *)pSMB;
 	iov[0].iov_len = pSMB->hdr.smb_buf_length + 4;
-	rc = SendReceive2(xid, tcon->ses, iov, 1 /* num iovecs */,
-			 &resp_buf_type, CIFS_STD_OP | CIFS_LOG_ERROR);
+	rc = cifs_send_async(xid, tcon->ses, iov, 1 /* num iovecs */,
+			     ppmidQ, flags);
+	if (rc && rc != -EBUSY) {
+		cifs_stats_inc(&tcon->num_reads);
+		cERROR(1, ("Send error in read = %d", rc));
+	}
+	return rc;
+}
+
+/*
+ * Collect the response to a read sent by CIFSSMBReadSend.  count must be
+ * the count the request was sent with.  buf and pbuf_type as for
+ * CIFSSMBRead.
+ */
+int
+CIFSSMBReadWait(const int xid, struct cifsTconInfo *tcon,
+		struct mid_q_entry *midQ, const unsigned int count,
+		unsigned int *nbytes, char **buf, int *pbuf_type,
+		const int flags)
+{
+	int rc;
+	READ_RSP *pSMBr = NULL;
+	char *pReadData = NULL;
+	int resp_buf_type = 0;
+	struct kvec iov[1];
+
+	*nbytes = 0;
+	iov[0].iov_base = NULL;
+	rc = cifs_wait_async(xid, tcon->ses, midQ, iov, &resp_buf_type, flags);
 	cifs_stats_inc(&tcon->num_reads);
 	pSMBr = (READ_RSP *)iov[0].iov_base;
 	if (rc) {
@@ -1484,6 +1512,23 @@ CIFSSMBRead(const int xid, struct cifsTconInfo *tcon, const int netfid,
 	return rc;
 }
 
+int
+CIFSSMBRead(const int xid, struct cifsTconInfo *tcon, const int netfid,
+	    const unsigned int count, const __u64 lseek, unsigned int *nbytes,
+	    char **buf, int *pbuf_type)
+{
+	int rc;
+	struct mid_q_entry *midQ;
+
+	*nbytes = 0;
+	rc = CIFSSMBReadSend(xid, tcon, netfid, count, lseek, &midQ,
+			     CIFS_STD_OP | CIFS_LOG_ERROR);
+	if (rc)
+		return rc;
+	return CIFSSMBReadWait(xid, tcon, midQ, count, nbytes, buf, pbuf_type,
+			       CIFS_STD_OP | CIFS_LOG_ERROR);
+}
+
 
 int
 CIFSSMBWrite(const int xid, struct cifsTconInfo *tcon,
@@ -1592,17 +1637,22 @@ CIFSSMBWrite(const int xid, struct cifsTconInfo *tcon,
 	return rc;
 }
 
+/*
+ * Send a write of the n_vec buffers following iov[0] without waiting for
+ * the response; see CIFSSMBReadSend.  The data has been handed to the
+ * socket on return, but the caller must collect the result with
+ * CIFSSMBWrite2Wait before reporting the range as written.
+ */
 int
-CIFSSMBWrite2(const int xid, struct cifsTconInfo *tcon,
-	     const int netfid, const unsigned int count,
-	     const __u64 offset, unsigned int *nbytes, struct kvec *iov,
-	     int n_vec, const int long_op)
+CIFSSMBWrite2Send(const int xid, struct cifsTconInfo *tcon,
+		  const int netfid, const unsigned int count,
+		  const __u64 offset, struct kvec *iov, int n_vec,
+		  struct mid_q_entry **ppmidQ, const int flags)
 {
 	int rc = -EACCES;
 	WRITE_REQ *pSMB = NULL;
 	int wct;
 	int smb_hdr_len;
-	int resp_buf_type = 0;
 
 	cFYI(1, ("write2 at %lld %d bytes", (long long)offset, count));
 
@@ -1652,8 +1702,25 @@ CIFSSMBWrite2(const int xid, struct cifsTconInfo *tcon,
 		iov[0].iov_len = smb_hdr_len + 8;
 
 
-	rc = SendReceive2(xid, tcon->ses, iov, n_vec + 1, &resp_buf_type,
-			  long_op);
+	rc = cifs_send_async(xid, tcon->ses, iov, n_vec + 1, ppmidQ, flags);
+	if (rc && rc != -EBUSY) {
+		cifs_stats_inc(&tcon->num_writes);
+		cFYI(1, ("Send error Write2 = %d", rc));
+	}
+	return rc;
+}
+
+int
+CIFSSMBWrite2Wait(const int xid, struct cifsTconInfo *tcon,
+		  struct mid_q_entry *midQ, unsigned int *nbytes,
+		  const int flags)
+{
+	int rc;
+	int resp_buf_type = 0;
+	struct kvec iov[1];
+
+	iov[0].iov_base = NULL;
+	rc = cifs_wait_async(xid, tcon->ses, midQ, iov, &resp_buf_type, flags);
 	cifs_stats_inc(&tcon->num_writes);
 	if (rc) {
 		cFYI(1, ("Send error Write2 = %d", rc));
@@ -1681,6 +1748,23 @@ CIFSSMBWrite2(const int xid, struct cifsTconInfo *tcon,
 	return rc;
 }
 
+int
+CIFSSMBWrite2(const int xid, struct cifsTconInfo *tcon,
+	     const int netfid, const unsigned int count,
+	     const __u64 offset, unsigned int *nbytes, struct kvec *iov,
+	     int n_vec, const int long_op)
+{
+	int rc;
+	struct mid_q_entry *midQ;
+
+	*nbytes = 0;
+	rc = CIFSSMBWrite2Send(xid, tcon, netfid, count, offset, iov, n_vec,
+			       &midQ, long_op);
+	if (rc)
+		return rc;
+	return CIFSSMBWrite2Wait(xid, tcon, midQ, nbytes, long_op);
+}
+
 
 int
 CIFSSMBLock(const int xid, struct cifsTconInfo *tcon,
@@ -90,8 +90,10 @@ struct smb_vol {
 	unsigned nullauth:1; /* attempt to authenticate with null user */
 	unsigned nocase;     /* request case insensitive filenames */
 	unsigned nobrl;      /* disable sending byte range locks to srv */
+	unsigned fsc:1;      /* keep copies of files read in netcache */
 	unsigned int rsize;
 	unsigned int wsize;
+	unsigned int pipeline;
 	unsigned int sockopt;
 	unsigned short int port;
 	char *prepath;
@@ -828,6 +830,7 @@ cifs_parse_mount_options(char *options, const char *devname,
 	vol->rw = TRUE;
 	/* default is always to request posix paths. */
 	vol->posix_paths = 1;
+	vol->pipeline = CIFS_DEF_PIPELINE;
 
 	if (!options)
 		return 1;
@@ -1119,6 +1122,11 @@ cifs_parse_mount_options(char *options, const char *devname,
 				vol->wsize =
 					simple_strtoul(value, &value, 0);
 			}
+		} else if (strnicmp(data, "pipeline", 8) == 0) {
+			if (value && *value) {
+				vol->pipeline =
+					simple_strtoul(value, &value, 0);
+			}
 		} else if (strnicmp(data, "sockopt", 5) == 0) {
 			if (value && *value) {
 				vol->sockopt =
@@ -1225,6 +1233,10 @@ cifs_parse_mount_options(char *options, const char *devname,
 		} else if ((strnicmp(data, "nocase", 6) == 0) ||
 			   (strnicmp(data, "ignorecase", 10)  == 0)) {
 			vol->nocase = 1;
+		} else if (strnicmp(data, "fsc", 3) == 0) {
+			vol->fsc = 1;
+		} else if (strnicmp(data, "nofsc", 5) == 0) {
+			vol->fsc = 0;
 		} else if (strnicmp(data, "brl", 3) == 0) {
 			vol->nobrl =  0;
 		} else if ((strnicmp(data, "nobrl", 5) == 0) ||
@@ -2041,6 +2053,15 @@ cifs_mount(struct super_block *sb, struct cifs_sb_info *cifs_sb,
 			/* Windows ME may prefer this */
 			cFYI(1, ("readsize set to minimum: 2048"));
 		}
+
+		if (volume_info.pipeline > CIFS_MAX_PIPELINE) {
+			cERROR(1, ("pipeline %d too large, using %d",
+				   volume_info.pipeline, CIFS_MAX_PIPELINE));
+			cifs_sb->pipeline = CIFS_MAX_PIPELINE;
+		} else if (volume_info.pipeline == 0)
+			cifs_sb->pipeline = 1;
+		else
+			cifs_sb->pipeline = volume_info.pipeline;
 		/* calculate prepath */
 		cifs_sb->prepath = volume_info.prepath;
 		if (cifs_sb->prepath) {
@@ -2070,6 +2091,8 @@ cifs_mount(struct super_block *sb, struct cifs_sb_info *cifs_sb,
 			cifs_sb->mnt_cifs_flags |= CIFS_MOUNT_UNX_EMUL;
 		if (volume_info.nobrl)
 			cifs_sb->mnt_cifs_flags |= CIFS_MOUNT_NO_BRL;
+		if (volume_info.fsc)
+			cifs_sb->mnt_cifs_flags |= CIFS_MOUNT_FSCACHE;
 		if (volume_info.cifs_acl)
 			cifs_sb->mnt_cifs_flags |= CIFS_MOUNT_CIFS_ACL;
 		if (volume_info.override_uid)
@@ -30,6 +30,7 @@
 #include <linux/writeback.h>
 #include <linux/task_io_accounting_ops.h>
 #include <linux/delay.h>
+#include <linux/netcache.h>
 #include <asm/div64.h>
 #include "cifsfs.h"
 #include "cifspdu.h"
@@ -158,6 +159,50 @@ client_can_cache:
 	return rc;
 }
 
+/*
+ * With the fsc mount option, check the local copy of the file against the
+ * attributes just refreshed by the open, or drop it if the file is opened
+ * for writing.
+ */
+static void cifs_netcache_open(struct inode *inode, struct file *file,
+	const char *full_path)
+{
+	struct cifs_sb_info *cifs_sb = CIFS_SB(inode->i_sb);
+	struct cifsInodeInfo *pCifsInode = CIFS_I(inode);
+	struct netcache_cookie *cookie;
+	struct netcache_aux aux;
+	char *key;
+
+	if (!(cifs_sb->mnt_cifs_flags & CIFS_MOUNT_FSCACHE) ||
+	    !S_ISREG(inode->i_mode))
+		return;
+
+	if (pCifsInode->netcache == NULL) {
+		key = kasprintf(GFP_KERNEL, "cifs:%s%s",
+				cifs_sb->tcon->treeName, full_path);
+		if (key == NULL)
+			return;
+		cookie = netcache_acquire(key, strlen(key));
+		kfree(key);
+		spin_lock(&inode->i_lock);
+		if (pCifsInode->netcache == NULL) {
+			pCifsInode->netcache = cookie;
+			cookie = NULL;
+		}
+		spin_unlock(&inode->i_lock);
+		netcache_relinquish(cookie);
+	}
+
+	if (file->f_mode & FMODE_WRITE) {
+		netcache_invalidate(pCifsInode->netcache);
+		return;
+	}
+	aux.size = i_size_read(inode);
+	aux.mtime = inode->i_mtime;
+	aux.change = 0;		/* CIFS has no change attribute */
+	netcache_check(pCifsInode->netcache, &aux);
+}
+
 int cifs_open(struct inode *inode, struct file *file)
 {
 	int rc = -EACCES;
@@ -302,6 +347,9 @@ int cifs_open(struct inode *inode, struct file *file)
 		write_unlock(&GlobalSMBSeslock);
 	}
 
+	if (rc == 0)
+		cifs_netcache_open(inode, file, full_path);
+
 	if (oplock & CIFS_CREATE_ACTION) {
 		/* time to set mode which we can not set earlier due to
 		   problems creating new read-only files */
@@ -1194,12 +1242,73 @@ static int cifs_partialpagewrite(struct page *page, unsigned from, unsigned to)
 	return rc;
 }
 
+/*
+ * One write of a run of pages sent by cifs_writepages.  The pages are
+ * unlocked once sent but stay under writeback until the response is in.
+ */
+struct cifs_writereq {
+	struct mid_q_entry *midQ;
+	struct cifsFileInfo *open_file;
+	struct page *pages[PAGEVEC_SIZE];
+	int n_pages;
+	unsigned int bytes;
+};
+
+static void cifs_writereq_end(struct address_space *mapping,
+	struct cifs_writereq *req, int rc, unsigned int bytes_written)
+{
+	struct page *page;
+	int i;
+
+	if (req->open_file) {
+		atomic_dec(&req->open_file->wrtPending);
+		if (rc || bytes_written < req->bytes) {
+			cERROR(1, ("Write2 ret %d, wrote %d",
+				  rc, bytes_written));
+			/* BB what if continued retry is
+			   requested via mount flags? */
+			if (rc == -ENOSPC)
+				set_bit(AS_ENOSPC, &mapping->flags);
+			else
+				set_bit(AS_EIO, &mapping->flags);
+		} else {
+			cifs_stats_bytes_written(
+				CIFS_SB(mapping->host->i_sb)->tcon,
+				bytes_written);
+		}
+	}
+	for (i = 0; i < req->n_pages; i++) {
+		page = req->pages[i];
+		/* Should we also set page error on
+		success rc but too little data written? */
+		/* BB investigate retry logic on temporary
+		server crash cases and how recovery works
+		when page marked as error */
+		if (rc)
+			SetPageError(page);
+		end_page_writeback(page);
+		page_cache_release(page);
+	}
+}
+
+static int cifs_writereq_wait(struct address_space *mapping, int xid,
+	struct cifs_writereq *req)
+{
+	struct cifs_sb_info *cifs_sb = CIFS_SB(mapping->host->i_sb);
+	unsigned int bytes_written;
+	int rc;
+
+	rc = CIFSSMBWrite2Wait(xid, cifs_sb->tcon, req->midQ, &bytes_written,
+			       CIFS_LONG_OP);
+	cifs_writereq_end(mapping, req, rc, bytes_written);
+	return rc;
+}
+
 static int cifs_writepages(struct address_space *mapping,
 			   struct writeback_control *wbc)
 {
 	struct backing_dev_info *bdi = mapping->backing_dev_info;
 	unsigned int bytes_to_write;
-	unsigned int bytes_written;
 	struct cifs_sb_info *cifs_sb;
 	int done = 0;
 	pgoff_t end;
@@ -1217,6 +1326,11 @@ static int cifs_writepages(struct address_space *mapping,
 	int rc = 0;
 	int scanned = 0;
 	int xid;
+	struct cifs_writereq onereq;
+	struct cifs_writereq *reqs = &onereq;
+	struct cifs_writereq *req;
+	unsigned int window;
+	unsigned int head = 0, tail = 0;	/* reqs[tail % window] is oldest */
 
 	cifs_sb = CIFS_SB(mapping->host->i_sb);
 
@@ -1237,6 +1351,15 @@ static int cifs_writepages(struct address_space *mapping,
 	if (iov == NULL)
 		return generic_writepages(mapping, wbc);
 
+	/* keep up to cifs_sb->pipeline writes on the wire */
+	window = cifs_sb->pipeline;
+	if (window > 1)
+		reqs = kmalloc(window * sizeof(struct cifs_writereq),
+			       GFP_KERNEL);
+	if (reqs == NULL || window <= 1) {
+		reqs = &onereq;
+		window = 1;
+	}
 
 	/*
 	 * BB: Is this meaningful for a non-block-device file system?
@@ -1245,6 +1368,8 @@ static int cifs_writepages(struct address_space *mapping,
 	if (wbc->nonblocking && bdi_write_congested(bdi)) {
 		wbc->encountered_congestion = 1;
 		kfree(iov);
+		if (reqs != &onereq)
+			kfree(reqs);
 		return 0;
 	}
 
@@ -1306,8 +1431,14 @@ retry:
 				break;
 			}
 
-			if (wbc->sync_mode != WB_SYNC_NONE)
+			if (wbc->sync_mode != WB_SYNC_NONE) {
+				/* it may be under writeback by a write of
+				   ours still outstanding */
+				while (PageWriteback(page) && (head != tail))
+					rc = cifs_writereq_wait(mapping, xid,
+						&reqs[tail++ % window]);
 				wait_on_page_writeback(page);
+			}
 
 			if (PageWriteback(page) ||
 					!clear_page_dirty_for_io(page)) {
@@ -1351,55 +1482,56 @@ retry:
 				break;
 		}
 		if (n_iov) {
+			if (head - tail == window)
+				rc = cifs_writereq_wait(mapping, xid,
+							&reqs[tail++ % window]);
+			req = &reqs[head % window];
+			req->n_pages = n_iov;
+			req->bytes = bytes_to_write;
+			for (i = 0; i < n_iov; i++)
+				req->pages[i] = pvec.pages[first + i];
+
 			/* Search for a writable handle every time we call
 			 * CIFSSMBWrite2.  We can't rely on the last handle
 			 * we used to still be valid
 			 */
 			open_file = find_writable_file(CIFS_I(mapping->host));
+			req->open_file = open_file;
 			if (!open_file) {
 				cERROR(1, ("No writable handles for inode"));
 				rc = -EBADF;
 			} else {
-				rc = CIFSSMBWrite2(xid, cifs_sb->tcon,
-						   open_file->netfid,
-						   bytes_to_write, offset,
-						   &bytes_written, iov, n_iov,
-						   CIFS_LONG_OP);
-				atomic_dec(&open_file->wrtPending);
-				if (rc || bytes_written < bytes_to_write) {
-					cERROR(1, ("Write2 ret %d, wrote %d",
-						  rc, bytes_written));
-					/* BB what if continued retry is
-					   requested via mount flags? */
-					if (rc == -ENOSPC)
-						set_bit(AS_ENOSPC, &mapping->flags);
-					else
-						set_bit(AS_EIO, &mapping->flags);
-				} else {
-					cifs_stats_bytes_written(cifs_sb->tcon,
-								 bytes_written);
-				}
+				/* must not wait for a free request slot while
+				   holding slots only we will release */
+				while ((rc = CIFSSMBWrite2Send(xid,
+						cifs_sb->tcon,
+						open_file->netfid,
+						bytes_to_write, offset,
+						iov, n_iov, &req->midQ,
+						CIFS_LONG_OP | (head != tail ?
+						CIFS_NO_SRV_WAIT : 0)))
+				       == -EBUSY)
+					cifs_writereq_wait(mapping, xid,
+						&reqs[tail++ % window]);
 			}
+			/* the data has been copied to the socket */
 			for (i = 0; i < n_iov; i++) {
 				page = pvec.pages[first + i];
-				/* Should we also set page error on
-				success rc but too little data written? */
-				/* BB investigate retry logic on temporary
-				server crash cases and how recovery works
-				when page marked as error */
-				if (rc)
-					SetPageError(page);
 				kunmap(page);
 				unlock_page(page);
-				end_page_writeback(page);
-				page_cache_release(page);
 			}
+			if (rc)
+				cifs_writereq_end(mapping, req, rc, 0);
+			else
+				head++;
 			if ((wbc->nr_to_write -= n_iov) <= 0)
 				done = 1;
 			index = next;
 		}
 		pagevec_release(&pvec);
 	}
+	while (head != tail)
+		rc = cifs_writereq_wait(mapping, xid, &reqs[tail++ % window]);
 	if (!scanned && !done) {
 		/*
 		 * We hit the last page and there is more work to be done: wrap
@@ -1414,6 +1546,8 @@ retry:
 
 	FreeXid(xid);
 	kfree(iov);
+	if (reqs != &onereq)
+		kfree(reqs);
 	return rc;
 }
 
@@ -1781,6 +1915,7 @@ static void cifs_copy_cache_pages(struct address_space *mapping,
 
 		flush_dcache_page(page);
 		SetPageUptodate(page);
+		netcache_store_page(CIFS_I(mapping->host)->netcache, page);
 		unlock_page(page);
 		if (!pagevec_add(plru_pvec, page))
 			__pagevec_lru_add(plru_pvec);
@@ -1789,22 +1924,68 @@ static void cifs_copy_cache_pages(struct address_space *mapping,
 	return;
 }
 
+/*
+ * One read of a run of contiguous pages.  The pages move from the
+ * readahead list to the request's own list when it is sent, lowest index
+ * last as on the readahead list, so responses can be copied in whatever
+ * order they are collected.
+ */
+struct cifs_readreq {
+	struct list_head pages;
+	loff_t offset;
+	unsigned int size;
+	struct mid_q_entry *midQ;
+};
+
+/* take the run of contiguous pages at the tail of page_list, up to max_size */
+static void cifs_readreq_init(struct cifs_readreq *req,
+	struct list_head *page_list, unsigned int max_size)
+{
+	struct page *page, *tmp;
+	unsigned long expected_index;
+
+	INIT_LIST_HEAD(&req->pages);
+	page = list_entry(page_list->prev, struct page, lru);
+	req->offset = (loff_t)page->index << PAGE_CACHE_SHIFT;
+	req->size = 0;
+	expected_index = page->index;
+	list_for_each_entry_safe_reverse(page, tmp, page_list, lru) {
+		if ((page->index != expected_index) ||
+		    (req->size + PAGE_CACHE_SIZE > max_size))
+			break;
+		list_move(&page->lru, &req->pages);
+		req->size += PAGE_CACHE_SIZE;
+		expected_index++;
+	}
+}
+
+/* give the request's pages back to the tail of page_list to be resent */
+static void cifs_readreq_putback(struct cifs_readreq *req,
+	struct list_head *page_list)
+{
+	list_splice(&req->pages, page_list->prev);
+	INIT_LIST_HEAD(&req->pages);
+}
+
 static int cifs_readpages(struct file *file, struct address_space *mapping,
 	struct list_head *page_list, unsigned num_pages)
 {
 	int rc = -EACCES;
 	int xid;
-	loff_t offset;
-	struct page *page;
 	struct cifs_sb_info *cifs_sb;
 	struct cifsTconInfo *pTcon;
 	unsigned int bytes_read = 0;
-	unsigned int read_size, i;
 	char *smb_read_data = NULL;
 	struct smb_com_read_rsp *pSMBr;
 	struct pagevec lru_pvec;
 	struct cifsFileInfo *open_file;
 	int buf_type = CIFS_NO_BUFFER;
+	struct cifs_readreq onereq;
+	struct cifs_readreq *reqs = &onereq;
+	struct cifs_readreq *req;
+	unsigned int window;
+	unsigned int head = 0, tail = 0;	/* reqs[tail % window] is oldest */
+	int stop = 0;
 
 	xid = GetXid();
 	if (file->private_data == NULL) {
@@ -1815,101 +1996,96 @@ static int cifs_readpages(struct file *file, struct address_space *mapping,
 	cifs_sb = CIFS_SB(file->f_path.dentry->d_sb);
 	pTcon = cifs_sb->tcon;
 
+	if (netcache_readpages(CIFS_I(mapping->host)->netcache, mapping,
+			       page_list, &num_pages) == 0) {
+		rc = 0;
+		FreeXid(xid);
+		return rc;
+	}
+
+	/* keep up to cifs_sb->pipeline reads on the wire */
+	window = cifs_sb->pipeline;
+	if (window > 1)
+		reqs = kmalloc(window * sizeof(struct cifs_readreq), GFP_KERNEL);
+	if (reqs == NULL || window <= 1) {
+		reqs = &onereq;
+		window = 1;
+	}
+
 	pagevec_init(&lru_pvec, 0);
 #ifdef CONFIG_CIFS_DEBUG2
-		cFYI(1, ("rpages: num pages %d", num_pages));
+		cFYI(1, ("rpages: num pages %d window %d", num_pages, window));
 #endif
-	for (i = 0; i < num_pages; ) {
-		unsigned contig_pages;
-		struct page *tmp_page;
-		unsigned long expected_index;
-
-		if (list_empty(page_list))
-			break;
-
-		page = list_entry(page_list->prev, struct page, lru);
-		offset = (loff_t)page->index << PAGE_CACHE_SHIFT;
-
-		/* count adjacent pages that we will read into */
-		contig_pages = 0;
-		expected_index =
-			list_entry(page_list->prev, struct page, lru)->index;
-		list_for_each_entry_reverse(tmp_page, page_list, lru) {
-			if (tmp_page->index == expected_index) {
-				contig_pages++;
-				expected_index++;
-			} else
-				break;
-		}
-		if (contig_pages + i >  num_pages)
-			contig_pages = num_pages - i;
-
-		/* for reads over a certain size could initiate async
-		   read ahead */
-
-		read_size = contig_pages * PAGE_CACHE_SIZE;
-		/* Read size needs to be in multiples of one page */
-		read_size = min_t(const unsigned int, read_size,
-				  cifs_sb->rsize & PAGE_CACHE_MASK);
+	for (;;) {
+		while (!stop && (head - tail < window) &&
+		       !list_empty(page_list)) {
+			req = &reqs[head % window];
+			/* Read size needs to be in multiples of one page */
+			cifs_readreq_init(req, page_list,
+					  cifs_sb->rsize & PAGE_CACHE_MASK);
 #ifdef CONFIG_CIFS_DEBUG2
-		cFYI(1, ("rpages: read size 0x%x  contiguous pages %d",
-				read_size, contig_pages));
+			cFYI(1, ("rpages: read size 0x%x at %lld",
+				 req->size, req->offset));
 #endif
-		rc = -EAGAIN;
-		while (rc == -EAGAIN) {
 			if ((open_file->invalidHandle) &&
 			    (!open_file->closePend)) {
 				rc = cifs_reopen_file(file, TRUE);
-				if (rc != 0)
+				if (rc != 0) {
+					cifs_readreq_putback(req, page_list);
+					stop = 1;
 					break;
+				}
 			}
 
-			rc = CIFSSMBRead(xid, pTcon,
-					 open_file->netfid,
-					 read_size, offset,
-					 &bytes_read, &smb_read_data,
-					 &buf_type);
-			/* BB more RC checks ? */
-			if (rc == -EAGAIN) {
-				if (smb_read_data) {
-					if (buf_type == CIFS_SMALL_BUFFER)
-						cifs_small_buf_release(smb_read_data);
-					else if (buf_type == CIFS_LARGE_BUFFER)
-						cifs_buf_release(smb_read_data);
-					smb_read_data = NULL;
-				}
+			/* must not wait for a free request slot while holding
+			   slots whose responses only we will collect */
+			rc = CIFSSMBReadSend(xid, pTcon, open_file->netfid,
+					     req->size, req->offset, &req->midQ,
+					     CIFS_STD_OP | CIFS_LOG_ERROR |
+					     (head != tail ? CIFS_NO_SRV_WAIT : 0));
+			if (rc == 0) {
+				head++;
+				continue;
 			}
+			cifs_readreq_putback(req, page_list);
+			if ((rc == -EAGAIN) && (head == tail))
+				continue;	/* retry, as for a lone read */
+			if ((rc != -EAGAIN) && (rc != -EBUSY))
+				stop = 1;
+			/* otherwise collect a response before trying again */
+			break;
 		}
-		if ((rc < 0) || (smb_read_data == NULL)) {
-			cFYI(1, ("Read error in readpages: %d", rc));
+		if (head == tail)
 			break;
+
+		req = &reqs[tail++ % window];
+		rc = CIFSSMBReadWait(xid, pTcon, req->midQ, req->size,
+				     &bytes_read, &smb_read_data, &buf_type,
+				     CIFS_STD_OP | CIFS_LOG_ERROR);
+		if (rc == -EAGAIN) {
+			/* resend it; its pages are below any still queued */
+			cifs_readreq_putback(req, page_list);
+		} else if ((rc < 0) || (smb_read_data == NULL)) {
+			cFYI(1, ("Read error in readpages: %d", rc));
+			stop = 1;
 		} else if (bytes_read > 0) {
 			task_io_account_read(bytes_read);
 			pSMBr = (struct smb_com_read_rsp *)smb_read_data;
-			cifs_copy_cache_pages(mapping, page_list, bytes_read,
+			cifs_copy_cache_pages(mapping, &req->pages, bytes_read,
 				smb_read_data + 4 /* RFC1001 hdr */ +
 				le16_to_cpu(pSMBr->DataOffset), &lru_pvec);
-
-			i +=  bytes_read >> PAGE_CACHE_SHIFT;
 			cifs_stats_bytes_read(pTcon, bytes_read);
-			if ((bytes_read & PAGE_CACHE_MASK) != bytes_read) {
-				i++; /* account for partial page */
-
-				/* server copy of file can have smaller size
-				   than client */
-				/* BB do we need to verify this common case ?
-				   this case is ok - if we are at server EOF
-				   we will hit it on next read */
-
-				/* break; */
-			}
+			/* server copy of file can have smaller size than
+			   client: reads past this one would find EOF too */
+			if (bytes_read < req->size)
+				stop = 1;
 		} else {
 			cFYI(1, ("No bytes read (%d) at offset %lld . "
 				 "Cleaning remaining pages from readahead list",
-				 bytes_read, offset));
+				 bytes_read, req->offset));
 			/* BB turn off caching and do new lookup on
 			   file size at server? */
-			break;
+			stop = 1;
 		}
 		if (smb_read_data) {
 			if (buf_type == CIFS_SMALL_BUFFER)
@@ -1919,19 +2095,14 @@ static int cifs_readpages(struct file *file, struct address_space *mapping,
 			smb_read_data = NULL;
 		}
 		bytes_read = 0;
+		/* pages not filled are released by our caller */
+		list_splice(&req->pages, page_list);
 	}
 
 	pagevec_lru_add(&lru_pvec);
 
-/* need to free smb_read_data buf before exit */
-	if (smb_read_data) {
-		if (buf_type == CIFS_SMALL_BUFFER)
-			cifs_small_buf_release(smb_read_data);
-		else if (buf_type == CIFS_LARGE_BUFFER)
-			cifs_buf_release(smb_read_data);
-		smb_read_data = NULL;
-	}
-
+	if (reqs != &onereq)
+		kfree(reqs);
 	FreeXid(xid);
 	return rc;
 }
@@ -1961,6 +2132,7 @@ static int cifs_readpage_worker(struct file *file, struct page *page,
 
 	flush_dcache_page(page);
 	SetPageUptodate(page);
+	netcache_store_page(CIFS_I(page->mapping->host)->netcache, page);
 	rc = 0;
 
 io_error:
@@ -1985,7 +2157,12 @@ static int cifs_readpage(struct file *file, struct page *page)
 	cFYI(1, ("readpage %p at offset %d 0x%x\n",
 		 page, (int)offset, (int)offset));
 
-	rc = cifs_readpage_worker(file, page, &offset);
+	if (netcache_read_page(CIFS_I(page->mapping->host)->netcache,
+			       page) == 0) {
+		SetPageUptodate(page);
+		rc = 0;
+	} else
+		rc = cifs_readpage_worker(file, page, &offset);
 
 	unlock_page(page);
 
@@ -306,8 +306,10 @@ smb_send2(struct socket *ssocket, struct kvec *iov, int n_vec,
 	return rc;
 }
 
-static int wait_for_free_request(struct cifsSesInfo *ses, const int long_op)
+static int wait_for_free_request(struct cifsSesInfo *ses, const int flags)
 {
+	const int long_op = flags & CIFS_TIMEOUT_MASK;
+
 	if (long_op == CIFS_ASYNC_OP) {
 		/* oplock breaks must not be held up */
 		atomic_inc(&ses->server->inFlight);
@@ -317,6 +319,10 @@ static int wait_for_free_request(struct cifsSesInfo *ses, const int long_op)
 			if (atomic_read(&ses->server->inFlight) >=
 					cifs_max_pending){
 				spin_unlock(&GlobalMid_Lock);
+				/* caller already has requests of its own
+				   outstanding and must not sleep on others */
+				if (flags & CIFS_NO_SRV_WAIT)
+					return -EBUSY;
 #ifdef CONFIG_CIFS_STATS2
 				atomic_inc(&ses->server->num_waiters);
 #endif
@@ -443,22 +449,22 @@ SendReceiveNoRsp(const unsigned int xid, struct cifsSesInfo *ses,
 	return rc;
 }
 
+/*
+ * Sign and send an SMB and return its mid without waiting for the response,
+ * which cifs_wait_async() collects.  This lets a caller keep several
+ * requests (e.g. reads or writes of consecutive ranges of a file) on the
+ * wire at once.  The request buffer (iov[0]) is always released.  Unless
+ * CIFS_NO_SRV_WAIT is set in flags, waits for a free request slot.
+ */
 int
-SendReceive2(const unsigned int xid, struct cifsSesInfo *ses,
-	     struct kvec *iov, int n_vec, int *pRespBufType /* ret */,
-	     const int flags)
+cifs_send_async(const unsigned int xid, struct cifsSesInfo *ses,
+		struct kvec *iov, int n_vec, struct mid_q_entry **ppmidQ,
+		const int flags)
 {
 	int rc = 0;
-	int long_op;
-	unsigned int receive_len;
-	unsigned long timeout;
 	struct mid_q_entry *midQ;
 	struct smb_hdr *in_buf = iov[0].iov_base;
 
-	long_op = flags & CIFS_TIMEOUT_MASK;
-
-	*pRespBufType = CIFS_NO_BUFFER;  /* no response buf yet */
-
 	if ((ses == NULL) || (ses->server == NULL)) {
 		cifs_small_buf_release(in_buf);
 		cERROR(1, ("Null session"));
@@ -474,7 +480,7 @@ SendReceive2(const unsigned int xid, struct cifsSesInfo *ses,
 	   to the same server. We may make this configurable later or
 	   use ses->maxReq */
 
-	rc = wait_for_free_request(ses, long_op);
+	rc = wait_for_free_request(ses, flags);
 	if (rc) {
 		cifs_small_buf_release(in_buf);
 		return rc;
@@ -511,8 +517,35 @@ SendReceive2(const unsigned int xid, struct cifsSesInfo *ses,
 	up(&ses->server->tcpSem);
 	cifs_small_buf_release(in_buf);
 
-	if (rc < 0)
-		goto out;
+	if (rc < 0) {
+		DeleteMidQEntry(midQ);
+		atomic_dec(&ses->server->inFlight);
+		wake_up(&ses->server->request_q);
+		return rc;
+	}
+
+	*ppmidQ = midQ;
+	return 0;
+}
+
+/*
+ * Wait for the response to a request sent by cifs_send_async() and
+ * release its mid.  On success the response is returned in iov[0] as
+ * SendReceive2() does.  The mid is gone on return whatever the result.
+ */
+int
+cifs_wait_async(const unsigned int xid, struct cifsSesInfo *ses,
+		struct mid_q_entry *midQ, struct kvec *iov,
+		int *pRespBufType /* ret */, const int flags)
+{
+	int rc = 0;
+	int long_op;
+	unsigned int receive_len;
+	unsigned long timeout;
+
+	long_op = flags & CIFS_TIMEOUT_MASK;
+
+	*pRespBufType = CIFS_NO_BUFFER;  /* no response buf yet */
 
 	if (long_op == CIFS_STD_OP)
 		timeout = 15 * HZ;
@@ -631,6 +664,23 @@ out:
 	return rc;
 }
 
+int
+SendReceive2(const unsigned int xid, struct cifsSesInfo *ses,
+	     struct kvec *iov, int n_vec, int *pRespBufType /* ret */,
+	     const int flags)
+{
+	int rc;
+	struct mid_q_entry *midQ;
+
+	*pRespBufType = CIFS_NO_BUFFER;  /* no response buf yet */
+
+	rc = cifs_send_async(xid, ses, iov, n_vec, &midQ, flags);
+	if (rc)
+		return rc;
+
+	return cifs_wait_async(xid, ses, midQ, iov, pRespBufType, flags);
+}
+
 int
 SendReceive(const unsigned int xid, struct cifsSesInfo *ses,
 	    struct smb_hdr *in_buf, struct smb_hdr *out_buf,
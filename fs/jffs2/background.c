@@ -15,8 +15,62 @@
 #include <linux/completion.h>
 #include <linux/sched.h>
 #include <linux/freezer.h>
+#include <linux/moduleparam.h>
 #include "nodelist.h"
 
+/*
+ * Scheduling of the GC threads, tunable at runtime through
+ * /sys/module/jffs2/parameters/.  gc_policy is SCHED_NORMAL (0),
+ * SCHED_BATCH (3) or SCHED_IDLE (5); gc_nice applies to the first two.
+ */
+static int gc_policy = SCHED_NORMAL;
+static int gc_nice = 10;
+static atomic_t gc_sched_gen = ATOMIC_INIT(0);
+
+static int jffs2_gc_set_policy(const char *val, struct kernel_param *kp)
+{
+	int ret, old = gc_policy;
+
+	ret = param_set_int(val, kp);
+	if (ret)
+		return ret;
+	if (gc_policy != SCHED_NORMAL && gc_policy != SCHED_BATCH &&
+	    gc_policy != SCHED_IDLE) {
+		gc_policy = old;
+		return -EINVAL;
+	}
+	atomic_inc(&gc_sched_gen);
+	return 0;
+}
+
+static int jffs2_gc_set_nice(const char *val, struct kernel_param *kp)
+{
+	int ret, old = gc_nice;
+
+	ret = param_set_int(val, kp);
+	if (ret)
+		return ret;
+	if (gc_nice < -20 || gc_nice > 19) {
+		gc_nice = old;
+		return -EINVAL;
+	}
+	atomic_inc(&gc_sched_gen);
+	return 0;
+}
+
+module_param_call(gc_policy, jffs2_gc_set_policy, param_get_int, &gc_policy, 0644);
+MODULE_PARM_DESC(gc_policy, "GC thread policy: 0 normal, 3 batch, 5 idle");
+module_param_call(gc_nice, jffs2_gc_set_nice, param_get_int, &gc_nice, 0644);
+MODULE_PARM_DESC(gc_nice, "GC thread nice level");
+
+static void jffs2_gc_set_sched(void)
+{
+	struct sched_param param = { .sched_priority = 0 };
+
+	sched_setscheduler(current, gc_policy, &param);
+	if (gc_policy != SCHED_IDLE)
+		set_user_nice(current, gc_nice);
+}
 
 static int jffs2_garbage_collect_thread(void *);
 
@@ -70,6 +124,7 @@ void jffs2_stop_garbage_collect_thread(struct jffs2_sb_info *c)
 static int jffs2_garbage_collect_thread(void *_c)
 {
 	struct jffs2_sb_info *c = _c;
+	int sched_gen;
 
 	daemonize("jffs2_gcd_mtd%d", c->mtd->index);
 	allow_signal(SIGKILL);
@@ -79,10 +134,16 @@ static int jffs2_garbage_collect_thread(void *_c)
 	c->gc_task = current;
 	complete(&c->gc_thread_start);
 
-	set_user_nice(current, 10);
+	sched_gen = atomic_read(&gc_sched_gen);
+	jffs2_gc_set_sched();
 
 	set_freezable();
 	for (;;) {
+		if (sched_gen != atomic_read(&gc_sched_gen)) {
+			sched_gen = atomic_read(&gc_sched_gen);
+			jffs2_gc_set_sched();
+		}
+
 		allow_signal(SIGHUP);
 	again:
 		if (!jffs2_thread_should_wake(c)) {
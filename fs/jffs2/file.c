@@ -17,6 +17,8 @@
 #include <linux/highmem.h>
 #include <linux/crc32.h>
 #include <linux/jffs2.h>
+#include <linux/module.h>
+#include <linux/writeback.h>
 #include "nodelist.h"
 
 static int jffs2_write_end(struct file *filp, struct address_space *mapping,
@@ -27,10 +29,242 @@ static int jffs2_write_begin(struct file *filp, struct address_space *mapping,
 			struct page **pagep, void **fsdata);
 static int jffs2_readpage (struct file *filp, struct page *pg);
 
+#ifdef CONFIG_JFFS2_FS_APPEND_COALESCE
+/*
+ * Small append coalescing.
+ *
+ * An append which doesn't complete its page isn't written to the flash
+ * by jffs2_write_end().  It is only recorded in f->append_start/len,
+ * and the page is left dirty in the page cache.  Further appends to the
+ * same page extend the range.  The range is written as a single node
+ * by jffs2_flush_append() when:
+ *  - a write fills the page, or goes anywhere but the end of the file
+ *  - the file is truncated or fsync()ed
+ *  - the VM writes back the dirty page (sync, umount, memory pressure)
+ *  - append_delay_ms have passed since the inode was queued
+ *
+ * Everything that flushes holds i_mutex.  Writeback and the delayed
+ * work only trylock it, and leave the page to the writer if it's busy.
+ * The range fields are also changed under f->sem, for GC.
+ */
+static unsigned int append_delay_ms = 1000;
+module_param(append_delay_ms, uint, 0644);
+MODULE_PARM_DESC(append_delay_ms, "Longest time small appends stay in RAM (ms), 0 disables coalescing");
+
+/* Called with i_mutex held */
+int jffs2_flush_append(struct inode *inode)
+{
+	struct jffs2_inode_info *f = JFFS2_INODE_INFO(inode);
+	struct jffs2_sb_info *c = JFFS2_SB_INFO(inode->i_sb);
+	struct jffs2_raw_inode *ri;
+	struct page *pg;
+	uint32_t start, aligned_start, len, writtenlen = 0;
+	int ret;
+
+	down(&f->sem);
+	start = f->append_start;
+	len = f->append_len;
+	up(&f->sem);
+
+	if (!len)
+		return 0;
+
+	D1(printk(KERN_DEBUG "jffs2_flush_append(): ino #%lu, range 0x%x-0x%x\n",
+		  inode->i_ino, start, start + len));
+
+	/* The page is dirty, so it can't have been reclaimed, and
+	   truncation flushes first. */
+	pg = find_get_page(inode->i_mapping, start >> PAGE_CACHE_SHIFT);
+	if (!pg) {
+		printk(KERN_WARNING "jffs2_flush_append(): page for ino #%lu offset 0x%x gone\n",
+		       inode->i_ino, start);
+		return -EIO;
+	}
+
+	ri = jffs2_alloc_raw_inode();
+	if (!ri) {
+		page_cache_release(pg);
+		return -ENOMEM;
+	}
+
+	ri->ino = cpu_to_je32(inode->i_ino);
+	ri->mode = cpu_to_jemode(inode->i_mode);
+	ri->uid = cpu_to_je16(inode->i_uid);
+	ri->gid = cpu_to_je16(inode->i_gid);
+	ri->isize = cpu_to_je32(start + len);
+	ri->atime = ri->ctime = ri->mtime = cpu_to_je32(I_SEC(inode->i_mtime));
+
+	/* Same alignment as jffs2_write_end() */
+	aligned_start = start & ~3;
+
+	kmap(pg);
+	ret = jffs2_write_inode_range(c, f, ri,
+				      page_address(pg) + (aligned_start & (PAGE_CACHE_SIZE - 1)),
+				      aligned_start, start + len - aligned_start,
+				      &writtenlen);
+	kunmap(pg);
+
+	jffs2_free_raw_inode(ri);
+	page_cache_release(pg);
+
+	writtenlen -= min(writtenlen, start - aligned_start);
+
+	down(&f->sem);
+	f->append_start += writtenlen;
+	f->append_len -= writtenlen;
+	up(&f->sem);
+
+	if (!ret && writtenlen < len)
+		ret = -EIO;
+	return ret;
+}
+
+static void jffs2_append_queue(struct jffs2_sb_info *c, struct jffs2_inode_info *f)
+{
+	spin_lock(&c->append_lock);
+	if (list_empty(&f->append_list)) {
+		list_add_tail(&f->append_list, &c->append_list);
+		schedule_delayed_work(&c->append_work,
+				      msecs_to_jiffies(append_delay_ms));
+	}
+	spin_unlock(&c->append_lock);
+}
+
+static void jffs2_append_work(struct work_struct *work)
+{
+	struct jffs2_sb_info *c = container_of(work, struct jffs2_sb_info,
+					       append_work.work);
+	struct jffs2_inode_info *f;
+	struct inode *inode;
+	LIST_HEAD(todo);
+
+	spin_lock(&c->append_lock);
+	list_splice_init(&c->append_list, &todo);
+	while (!list_empty(&todo)) {
+		f = list_entry(todo.next, struct jffs2_inode_info, append_list);
+		list_del_init(&f->append_list);
+		/* An inode on its way out is flushed by its final writeback */
+		inode = igrab(OFNI_EDONI_2SFFJ(f));
+		spin_unlock(&c->append_lock);
+
+		if (inode) {
+			if (mutex_trylock(&inode->i_mutex)) {
+				jffs2_flush_append(inode);
+				mutex_unlock(&inode->i_mutex);
+			} else {
+				/* Somebody's writing; look again later */
+				jffs2_append_queue(c, f);
+			}
+			iput(inode);
+		}
+		spin_lock(&c->append_lock);
+	}
+	spin_unlock(&c->append_lock);
+}
+
+/* The inode is being evicted; anything still pending is discarded */
+void jffs2_append_forget(struct jffs2_sb_info *c, struct jffs2_inode_info *f)
+{
+	spin_lock(&c->append_lock);
+	list_del_init(&f->append_list);
+	spin_unlock(&c->append_lock);
+	f->append_len = 0;
+}
+
+void jffs2_append_setup(struct jffs2_sb_info *c)
+{
+	spin_lock_init(&c->append_lock);
+	INIT_LIST_HEAD(&c->append_list);
+	INIT_DELAYED_WORK(&c->append_work, jffs2_append_work);
+}
+
+void jffs2_append_cleanup(struct jffs2_sb_info *c)
+{
+	cancel_delayed_work_sync(&c->append_work);
+}
+
+/* Only the page holding the pending append range is ever dirty */
+static int jffs2_writepage(struct page *pg, struct writeback_control *wbc)
+{
+	struct inode *inode = pg->mapping->host;
+	struct jffs2_inode_info *f = JFFS2_INODE_INFO(inode);
+	int ret = 0;
+
+	if (f->append_len &&
+	    (f->append_start >> PAGE_CACHE_SHIFT) == pg->index) {
+		/* Not from reclaim: we may be called with alloc_sem held */
+		if ((current->flags & PF_MEMALLOC) ||
+		    !mutex_trylock(&inode->i_mutex)) {
+			redirty_page_for_writepage(wbc, pg);
+			unlock_page(pg);
+			return 0;
+		}
+		ret = jffs2_flush_append(inode);
+		mutex_unlock(&inode->i_mutex);
+		if (ret) {
+			SetPageError(pg);
+			mapping_set_error(pg->mapping, ret);
+		}
+	}
+	unlock_page(pg);
+	return ret;
+}
+
+/* Can the write at pos go into the pending append range? */
+static inline int jffs2_append_mergeable(struct inode *inode, loff_t pos)
+{
+	struct jffs2_inode_info *f = JFFS2_INODE_INFO(inode);
+
+	return !f->append_len ||
+	       (pos == inode->i_size &&
+		(f->append_start >> PAGE_CACHE_SHIFT) == (pos >> PAGE_CACHE_SHIFT));
+}
+
+static inline int jffs2_append_can_defer(struct file *filp, struct inode *inode,
+					 loff_t pos, unsigned len, unsigned copied)
+{
+	return append_delay_ms && copied == len && pos == inode->i_size &&
+	       ((pos & (PAGE_CACHE_SIZE - 1)) + copied < PAGE_CACHE_SIZE) &&
+	       !(filp->f_flags & O_SYNC) && !IS_SYNC(inode);
+}
+
+static int jffs2_append_defer(struct inode *inode, struct page *pg,
+			      loff_t pos, unsigned copied)
+{
+	struct jffs2_inode_info *f = JFFS2_INODE_INFO(inode);
+	struct jffs2_sb_info *c = JFFS2_SB_INFO(inode->i_sb);
+
+	D1(printk(KERN_DEBUG "jffs2_write_end(): deferring 0x%x bytes at 0x%llx\n",
+		  copied, (unsigned long long)pos));
+
+	down(&f->sem);
+	if (!f->append_len)
+		f->append_start = pos;
+	f->append_len += copied;
+	inode->i_size = pos + copied;
+	inode->i_blocks = (inode->i_size + 511) >> 9;
+	inode->i_ctime = inode->i_mtime = ITIME(get_seconds());
+	up(&f->sem);
+
+	set_page_dirty(pg);
+	jffs2_append_queue(c, f);
+
+	unlock_page(pg);
+	page_cache_release(pg);
+	return copied;
+}
+#endif /* CONFIG_JFFS2_FS_APPEND_COALESCE */
+
 int jffs2_fsync(struct file *filp, struct dentry *dentry, int datasync)
 {
 	struct inode *inode = dentry->d_inode;
 	struct jffs2_sb_info *c = JFFS2_SB_INFO(inode->i_sb);
+	int ret;
+
+	/* Write out appends still held in the page cache */
+	ret = jffs2_flush_append(inode);
+	if (ret)
+		return ret;
 
 	/* Trigger GC to flush any pending writes for this inode */
 	jffs2_flush_wbuf_gc(c, inode->i_ino);
@@ -69,6 +303,10 @@ const struct address_space_operations jffs2_file_address_operations =
 	.readpage =	jffs2_readpage,
 	.write_begin =	jffs2_write_begin,
 	.write_end =	jffs2_write_end,
+#ifdef CONFIG_JFFS2_FS_APPEND_COALESCE
+	.writepage =	jffs2_writepage,
+	.set_page_dirty = __set_page_dirty_nobuffers,
+#endif
 };
 
 static int jffs2_do_readpage_nolock (struct inode *inode, struct page *pg)
@@ -132,6 +370,15 @@ static int jffs2_write_begin(struct file *filp, struct address_space *mapping,
 	uint32_t pageofs = pos & (PAGE_CACHE_SIZE - 1);
 	int ret = 0;
 
+#ifdef CONFIG_JFFS2_FS_APPEND_COALESCE
+	/* Anything but a further append to the pending page goes after it */
+	if (!jffs2_append_mergeable(inode, pos)) {
+		ret = jffs2_flush_append(inode);
+		if (ret)
+			return ret;
+	}
+#endif
+
 	pg = __grab_cache_page(mapping, index);
 	if (!pg)
 		return -ENOMEM;
@@ -250,6 +497,17 @@ static int jffs2_write_end(struct file *filp, struct address_space *mapping,
 	   to re-lock it. */
 	BUG_ON(!PageUptodate(pg));
 
+#ifdef CONFIG_JFFS2_FS_APPEND_COALESCE
+	if (jffs2_append_can_defer(filp, inode, pos, len, copied))
+		return jffs2_append_defer(inode, pg, pos, copied);
+
+	/* Otherwise any pending append is on this very page, just before
+	   pos (write_begin flushed it if not); write it out with this data.
+	   The padding adjustment below accounts for it. */
+	if (f->append_len)
+		aligned_start = (f->append_start & (PAGE_CACHE_SIZE - 1)) & ~3;
+#endif
+
 	if (end == PAGE_CACHE_SIZE) {
 		/* When writing out the end of a page, write out the
 		   _whole_ page. This helps to reduce the number of
@@ -290,6 +548,14 @@ static int jffs2_write_end(struct file *filp, struct address_space *mapping,
 		SetPageError(pg);
 	}
 
+#ifdef CONFIG_JFFS2_FS_APPEND_COALESCE
+	if (f->append_len && writtenlen >= start - aligned_start) {
+		down(&f->sem);
+		f->append_len = 0;
+		up(&f->sem);
+	}
+#endif
+
 	/* Adjust writtenlen for the padding we did, so we don't confuse our caller */
 	writtenlen -= min(writtenlen, (start - aligned_start));
 
@@ -185,6 +185,13 @@ int jffs2_setattr(struct dentry *dentry, struct iattr *iattr)
 	if (rc)
 		return rc;
 
+	/* The node written below carries i_size, so get the data out first */
+	if (S_ISREG(dentry->d_inode->i_mode)) {
+		rc = jffs2_flush_append(dentry->d_inode);
+		if (rc)
+			return rc;
+	}
+
 	rc = jffs2_do_setattr(dentry->d_inode, iattr);
 	if (!rc && (iattr->ia_valid & ATTR_MODE))
 		rc = jffs2_acl_chmod(dentry->d_inode);
@@ -227,6 +234,7 @@ void jffs2_clear_inode (struct inode *inode)
 	struct jffs2_inode_info *f = JFFS2_INODE_INFO(inode);
 
 	D1(printk(KERN_DEBUG "jffs2_clear_inode(): ino #%lu mode %o\n", inode->i_ino, inode->i_mode));
+	jffs2_append_forget(c, f);
 	jffs2_do_clear_inode(c, f);
 }
 
@@ -489,6 +497,7 @@ int jffs2_do_fill_super(struct super_block *sb, void *data, int silent)
 	c->flash_size = c->mtd->size;
 	c->sector_size = c->mtd->erasesize;
 	blocks = c->flash_size / c->sector_size;
+	atomic_set(&c->alloc_waiters, 0);
 
 	/*
 	 * Size alignment check
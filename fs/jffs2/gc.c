@@ -1297,6 +1297,13 @@ static int jffs2_garbage_collect_dnode(struct jffs2_sb_info *c, struct jffs2_era
 			jffs2_free_full_dnode(f->metadata);
 			f->metadata = NULL;
 		}
+		/* Each node written is a unit of work; don't hog the CPU */
+		cond_resched();
+		/* A writer is waiting for the alloc_sem: let it in now.  The
+		   rest of the old node stays valid, and the next pass picks
+		   it up again from here. */
+		if (atomic_read(&c->alloc_waiters))
+			break;
 	}
 
 	jffs2_gc_release_page(c, pg_ptr, &pg);
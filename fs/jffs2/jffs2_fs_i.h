@@ -50,6 +50,13 @@ struct jffs2_inode_info {
 
 	uint16_t flags;
 	uint8_t usercompr;
+#ifdef CONFIG_JFFS2_FS_APPEND_COALESCE
+	/* Appended data which is still only in the page cache. It always
+	   ends at i_size and lies within one page. */
+	uint32_t append_start;
+	uint32_t append_len;
+	struct list_head append_list;	/* On c->append_list */
+#endif
 	struct inode vfs_inode;
 #ifdef CONFIG_JFFS2_FS_POSIX_ACL
 	struct posix_acl *i_acl_access;
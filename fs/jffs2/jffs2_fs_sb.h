@@ -47,6 +47,7 @@ struct jffs2_sb_info {
 	struct semaphore alloc_sem;	/* Used to protect all the following
 					   fields, and also to protect against
 					   out-of-order writing of nodes. And GC. */
+	atomic_t alloc_waiters;		/* Writers waiting for alloc_sem */
 	uint32_t cleanmarker_size;	/* Size of an _inline_ CLEANMARKER
 					 (i.e. zero for OOB CLEANMARKER */
 
@@ -124,6 +125,12 @@ struct jffs2_sb_info {
 
 	struct jffs2_summary *summary;		/* Summary information */
 
+#ifdef CONFIG_JFFS2_FS_APPEND_COALESCE
+	spinlock_t append_lock;			/* Protects append_list */
+	struct list_head append_list;		/* Inodes with appends to flush */
+	struct delayed_work append_work;	/* Bounds the flush delay */
+#endif
+
 #ifdef CONFIG_JFFS2_FS_XATTR
 #define XATTRINDEX_HASHSIZE	(57)
 	uint32_t highest_xid;
@@ -48,7 +48,10 @@ int jffs2_reserve_space(struct jffs2_sb_info *c, uint32_t minsize,
 	minsize = PAD(minsize);
 
 	D1(printk(KERN_DEBUG "jffs2_reserve_space(): Requested 0x%x bytes\n", minsize));
+	/* Have GC let us in after the node it is writing */
+	atomic_inc(&c->alloc_waiters);
 	down(&c->alloc_sem);
+	atomic_dec(&c->alloc_waiters);
 
 	D1(printk(KERN_DEBUG "jffs2_reserve_space(): alloc sem got\n"));
 
@@ -25,7 +25,13 @@ struct kvec;
 #define OFNI_BS_2SFFJ(c)  ((struct super_block *)c->os_priv)
 
 
+#ifdef CONFIG_JFFS2_FS_APPEND_COALESCE
+/* The size as far as the flash is concerned; nodes written by GC must
+   not claim appends which are still only in the page cache. */
+#define JFFS2_F_I_SIZE(f) ((f)->append_len ? (f)->append_start : OFNI_EDONI_2SFFJ(f)->i_size)
+#else
 #define JFFS2_F_I_SIZE(f) (OFNI_EDONI_2SFFJ(f)->i_size)
+#endif
 #define JFFS2_F_I_MODE(f) (OFNI_EDONI_2SFFJ(f)->i_mode)
 #define JFFS2_F_I_UID(f) (OFNI_EDONI_2SFFJ(f)->i_uid)
 #define JFFS2_F_I_GID(f) (OFNI_EDONI_2SFFJ(f)->i_gid)
@@ -56,6 +62,10 @@ static inline void jffs2_init_inode_info(struct jffs2_inode_info *f)
 	f->target = NULL;
 	f->flags = 0;
 	f->usercompr = 0;
+#ifdef CONFIG_JFFS2_FS_APPEND_COALESCE
+	f->append_start = 0;
+	f->append_len = 0;
+#endif
 #ifdef CONFIG_JFFS2_FS_POSIX_ACL
 	f->i_acl_access = JFFS2_ACL_NOT_CACHED;
 	f->i_acl_default = JFFS2_ACL_NOT_CACHED;
@@ -165,6 +175,17 @@ extern const struct inode_operations jffs2_file_inode_operations;
 extern const struct address_space_operations jffs2_file_address_operations;
 int jffs2_fsync(struct file *, struct dentry *, int);
 int jffs2_do_readpage_unlock (struct inode *inode, struct page *pg);
+#ifdef CONFIG_JFFS2_FS_APPEND_COALESCE
+int jffs2_flush_append(struct inode *inode);
+void jffs2_append_forget(struct jffs2_sb_info *c, struct jffs2_inode_info *f);
+void jffs2_append_setup(struct jffs2_sb_info *c);
+void jffs2_append_cleanup(struct jffs2_sb_info *c);
+#else
+#define jffs2_flush_append(inode) (0)
+#define jffs2_append_forget(c, f) do {} while (0)
+#define jffs2_append_setup(c) do {} while (0)
+#define jffs2_append_cleanup(c) do {} while (0)
+#endif
 
 /* ioctl.c */
 int jffs2_ioctl(struct inode *, struct file *, unsigned int, unsigned long);
@@ -48,6 +48,9 @@ static void jffs2_i_init_once(struct kmem_cache *cachep, void *foo)
 	struct jffs2_inode_info *ei = (struct jffs2_inode_info *) foo;
 
 	init_MUTEX(&ei->sem);
+#ifdef CONFIG_JFFS2_FS_APPEND_COALESCE
+	INIT_LIST_HEAD(&ei->append_list);
+#endif
 	inode_init_once(&ei->vfs_inode);
 }
 
@@ -102,6 +105,7 @@ static int jffs2_fill_super(struct super_block *sb, void *data, int silent)
 	init_waitqueue_head(&c->inocache_wq);
 	spin_lock_init(&c->erase_completion_lock);
 	spin_lock_init(&c->inocache_lock);
+	jffs2_append_setup(c);
 
 	sb->s_op = &jffs2_super_operations;
 	sb->s_flags = sb->s_flags | MS_NOATIME;
@@ -126,6 +130,8 @@ static void jffs2_put_super (struct super_block *sb)
 
 	D2(printk(KERN_DEBUG "jffs2: jffs2_put_super()\n"));
 
+	jffs2_append_cleanup(c);
+
 	down(&c->alloc_sem);
 	jffs2_flush_wbuf_pad(c);
 	up(&c->alloc_sem);
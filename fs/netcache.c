@@ -0,0 +1,929 @@
+/*
+ * fs/netcache.c - persistent local cache of network file contents
+ *
+ * See <linux/netcache.h> for what the clients see.  Backing files live in
+ * the directory named by netcache.dir (e.g. on the JFFS2 filestore), one
+ * per cached file, named after a hash of the cookie's key.  Each starts
+ * with a struct netcache_hdr; file data follows at NETCACHE_DATA_OFFSET.
+ * The header is rewritten with NETCACHE_HDR_VALID set only once every
+ * page of the file has been stored, so an interrupted fill is never used.
+ *
+ * The directory is kept under netcache.max_kb by removing the least
+ * recently used backing files that no cookie has open.  The order is kept
+ * in memory; after boot it is rebuilt from the backing files' mtimes,
+ * which change only when a copy is written, so that a cache hit does not
+ * write to flash.
+ *
+ * Everything that looks up, creates, writes or removes backing files runs
+ * from the netcache workqueue: the kernel's credentials and root directory
+ * apply rather than those of whichever process opened the client file, and
+ * a cookie dropped from inode reclaim does not wait for netcache_lock,
+ * which is held across allocations that may enter reclaim.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/namei.h>
+#include <linux/mount.h>
+#include <linux/pagemap.h>
+#include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mutex.h>
+#include <linux/completion.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/jhash.h>
+#include <linux/netcache.h>
+#include <asm/uaccess.h>
+
+static char netcache_dir[256];
+module_param_string(dir, netcache_dir, sizeof(netcache_dir), 0444);
+MODULE_PARM_DESC(dir, "Directory on a local filesystem to keep the cache in");
+
+static unsigned int netcache_max_kb = 8192;
+module_param_named(max_kb, netcache_max_kb, uint, 0644);
+MODULE_PARM_DESC(max_kb, "Size the cache is kept under, in KiB");
+
+static unsigned int netcache_max_object_kb = 4096;
+module_param_named(max_object_kb, netcache_max_object_kb, uint, 0644);
+MODULE_PARM_DESC(max_object_kb, "Larger files are not cached, in KiB");
+
+#define NETCACHE_MAGIC		0x4e434831	/* "NCH1" */
+#define NETCACHE_HDR_VALID	0x0001
+#define NETCACHE_DATA_OFFSET	4096
+
+/* On-disk header of a backing file */
+struct netcache_hdr {
+	__le32	magic;
+	__le32	flags;
+	__le64	size;
+	__le64	mtime_sec;
+	__le32	mtime_nsec;
+	__le32	keylen;
+	__le64	change;
+	u8	key[NETCACHE_KEY_MAX];
+};
+
+/* A backing file, whether or not a cookie has it open */
+struct netcache_object {
+	struct list_head	lru;	/* netcache_lru, least recent first */
+	char			name[17];
+	loff_t			size;	/* of the backing file */
+	struct timespec		used;
+	struct netcache_cookie	*cookie;
+};
+
+/* cookie states */
+#define NETCACHE_NONE		0	/* nothing usable cached */
+#define NETCACHE_FILLING	1	/* storing pages as they are read */
+#define NETCACHE_READY		2	/* whole file cached and matches aux */
+
+struct netcache_cookie {
+	atomic_t		usage;
+	struct list_head	release;	/* on netcache_release_q */
+	struct mutex		lock;	/* state and backing file I/O */
+	int			state;
+	unsigned int		gen;	/* bumped whenever state drops */
+	struct netcache_object	*object;
+	struct file		*file;
+	struct netcache_aux	aux;
+	unsigned long		*present; /* pages stored while filling */
+	unsigned long		npages;
+	unsigned long		nstored;
+	size_t			keylen;
+	u8			key[0];
+};
+
+/* A page waiting to be copied into the cache */
+struct netcache_store {
+	struct list_head	list;
+	struct netcache_cookie	*cookie;
+	struct page		*page;
+	unsigned int		gen;
+};
+
+static DEFINE_MUTEX(netcache_lock);	/* root, objects and LRU */
+static struct dentry *netcache_root;
+static struct vfsmount *netcache_mnt;
+static LIST_HEAD(netcache_lru);
+static loff_t netcache_bytes;
+
+static LIST_HEAD(netcache_store_q);
+static LIST_HEAD(netcache_release_q);
+static DEFINE_SPINLOCK(netcache_queue_lock);	/* both of the above */
+static struct workqueue_struct *netcache_wq;
+
+static void netcache_worker(struct work_struct *work);
+static DECLARE_WORK(netcache_work, netcache_worker);
+
+static int netcache_io(struct file *file, void *buf, size_t len, loff_t pos,
+		       int write)
+{
+	mm_segment_t old_fs;
+	ssize_t ret;
+
+	old_fs = get_fs();
+	set_fs(KERNEL_DS);
+	if (write)
+		ret = vfs_write(file, (const char __user *)buf, len, &pos);
+	else
+		ret = vfs_read(file, (char __user *)buf, len, &pos);
+	set_fs(old_fs);
+	if (ret < 0)
+		return ret;
+	return ret == len ? 0 : -EIO;
+}
+
+static int netcache_sync(struct file *file)
+{
+	if (!file->f_op->fsync)
+		return 0;
+	return file->f_op->fsync(file, file->f_path.dentry, 0);
+}
+
+static void netcache_name(const void *key, size_t keylen, char *name)
+{
+	sprintf(name, "%08x%08x", jhash(key, keylen, 0),
+		jhash(key, keylen, NETCACHE_MAGIC));
+}
+
+/* Caller holds the cache directory's i_mutex */
+static struct dentry *netcache_lookup(const char *name)
+{
+	return lookup_one_len(name, netcache_root, strlen(name));
+}
+
+/*
+ * Objects and LRU.  All of these are called with netcache_lock held.
+ */
+static struct netcache_object *netcache_object_find(const char *name)
+{
+	struct netcache_object *obj;
+
+	list_for_each_entry(obj, &netcache_lru, lru)
+		if (!strcmp(obj->name, name))
+			return obj;
+	return NULL;
+}
+
+static struct netcache_object *netcache_object_add(const char *name,
+	loff_t size, const struct timespec *used)
+{
+	struct netcache_object *obj, *pos;
+
+	obj = kzalloc(sizeof(*obj), GFP_KERNEL);
+	if (!obj)
+		return NULL;
+	strlcpy(obj->name, name, sizeof(obj->name));
+	obj->size = size;
+	obj->used = *used;
+	list_for_each_entry_reverse(pos, &netcache_lru, lru)
+		if (timespec_compare(&pos->used, used) <= 0)
+			break;
+	list_add(&obj->lru, &pos->lru);
+	netcache_bytes += size;
+	return obj;
+}
+
+static void netcache_object_resize(struct netcache_object *obj, loff_t size)
+{
+	netcache_bytes += size - obj->size;
+	obj->size = size;
+}
+
+static int netcache_over_limit(void)
+{
+	return netcache_bytes > ((loff_t)netcache_max_kb << 10);
+}
+
+/* Delete an object no cookie has open, and its backing file */
+static void netcache_object_remove(struct netcache_object *obj)
+{
+	struct inode *dir = netcache_root->d_inode;
+	struct dentry *dentry;
+
+	mutex_lock_nested(&dir->i_mutex, I_MUTEX_PARENT);
+	dentry = netcache_lookup(obj->name);
+	if (!IS_ERR(dentry)) {
+		if (dentry->d_inode)
+			vfs_unlink(dir, dentry);
+		dput(dentry);
+	}
+	mutex_unlock(&dir->i_mutex);
+	netcache_bytes -= obj->size;
+	list_del(&obj->lru);
+	kfree(obj);
+}
+
+/* Called from the workqueue only */
+static void netcache_evict(void)
+{
+	struct netcache_object *obj, *tmp;
+	loff_t max = (loff_t)netcache_max_kb << 10;
+
+	list_for_each_entry_safe(obj, tmp, &netcache_lru, lru) {
+		if (netcache_bytes <= max)
+			break;
+		if (!obj->cookie)
+			netcache_object_remove(obj);
+	}
+}
+
+struct netcache_name {
+	struct list_head	list;
+	char			name[17];
+};
+
+static int netcache_filldir(void *buf, const char *name, int len,
+			    loff_t pos, u64 ino, unsigned type)
+{
+	struct list_head *names = buf;
+	struct netcache_name *n;
+
+	if (len != 16 || (type != DT_REG && type != DT_UNKNOWN))
+		return 0;
+	n = kmalloc(sizeof(*n), GFP_KERNEL);
+	if (!n)
+		return -ENOMEM;
+	memcpy(n->name, name, 16);
+	n->name[16] = '\0';
+	list_add_tail(&n->list, names);
+	return 0;
+}
+
+/* Find the cache directory and index what it holds, once; workqueue only */
+static int netcache_open_root(void)
+{
+	struct nameidata nd;
+	struct file *dir;
+	struct dentry *dentry;
+	struct netcache_name *n, *tmp;
+	LIST_HEAD(names);
+	int err;
+
+	if (netcache_root)
+		return 0;
+	if (!netcache_dir[0])
+		return -ENOENT;
+	err = path_lookup(netcache_dir, LOOKUP_FOLLOW | LOOKUP_DIRECTORY, &nd);
+	if (err)
+		return err;
+
+	dir = dentry_open(dget(nd.dentry), mntget(nd.mnt),
+			  O_RDONLY | O_DIRECTORY);
+	if (IS_ERR(dir)) {
+		err = PTR_ERR(dir);
+	} else {
+		err = vfs_readdir(dir, netcache_filldir, &names);
+		fput(dir);
+	}
+	if (!err) {
+		netcache_root = nd.dentry;
+		netcache_mnt = nd.mnt;
+		mutex_lock(&netcache_root->d_inode->i_mutex);
+	}
+	list_for_each_entry_safe(n, tmp, &names, list) {
+		if (!err) {
+			dentry = netcache_lookup(n->name);
+			if (!IS_ERR(dentry)) {
+				if (dentry->d_inode)
+					netcache_object_add(n->name,
+						i_size_read(dentry->d_inode),
+						&dentry->d_inode->i_mtime);
+				dput(dentry);
+			}
+		}
+		list_del(&n->list);
+		kfree(n);
+	}
+	if (err) {
+		path_release(&nd);
+		return err;
+	}
+	mutex_unlock(&netcache_root->d_inode->i_mutex);
+
+	printk(KERN_INFO "netcache: %s holds %lld KiB\n", netcache_dir,
+	       (long long)netcache_bytes >> 10);
+	netcache_evict();
+	return 0;
+}
+
+/*
+ * Open or create the cookie's backing file; called from the workqueue with
+ * cookie->lock held.
+ */
+static int netcache_open_object(struct netcache_cookie *cookie)
+{
+	struct netcache_object *obj;
+	struct dentry *dentry;
+	struct inode *dir;
+	struct file *file;
+	struct timespec now;
+	char name[17];
+	int err;
+
+	mutex_lock(&netcache_lock);
+	err = netcache_open_root();
+	if (err)
+		goto out;
+	netcache_name(cookie->key, cookie->keylen, name);
+	obj = netcache_object_find(name);
+	err = -EBUSY;		/* hash collision with a file in use */
+	if (obj && obj->cookie)
+		goto out;
+
+	dir = netcache_root->d_inode;
+	mutex_lock_nested(&dir->i_mutex, I_MUTEX_PARENT);
+	dentry = netcache_lookup(name);
+	err = PTR_ERR(dentry);
+	if (IS_ERR(dentry)) {
+		mutex_unlock(&dir->i_mutex);
+		goto out;
+	}
+	err = 0;
+	if (!dentry->d_inode)
+		err = vfs_create(dir, dentry, S_IFREG | 0600, NULL);
+	mutex_unlock(&dir->i_mutex);
+	if (err) {
+		dput(dentry);
+		goto out;
+	}
+
+	file = dentry_open(dentry, mntget(netcache_mnt),
+			   O_RDWR | O_LARGEFILE | O_NOATIME);
+	err = PTR_ERR(file);
+	if (IS_ERR(file))
+		goto out;
+	if (!obj) {
+		now = CURRENT_TIME;
+		obj = netcache_object_add(name,
+			i_size_read(file->f_path.dentry->d_inode), &now);
+		if (!obj) {
+			fput(file);
+			err = -ENOMEM;
+			goto out;
+		}
+	}
+	obj->cookie = cookie;
+	cookie->object = obj;
+	cookie->file = file;
+	err = 0;
+out:
+	mutex_unlock(&netcache_lock);
+	return err;
+}
+
+/*
+ * Delete the cookie's backing file if the cache holds one, without
+ * creating it first; called from the workqueue with cookie->lock held.
+ */
+static void netcache_remove_object(struct netcache_cookie *cookie)
+{
+	struct netcache_object *obj;
+	char name[17];
+
+	mutex_lock(&netcache_lock);
+	if (!netcache_open_root()) {
+		netcache_name(cookie->key, cookie->keylen, name);
+		obj = netcache_object_find(name);
+		if (obj && !obj->cookie)
+			netcache_object_remove(obj);
+	}
+	mutex_unlock(&netcache_lock);
+}
+
+/* Account for the backing file's size and make it most recently used */
+static void netcache_touch(struct netcache_cookie *cookie)
+{
+	struct netcache_object *obj = cookie->object;
+
+	mutex_lock(&netcache_lock);
+	netcache_object_resize(obj,
+		i_size_read(cookie->file->f_path.dentry->d_inode));
+	obj->used = CURRENT_TIME;
+	list_move_tail(&obj->lru, &netcache_lru);
+	if (netcache_over_limit())
+		queue_work(netcache_wq, &netcache_work);
+	mutex_unlock(&netcache_lock);
+}
+
+static void netcache_fill_hdr(struct netcache_hdr *hdr,
+	struct netcache_cookie *cookie, u32 flags)
+{
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->magic = cpu_to_le32(NETCACHE_MAGIC);
+	hdr->flags = cpu_to_le32(flags);
+	hdr->size = cpu_to_le64(cookie->aux.size);
+	hdr->mtime_sec = cpu_to_le64(cookie->aux.mtime.tv_sec);
+	hdr->mtime_nsec = cpu_to_le32(cookie->aux.mtime.tv_nsec);
+	hdr->change = cpu_to_le64(cookie->aux.change);
+	hdr->keylen = cpu_to_le32(cookie->keylen);
+	memcpy(hdr->key, cookie->key, cookie->keylen);
+}
+
+static int netcache_aux_equal(const struct netcache_aux *a,
+			      const struct netcache_aux *b)
+{
+	return a->size == b->size && timespec_equal(&a->mtime, &b->mtime) &&
+		a->change == b->change;
+}
+
+static int netcache_hdr_matches(const struct netcache_hdr *hdr,
+	struct netcache_cookie *cookie, const struct netcache_aux *aux)
+{
+	struct inode *inode = cookie->file->f_path.dentry->d_inode;
+
+	return le32_to_cpu(hdr->magic) == NETCACHE_MAGIC &&
+		(le32_to_cpu(hdr->flags) & NETCACHE_HDR_VALID) &&
+		le32_to_cpu(hdr->keylen) == cookie->keylen &&
+		!memcmp(hdr->key, cookie->key, cookie->keylen) &&
+		le64_to_cpu(hdr->size) == aux->size &&
+		le64_to_cpu(hdr->mtime_sec) == aux->mtime.tv_sec &&
+		le32_to_cpu(hdr->mtime_nsec) == aux->mtime.tv_nsec &&
+		le64_to_cpu(hdr->change) == aux->change &&
+		i_size_read(inode) == NETCACHE_DATA_OFFSET + aux->size;
+}
+
+/* Forget whatever is cached: nothing is read from it until refilled */
+static void netcache_drop(struct netcache_cookie *cookie)
+{
+	cookie->state = NETCACHE_NONE;
+	cookie->gen++;
+	vfree(cookie->present);
+	cookie->present = NULL;
+	if (cookie->file &&
+	    i_size_read(cookie->file->f_path.dentry->d_inode)) {
+		do_truncate(cookie->file->f_path.dentry, 0, 0, cookie->file);
+		netcache_touch(cookie);
+	}
+}
+
+/* Every page has been stored: make the copy usable */
+static void netcache_complete(struct netcache_cookie *cookie)
+{
+	struct netcache_hdr *hdr;
+	int err = -ENOMEM;
+
+	hdr = kmalloc(sizeof(*hdr), GFP_KERNEL);
+	if (hdr) {
+		netcache_fill_hdr(hdr, cookie, NETCACHE_HDR_VALID);
+		/* data first, so a valid header never covers missing data */
+		err = netcache_sync(cookie->file);
+		if (!err)
+			err = netcache_io(cookie->file, hdr, sizeof(*hdr), 0, 1);
+		if (!err)
+			err = netcache_sync(cookie->file);
+		kfree(hdr);
+	}
+	if (err) {
+		netcache_drop(cookie);
+		return;
+	}
+	vfree(cookie->present);
+	cookie->present = NULL;
+	cookie->state = NETCACHE_READY;
+	netcache_touch(cookie);
+}
+
+/* Start storing a fresh copy of the file described by aux */
+static void netcache_begin_fill(struct netcache_cookie *cookie,
+	struct netcache_hdr *hdr, const struct netcache_aux *aux)
+{
+	unsigned long npages;
+
+	netcache_drop(cookie);
+	cookie->aux = *aux;
+
+	npages = (aux->size + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	if (npages) {
+		cookie->present = vmalloc(BITS_TO_LONGS(npages) * sizeof(long));
+		if (!cookie->present)
+			return;
+		memset(cookie->present, 0, BITS_TO_LONGS(npages) * sizeof(long));
+	}
+	cookie->npages = npages;
+	cookie->nstored = 0;
+
+	netcache_fill_hdr(hdr, cookie, 0);
+	if (netcache_io(cookie->file, hdr, sizeof(*hdr), 0, 1)) {
+		netcache_drop(cookie);
+		return;
+	}
+	cookie->state = NETCACHE_FILLING;
+	if (!npages)
+		netcache_complete(cookie);
+}
+
+/**
+ * netcache_acquire - get a cookie for a file
+ * @key: names the file uniquely, e.g. server, share and path
+ * @keylen: bytes in @key, at most NETCACHE_KEY_MAX
+ *
+ * Returns NULL if the file can not be cached; the other calls accept a
+ * NULL cookie and do nothing.  Nothing is looked up until netcache_check.
+ */
+struct netcache_cookie *netcache_acquire(const void *key, size_t keylen)
+{
+	struct netcache_cookie *cookie;
+
+	if (!netcache_dir[0] || keylen > NETCACHE_KEY_MAX)
+		return NULL;
+	cookie = kzalloc(sizeof(*cookie) + keylen, GFP_KERNEL);
+	if (!cookie)
+		return NULL;
+	atomic_set(&cookie->usage, 1);
+	INIT_LIST_HEAD(&cookie->release);
+	mutex_init(&cookie->lock);
+	cookie->keylen = keylen;
+	memcpy(cookie->key, key, keylen);
+	return cookie;
+}
+EXPORT_SYMBOL(netcache_acquire);
+
+/* Last reference gone; called from the workqueue */
+static void netcache_free(struct netcache_cookie *cookie)
+{
+	if (cookie->file) {
+		mutex_lock(&netcache_lock);
+		netcache_object_resize(cookie->object,
+			i_size_read(cookie->file->f_path.dentry->d_inode));
+		cookie->object->cookie = NULL;
+		mutex_unlock(&netcache_lock);
+		fput(cookie->file);
+	}
+	vfree(cookie->present);
+	kfree(cookie);
+}
+
+/* Hand the cookie to the workqueue to free; never sleeps */
+static void netcache_put(struct netcache_cookie *cookie)
+{
+	if (!atomic_dec_and_test(&cookie->usage))
+		return;
+	spin_lock(&netcache_queue_lock);
+	list_add_tail(&cookie->release, &netcache_release_q);
+	spin_unlock(&netcache_queue_lock);
+	queue_work(netcache_wq, &netcache_work);
+}
+
+/* A synchronous request to the workqueue on behalf of a client */
+struct netcache_call {
+	struct work_struct		work;
+	struct completion		done;
+	struct netcache_cookie		*cookie;
+	const struct netcache_aux	*aux;
+	int				ret;
+};
+
+static int netcache_call(struct netcache_cookie *cookie,
+	const struct netcache_aux *aux, work_func_t fn)
+{
+	struct netcache_call call;
+
+	INIT_WORK(&call.work, fn);
+	init_completion(&call.done);
+	call.cookie = cookie;
+	call.aux = aux;
+	call.ret = 0;
+	queue_work(netcache_wq, &call.work);
+	wait_for_completion(&call.done);
+	return call.ret;
+}
+
+/**
+ * netcache_relinquish - the client is done with the file
+ * @cookie: from netcache_acquire
+ *
+ * Does not sleep, so it may be called from inode reclaim; the backing
+ * file is closed later by the workqueue.
+ */
+void netcache_relinquish(struct netcache_cookie *cookie)
+{
+	if (cookie)
+		netcache_put(cookie);
+}
+EXPORT_SYMBOL(netcache_relinquish);
+
+static void netcache_check_work(struct work_struct *work)
+{
+	struct netcache_call *call = container_of(work, struct netcache_call,
+						  work);
+	struct netcache_cookie *cookie = call->cookie;
+	const struct netcache_aux *aux = call->aux;
+	struct netcache_hdr *hdr;
+	int ret = 0;
+
+	mutex_lock(&cookie->lock);
+	if (cookie->state != NETCACHE_NONE &&
+	    netcache_aux_equal(&cookie->aux, aux)) {
+		ret = (cookie->state == NETCACHE_READY);
+		goto out;
+	}
+	if (aux->size > (loff_t)netcache_max_object_kb << 10) {
+		if (cookie->state != NETCACHE_NONE)
+			netcache_drop(cookie);
+		goto out;
+	}
+	if (!cookie->file && netcache_open_object(cookie))
+		goto out;
+
+	hdr = kmalloc(sizeof(*hdr), GFP_KERNEL);
+	if (!hdr)
+		goto out;
+	if (!netcache_io(cookie->file, hdr, sizeof(*hdr), 0, 0) &&
+	    netcache_hdr_matches(hdr, cookie, aux)) {
+		cookie->aux = *aux;
+		cookie->state = NETCACHE_READY;
+		netcache_touch(cookie);
+		ret = 1;
+	} else
+		netcache_begin_fill(cookie, hdr, aux);
+	kfree(hdr);
+out:
+	mutex_unlock(&cookie->lock);
+	call->ret = ret;
+	complete(&call->done);
+}
+
+/**
+ * netcache_check - validate the cached copy against the file's attributes
+ * @cookie: from netcache_acquire
+ * @aux: attributes the client has just revalidated, e.g. at open
+ *
+ * Returns 1 if reads can be served from the cache.  Otherwise a new copy
+ * is started and pages passed to netcache_store_page are kept.  May sleep.
+ */
+int netcache_check(struct netcache_cookie *cookie,
+		   const struct netcache_aux *aux)
+{
+	int ret = -1;
+
+	if (!cookie)
+		return 0;
+	mutex_lock(&cookie->lock);
+	if (cookie->state != NETCACHE_NONE &&
+	    netcache_aux_equal(&cookie->aux, aux))
+		ret = (cookie->state == NETCACHE_READY);
+	mutex_unlock(&cookie->lock);
+	if (ret < 0)
+		ret = netcache_call(cookie, aux, netcache_check_work);
+	return ret;
+}
+EXPORT_SYMBOL(netcache_check);
+
+static void netcache_invalidate_work(struct work_struct *work)
+{
+	struct netcache_call *call = container_of(work, struct netcache_call,
+						  work);
+	struct netcache_cookie *cookie = call->cookie;
+
+	mutex_lock(&cookie->lock);
+	if (!cookie->file)
+		netcache_remove_object(cookie);
+	netcache_drop(cookie);
+	mutex_unlock(&cookie->lock);
+	complete(&call->done);
+}
+
+/**
+ * netcache_invalidate - the file is being changed through this client
+ * @cookie: from netcache_acquire
+ *
+ * Drops the cached copy, including one left on disk by an earlier boot.
+ * May sleep.
+ */
+void netcache_invalidate(struct netcache_cookie *cookie)
+{
+	if (cookie)
+		netcache_call(cookie, NULL, netcache_invalidate_work);
+}
+EXPORT_SYMBOL(netcache_invalidate);
+
+/**
+ * netcache_stale - the client has dropped its cached pages of the file
+ * @cookie: from netcache_acquire
+ *
+ * For when the client sees the file change on the server while it is
+ * open.  Nothing is read from the cache until the next netcache_check,
+ * which starts a fresh copy if the attributes no longer match.  Leaves
+ * the backing file alone and does not wait for the workqueue.
+ */
+void netcache_stale(struct netcache_cookie *cookie)
+{
+	if (!cookie)
+		return;
+	mutex_lock(&cookie->lock);
+	if (cookie->state != NETCACHE_NONE) {
+		cookie->state = NETCACHE_NONE;
+		cookie->gen++;
+		vfree(cookie->present);
+		cookie->present = NULL;
+	}
+	mutex_unlock(&cookie->lock);
+}
+EXPORT_SYMBOL(netcache_stale);
+
+/* The client's view of the file still matches the cached copy */
+static int netcache_current(struct netcache_cookie *cookie,
+			    struct inode *inode)
+{
+	return cookie->state == NETCACHE_READY &&
+		i_size_read(inode) == cookie->aux.size &&
+		timespec_equal(&inode->i_mtime, &cookie->aux.mtime);
+}
+
+/**
+ * netcache_read_page - fill a locked page from the cache
+ * @cookie: from netcache_acquire
+ * @page: page of the client's file
+ *
+ * Returns 0 if the page was filled; the caller marks it uptodate and
+ * unlocks it.  Otherwise the caller must read it from the server, as it
+ * must if the file's size or mtime has changed since netcache_check.
+ */
+int netcache_read_page(struct netcache_cookie *cookie, struct page *page)
+{
+	loff_t pos = (loff_t)page->index << PAGE_CACHE_SHIFT;
+	size_t len = 0;
+	void *addr;
+	int err = -ENOBUFS;
+
+	if (!cookie)
+		return err;
+	mutex_lock(&cookie->lock);
+	if (!netcache_current(cookie, page->mapping->host))
+		goto out;
+	if (pos < cookie->aux.size)
+		len = min_t(loff_t, PAGE_CACHE_SIZE, cookie->aux.size - pos);
+	addr = kmap(page);
+	err = 0;
+	if (len)
+		err = netcache_io(cookie->file, addr, len,
+				  NETCACHE_DATA_OFFSET + pos, 0);
+	if (!err)
+		memset(addr + len, 0, PAGE_CACHE_SIZE - len);
+	kunmap(page);
+	if (err) {
+		printk(KERN_WARNING "netcache: read error %d, dropping %s\n",
+		       err, cookie->object->name);
+		netcache_drop(cookie);
+	} else
+		flush_dcache_page(page);
+out:
+	mutex_unlock(&cookie->lock);
+	return err;
+}
+EXPORT_SYMBOL(netcache_read_page);
+
+/**
+ * netcache_readpages - serve a readahead list from the cache
+ * @cookie: from netcache_acquire
+ * @mapping: the client file's mapping
+ * @pages: as passed to ->readpages
+ * @nr_pages: decremented for each page taken off @pages
+ *
+ * Returns 0 if the pages were taken; a page that could not be read is left
+ * !PageUptodate in the page cache for ->readpage to fetch.  Returns
+ * -ENOBUFS, with the list untouched, if the file is not cached.
+ */
+int netcache_readpages(struct netcache_cookie *cookie,
+		       struct address_space *mapping,
+		       struct list_head *pages, unsigned *nr_pages)
+{
+	struct page *page;
+
+	if (!cookie || !netcache_current(cookie, mapping->host))
+		return -ENOBUFS;
+	while (!list_empty(pages)) {
+		page = list_entry(pages->prev, struct page, lru);
+		list_del(&page->lru);
+		(*nr_pages)--;
+		if (add_to_page_cache_lru(page, mapping, page->index,
+					  GFP_KERNEL)) {
+			page_cache_release(page);
+			continue;
+		}
+		if (!netcache_read_page(cookie, page))
+			SetPageUptodate(page);
+		unlock_page(page);
+		page_cache_release(page);
+	}
+	return 0;
+}
+EXPORT_SYMBOL(netcache_readpages);
+
+static void netcache_write_page(struct netcache_cookie *cookie,
+				struct page *page, unsigned int gen)
+{
+	unsigned long index = page->index;
+	loff_t pos = (loff_t)index << PAGE_CACHE_SHIFT;
+	size_t len;
+	void *addr;
+	int err;
+
+	mutex_lock(&cookie->lock);
+	if (cookie->state != NETCACHE_FILLING || cookie->gen != gen ||
+	    index >= cookie->npages || test_bit(index, cookie->present))
+		goto out;
+	len = min_t(loff_t, PAGE_CACHE_SIZE, cookie->aux.size - pos);
+	addr = kmap(page);
+	err = netcache_io(cookie->file, addr, len,
+			  NETCACHE_DATA_OFFSET + pos, 1);
+	kunmap(page);
+	if (err) {
+		/* e.g. -ENOSPC: the client reads from the server meanwhile */
+		netcache_drop(cookie);
+		goto out;
+	}
+	__set_bit(index, cookie->present);
+	if (++cookie->nstored == cookie->npages)
+		netcache_complete(cookie);
+out:
+	mutex_unlock(&cookie->lock);
+}
+
+/* Store queued pages, free released cookies and trim the directory */
+static void netcache_worker(struct work_struct *work)
+{
+	struct netcache_store *st;
+	struct netcache_cookie *cookie;
+
+	for (;;) {
+		spin_lock(&netcache_queue_lock);
+		if (list_empty(&netcache_store_q)) {
+			spin_unlock(&netcache_queue_lock);
+			break;
+		}
+		st = list_entry(netcache_store_q.next,
+				struct netcache_store, list);
+		list_del(&st->list);
+		spin_unlock(&netcache_queue_lock);
+
+		netcache_write_page(st->cookie, st->page, st->gen);
+		page_cache_release(st->page);
+		netcache_put(st->cookie);
+		kfree(st);
+	}
+
+	for (;;) {
+		spin_lock(&netcache_queue_lock);
+		if (list_empty(&netcache_release_q)) {
+			spin_unlock(&netcache_queue_lock);
+			break;
+		}
+		cookie = list_entry(netcache_release_q.next,
+				    struct netcache_cookie, release);
+		list_del(&cookie->release);
+		spin_unlock(&netcache_queue_lock);
+
+		netcache_free(cookie);
+	}
+
+	mutex_lock(&netcache_lock);
+	if (netcache_root && netcache_over_limit())
+		netcache_evict();
+	mutex_unlock(&netcache_lock);
+}
+
+/**
+ * netcache_store_page - keep a page just read from the server
+ * @cookie: from netcache_acquire
+ * @page: PageUptodate page of the client's file
+ *
+ * The copy is made later from a workqueue, so this can be called from
+ * read completion context.  Does nothing unless a fill is in progress.
+ */
+void netcache_store_page(struct netcache_cookie *cookie, struct page *page)
+{
+	struct netcache_store *st;
+
+	if (!cookie || cookie->state != NETCACHE_FILLING || !netcache_wq)
+		return;
+	st = kmalloc(sizeof(*st), GFP_ATOMIC);
+	if (!st)
+		return;
+	atomic_inc(&cookie->usage);
+	page_cache_get(page);
+	st->cookie = cookie;
+	st->page = page;
+	st->gen = cookie->gen;
+
+	spin_lock(&netcache_queue_lock);
+	list_add_tail(&st->list, &netcache_store_q);
+	spin_unlock(&netcache_queue_lock);
+	queue_work(netcache_wq, &netcache_work);
+}
+EXPORT_SYMBOL(netcache_store_page);
+
+static int __init netcache_init(void)
+{
+	netcache_wq = create_singlethread_workqueue("netcache");
+	if (!netcache_wq)
+		return -ENOMEM;
+	return 0;
+}
+
+module_init(netcache_init);
@@ -28,6 +28,7 @@
 #include <linux/pagemap.h>
 #include <linux/smp_lock.h>
 #include <linux/aio.h>
+#include <linux/netcache.h>
 
 #include <asm/uaccess.h>
 #include <asm/system.h>
@@ -110,6 +111,54 @@ static int nfs_check_flags(int flags)
 /*
  * Open file
  */
+/*
+ * With the fsc mount option, check the local copy of the file against the
+ * attributes revalidated at open, or drop it if the file is opened for
+ * writing.
+ */
+static void nfs_netcache_open(struct inode *inode, struct file *filp)
+{
+	struct nfs_inode *nfsi = NFS_I(inode);
+	struct nfs_fh *fh = NFS_FH(inode);
+	const char *host = NFS_SERVER(inode)->nfs_client->cl_hostname;
+	struct netcache_cookie *cookie;
+	struct netcache_aux aux;
+	char *key;
+	size_t len;
+
+	if (!(NFS_SERVER(inode)->flags & NFS_MOUNT_FSCACHE) ||
+	    !S_ISREG(inode->i_mode))
+		return;
+
+	if (nfsi->netcache == NULL) {
+		len = strlen(host);
+		key = kmalloc(4 + len + 1 + fh->size, GFP_KERNEL);
+		if (key == NULL)
+			return;
+		memcpy(key, "nfs:", 4);
+		memcpy(key + 4, host, len + 1);
+		memcpy(key + 4 + len + 1, fh->data, fh->size);
+		cookie = netcache_acquire(key, 4 + len + 1 + fh->size);
+		kfree(key);
+		spin_lock(&inode->i_lock);
+		if (nfsi->netcache == NULL) {
+			nfsi->netcache = cookie;
+			cookie = NULL;
+		}
+		spin_unlock(&inode->i_lock);
+		netcache_relinquish(cookie);
+	}
+
+	if (filp->f_mode & FMODE_WRITE) {
+		netcache_invalidate(nfsi->netcache);
+		return;
+	}
+	aux.size = i_size_read(inode);
+	aux.mtime = inode->i_mtime;
+	aux.change = nfsi->change_attr;
+	netcache_check(nfsi->netcache, &aux);
+}
+
 static int
 nfs_file_open(struct inode *inode, struct file *filp)
 {
@@ -123,6 +172,8 @@ nfs_file_open(struct inode *inode, struct file *filp)
 	lock_kernel();
 	res = NFS_PROTO(inode)->file_open(inode, filp);
 	unlock_kernel();
+	if (res == 0)
+		nfs_netcache_open(inode, filp);
 	return res;
 }
 
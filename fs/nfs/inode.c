@@ -37,6 +37,7 @@
 #include <linux/vfs.h>
 #include <linux/inet.h>
 #include <linux/nfs_xdr.h>
+#include <linux/netcache.h>
 
 #include <asm/system.h>
 #include <asm/uaccess.h>
@@ -111,6 +112,8 @@ void nfs_clear_inode(struct inode *inode)
 	BUG_ON(!list_empty(&NFS_I(inode)->open_files));
 	nfs_zap_acl_cache(inode);
 	nfs_access_zap_cache(inode);
+	netcache_relinquish(NFS_I(inode)->netcache);
+	NFS_I(inode)->netcache = NULL;
 }
 
 /**
@@ -723,6 +726,7 @@ static int nfs_invalidate_mapping_nolock(struct inode *inode, struct address_spa
 		if (ret < 0)
 			return ret;
 	}
+	netcache_stale(nfsi->netcache);
 	spin_lock(&inode->i_lock);
 	nfsi->cache_validity &= ~NFS_INO_INVALID_DATA;
 	if (S_ISDIR(inode->i_mode))
@@ -1147,6 +1151,7 @@ struct inode *nfs_alloc_inode(struct super_block *sb)
 		return NULL;
 	nfsi->flags = 0UL;
 	nfsi->cache_validity = 0UL;
+	nfsi->netcache = NULL;
 #ifdef CONFIG_NFS_V3_ACL
 	nfsi->acl_access = ERR_PTR(-EAGAIN);
 	nfsi->acl_default = ERR_PTR(-EAGAIN);
@@ -19,6 +19,7 @@
 #include <linux/nfs_fs.h>
 #include <linux/nfs_page.h>
 #include <linux/smp_lock.h>
+#include <linux/netcache.h>
 
 #include <asm/system.h>
 
@@ -142,7 +143,11 @@ static int nfs_readpage_async(struct nfs_open_context *ctx, struct inode *inode,
 
 static void nfs_readpage_release(struct nfs_page *req)
 {
-	unlock_page(req->wb_page);
+	struct page *page = req->wb_page;
+
+	if (PageUptodate(page))
+		netcache_store_page(NFS_I(page->mapping->host)->netcache, page);
+	unlock_page(page);
 
 	dprintk("NFS: read done (%s/%Ld %d@%Ld)\n",
 			req->wb_context->path.dentry->d_inode->i_sb->s_id,
@@ -488,6 +493,12 @@ int nfs_readpage(struct file *file, struct page *page)
 	if (NFS_STALE(inode))
 		goto out_unlock;
 
+	if (netcache_read_page(NFS_I(inode)->netcache, page) == 0) {
+		SetPageUptodate(page);
+		error = 0;
+		goto out_unlock;
+	}
+
 	if (file == NULL) {
 		error = -EBADF;
 		ctx = nfs_find_open_context(inode, NULL, FMODE_READ);
@@ -567,6 +578,12 @@ int nfs_readpages(struct file *filp, struct address_space *mapping,
 	if (NFS_STALE(inode))
 		goto out;
 
+	ret = netcache_readpages(NFS_I(inode)->netcache, mapping,
+				 pages, &nr_pages);
+	if (ret == 0)
+		goto out;
+	ret = -ESTALE;
+
 	if (filp == NULL) {
 		desc.ctx = nfs_find_open_context(inode, NULL, FMODE_READ);
 		if (desc.ctx == NULL)
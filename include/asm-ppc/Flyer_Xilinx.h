@@ -12,7 +12,39 @@ typedef struct
     int iTimeout;
 } waitStruct;
 
-	
+
+/*
+ * XIL_WAIT_EVENTS: arm several wake conditions with one call and learn
+ * which one ended the wait.  tsDeadline is an absolute CLOCK_MONOTONIC
+ * time (both fields zero for no deadline), so a wait restarted after a
+ * signal keeps its original deadline.
+ *
+ * A wait interrupted by a signal stores the event counts it started from
+ * in dwGen and sets XIL_EVENT_RESUME in dwEvents, so the restarted call
+ * still reports an event that fired while the handler ran.  A completed
+ * wait clears XIL_EVENT_RESUME again; clear it yourself to start afresh
+ * after an -EINTR.
+ *
+ * XIL_EVENT_DIGITAL and XIL_SET_WAIT_DIGITAL share the one wait digital
+ * register: each fails with -EBUSY while the other has it armed, as does
+ * XIL_EVENT_DIGITAL with a different dwState than the current waiters.
+ */
+#define XIL_EVENT_DIGITAL	0x1	/* wait digital Mask/Value (dwState) met */
+#define XIL_EVENT_PART		0x2	/* part sense / tracking interrupt */
+#define XIL_EVENT_ABORT		0x4	/* abort input or XIL_WAKE_IO_SLEEPERS */
+#define XIL_EVENT_DEADLINE	0x8	/* out only: tsDeadline passed */
+#define XIL_EVENT_RESUME	0x80000000 /* in/out: dwGen is valid */
+#define XIL_NR_EVENTS		3
+
+typedef struct
+{
+    uint dwEvents;		/* in: XIL_EVENT_* to wait for */
+    uint dwState;		/* in: | Mask(8) | Value(8) | for XIL_EVENT_DIGITAL */
+    struct timespec tsDeadline;	/* in: absolute CLOCK_MONOTONIC deadline */
+    uint dwFired;		/* out: XIL_EVENT_* that ended the wait */
+    struct timespec tsFired;	/* out: CLOCK_MONOTONIC time of the event */
+    uint dwGen[XIL_NR_EVENTS];	/* in/out: see XIL_EVENT_RESUME */
+} waitEventStruct;
 
 #define SIG_TESTMARK SIGUSR1
 #define SIG_ABORT SIGURG //this won't be used for the servo thread.
@@ -130,6 +162,9 @@ typedef struct
 #define XIL_GET_DIODE_PTR _IO(XILINX_CONFIG_IOCTL_BASE,0x61)
 /*| Unused(15bits) | Bit 0(1-enabled,0-disabled) | */
 
+#define XIL_WAIT_EVENTS _IOWR(XILINX_CONFIG_IOCTL_BASE,0x62,waitEventStruct)
+/* see waitEventStruct above */
+
 //Read/Write offsets from the Xilinx base address...
 #define XIL_KEYPAD_OFFSET       0x0   /* Read Only */
 #define XIL_ENC_CFG_OFFSET	0x0   /* Write Only */
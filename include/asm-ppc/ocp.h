@@ -119,6 +119,7 @@ struct ocp_driver {
 	void (*remove) (struct ocp_device *dev);	/* Device removed (NULL if not a hot-plug capable driver) */
 	int  (*suspend) (struct ocp_device *dev, pm_message_t state);	/* Device suspended */
 	int  (*resume) (struct ocp_device *dev);	                /* Device woken up */
+	void (*shutdown) (struct ocp_device *dev);	/* Stop DMA before reboot/kexec */
 	struct device_driver driver;
 };
 
@@ -43,6 +43,7 @@ struct sockaddr_ll
 #define PACKET_COPY_THRESH		7
 #define PACKET_AUXDATA			8
 #define PACKET_ORIGDEV			9
+#define PACKET_TX_RING			13
 
 struct tpacket_stats
 {
@@ -67,6 +68,11 @@ struct tpacket_hdr
 #define TP_STATUS_COPY		2
 #define TP_STATUS_LOSING	4
 #define TP_STATUS_CSUMNOTREADY	8
+/* Tx ring - header status */
+#define TP_STATUS_AVAILABLE	0
+#define TP_STATUS_SEND_REQUEST	1
+#define TP_STATUS_SENDING	2
+#define TP_STATUS_WRONG_FORMAT	4
 	unsigned int	tp_len;
 	unsigned int	tp_snaplen;
 	unsigned short	tp_mac;
@@ -90,6 +96,10 @@ struct tpacket_hdr
    - Start+tp_mac: [ Optional MAC header ]
    - Start+tp_net: Packet data, aligned to TPACKET_ALIGNMENT=16.
    - Pad to align to TPACKET_ALIGNMENT=16
+
+   In a PACKET_TX_RING frame the data to send, tp_len bytes including
+   the link level header for SOCK_RAW, starts at
+   Start + TPACKET_HDRLEN - sizeof(struct sockaddr_ll).
  */
 
 struct tpacket_req
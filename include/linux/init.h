@@ -91,6 +91,9 @@ extern unsigned int reset_devices;
 void setup_arch(char **);
 void prepare_namespace(void);
 
+extern int start_async_initcall(initcall_t fn);
+extern void async_synchronize_initcalls(void);
+
 #endif
   
 #ifndef MODULE
@@ -193,6 +196,25 @@ void __init parse_early_param(void);
  */
 #define module_init(x)	__initcall(x);
 
+/**
+ * async_initcall() - driver initialization run in parallel with the boot
+ * @fn: function to be run at kernel boot time or module insertion
+ *
+ * Like module_init(), but when built in, @fn is started at device_initcall
+ * time in a kernel thread of its own and the boot carries on without it.
+ * Only for drivers whose init may overlap with everything after it: all
+ * async initcalls have finished before the root filesystem is mounted and
+ * before init runs, but any other code that needs the device earlier must
+ * call async_synchronize_initcalls() first.  @fn itself must not call
+ * async_synchronize_initcalls(), directly or through a function it calls:
+ * it would wait for its own completion and deadlock the boot.  A failing
+ * @fn is always reported on the console, since the boot has moved on.
+ */
+#define async_initcall(fn)					\
+	static int __init __async_initcall_##fn(void)		\
+	{ return start_async_initcall(fn); }			\
+	device_initcall(__async_initcall_##fn)
+
 /**
  * module_exit() - driver exit entry point
  * @x: function to be run when driver is removed
@@ -215,6 +237,7 @@ void __init parse_early_param(void);
 #define fs_initcall(fn)			module_init(fn)
 #define device_initcall(fn)		module_init(fn)
 #define late_initcall(fn)		module_init(fn)
+#define async_initcall(fn)		module_init(fn)
 
 #define security_initcall(fn)		module_init(fn)
 
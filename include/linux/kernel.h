@@ -194,6 +194,14 @@ static inline int log_buf_read(int idx) { return 0; }
 static inline int log_buf_copy(char *dest, int idx, int len) { return 0; }
 #endif
 
+#ifdef CONFIG_PRINTK_ASYNC
+extern void printk_tick(void);
+extern int printk_needs_cpu(int cpu);
+#else
+static inline void printk_tick(void) { }
+static inline int printk_needs_cpu(int cpu) { return 0; }
+#endif
+
 unsigned long int_sqrt(unsigned long);
 
 extern int printk_ratelimit(void);
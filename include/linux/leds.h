@@ -110,6 +110,18 @@ extern void ledtrig_ide_activity(void);
 #define ledtrig_ide_activity() do {} while(0)
 #endif
 
+#if defined(CONFIG_LEDS_FLYER) || defined(CONFIG_LEDS_FLYER_MODULE)
+extern void flyer_led_marking(int hz);
+extern void flyer_led_fault(int hz);
+extern void flyer_led_set_usb(int state);
+extern void flyer_led_usb_activity(void);
+#else
+#define flyer_led_marking(hz) do {} while(0)
+#define flyer_led_fault(hz) do {} while(0)
+#define flyer_led_set_usb(state) do {} while(0)
+#define flyer_led_usb_activity() do {} while(0)
+#endif
+
 /* For the leds-gpio driver */
 struct gpio_led {
 	const char *name;
@@ -0,0 +1,28 @@
+#ifndef _LINUX_MEM_NOTIFY_H
+#define _LINUX_MEM_NOTIFY_H
+
+/*
+ * Memory pressure levels reported by /dev/mem_notify.
+ */
+#define MEM_PRESSURE_NONE	0	/* free memory above the low watermark */
+#define MEM_PRESSURE_LOW	1	/* kswapd is reclaiming */
+#define MEM_PRESSURE_MEDIUM	2	/* kswapd is falling behind */
+#define MEM_PRESSURE_CRITICAL	3	/* allocations are in direct reclaim */
+
+#ifdef __KERNEL__
+
+#ifdef CONFIG_MEM_NOTIFY
+extern void mem_notify_raise(int level);
+extern void mem_notify_recalc(void);
+#else
+static inline void mem_notify_raise(int level)
+{
+}
+
+static inline void mem_notify_recalc(void)
+{
+}
+#endif
+
+#endif /* __KERNEL__ */
+#endif /* _LINUX_MEM_NOTIFY_H */
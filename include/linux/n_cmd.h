@@ -0,0 +1,47 @@
+/*
+ * n_cmd - line discipline for framed serial command channels
+ *
+ * Received bytes are collected into commands ending in a delimiter
+ * byte (carriage return by default).  read() returns one complete
+ * command.  CMDIOCGSTAMP gives the time the delimiter of the command
+ * last returned by read() arrived, on CLOCK_MONOTONIC.  CMDIOCBULKREAD
+ * returns every queued command, each behind a struct cmd_frame_hdr, in
+ * one call.
+ *
+ * This software may be used and distributed according to the terms of
+ * the GNU General Public License, incorporated herein by reference.
+ */
+#ifndef _LINUX_N_CMD_H
+#define _LINUX_N_CMD_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+#include <linux/time.h>
+
+/* cmd_frame_hdr.flags */
+#define CMD_FRAME_TRUNCATED	0x0001	/* longer than maxframe, tail lost */
+#define CMD_FRAME_ERROR		0x0002	/* parity/framing/overrun error */
+
+struct cmd_frame_hdr {
+	struct timespec	stamp;
+	__u16		len;		/* bytes of data following */
+	__u16		flags;
+};
+
+/* Records in buf are padded to CMD_FRAME_ALIGN bytes */
+#define CMD_FRAME_ALIGN		4
+
+struct cmd_bulk_read {
+	void __user	*buf;
+	__u32		size;		/* in: size of buf */
+	__u32		frames;		/* out: commands returned */
+};
+
+#define CMDIOC_MAGIC		0xB2
+
+#define CMDIOCGSTAMP	_IOR(CMDIOC_MAGIC, 0x00, struct timespec)
+#define CMDIOCGDELIM	_IOR(CMDIOC_MAGIC, 0x01, int)
+#define CMDIOCSDELIM	_IOW(CMDIOC_MAGIC, 0x02, int)
+#define CMDIOCBULKREAD	_IOWR(CMDIOC_MAGIC, 0x03, struct cmd_bulk_read)
+
+#endif /* _LINUX_N_CMD_H */
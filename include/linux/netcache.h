@@ -0,0 +1,89 @@
+/*
+ * netcache - persistent local cache of network file contents
+ *
+ * A network filesystem client gets a cookie for each regular file it wants
+ * cached, keyed by something that names the file uniquely on the server.
+ * The cache keeps one backing file per cookie in a directory on a local
+ * filesystem, so that files read again after a reboot or while the
+ * server is slow can come from local storage.
+ *
+ * A backing file is only used once it holds the whole file and its
+ * attributes (size, mtime and change attribute, as far as the protocol has
+ * them) still match the ones the client sees at open.  Otherwise the
+ * client reads from the server as usual and hands each page it brings
+ * uptodate to netcache_store_page() until the copy is complete.  A client
+ * that drops its page cache because the file changed on the server while
+ * open calls netcache_stale(), and pages are never served from the cache
+ * once the inode's size or mtime differs from those checked at open.
+ */
+#ifndef _LINUX_NETCACHE_H
+#define _LINUX_NETCACHE_H
+
+#include <linux/types.h>
+#include <linux/time.h>
+#include <linux/errno.h>
+
+struct page;
+struct list_head;
+struct address_space;
+struct netcache_cookie;
+
+/* Attributes a cached copy is validated against */
+struct netcache_aux {
+	loff_t		size;
+	struct timespec	mtime;
+	u64		change;		/* 0 if the protocol has none */
+};
+
+#define NETCACHE_KEY_MAX	512
+
+#ifdef CONFIG_NETCACHE
+
+extern struct netcache_cookie *netcache_acquire(const void *key,
+						size_t keylen);
+extern void netcache_relinquish(struct netcache_cookie *cookie);
+extern int netcache_check(struct netcache_cookie *cookie,
+			  const struct netcache_aux *aux);
+extern void netcache_invalidate(struct netcache_cookie *cookie);
+extern void netcache_stale(struct netcache_cookie *cookie);
+extern int netcache_read_page(struct netcache_cookie *cookie,
+			      struct page *page);
+extern int netcache_readpages(struct netcache_cookie *cookie,
+			      struct address_space *mapping,
+			      struct list_head *pages, unsigned *nr_pages);
+extern void netcache_store_page(struct netcache_cookie *cookie,
+				struct page *page);
+
+#else /* CONFIG_NETCACHE */
+
+static inline struct netcache_cookie *netcache_acquire(const void *key,
+						       size_t keylen)
+{
+	return NULL;
+}
+static inline void netcache_relinquish(struct netcache_cookie *cookie) {}
+static inline int netcache_check(struct netcache_cookie *cookie,
+				 const struct netcache_aux *aux)
+{
+	return 0;
+}
+static inline void netcache_invalidate(struct netcache_cookie *cookie) {}
+static inline void netcache_stale(struct netcache_cookie *cookie) {}
+static inline int netcache_read_page(struct netcache_cookie *cookie,
+				     struct page *page)
+{
+	return -ENOBUFS;
+}
+static inline int netcache_readpages(struct netcache_cookie *cookie,
+				     struct address_space *mapping,
+				     struct list_head *pages,
+				     unsigned *nr_pages)
+{
+	return -ENOBUFS;
+}
+static inline void netcache_store_page(struct netcache_cookie *cookie,
+				       struct page *page) {}
+
+#endif /* CONFIG_NETCACHE */
+
+#endif /* _LINUX_NETCACHE_H */
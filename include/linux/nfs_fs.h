@@ -166,6 +166,9 @@ struct nfs_inode {
 	struct hlist_head	silly_list;
 	wait_queue_head_t	waitqueue;
 
+	/* Local copy of the file, if mounted with fsc */
+	struct netcache_cookie	*netcache;
+
 #ifdef CONFIG_NFS_V4
 	struct nfs4_cached_acl	*nfs4_acl;
         /* NFSv4 state */
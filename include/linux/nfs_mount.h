@@ -65,4 +65,7 @@ struct nfs_mount_data {
 #define NFS_MOUNT_UNSHARED	0x8000	/* 5 */
 #define NFS_MOUNT_FLAGMASK	0xFFFF
 
+/* The following are for internal use only */
+#define NFS_MOUNT_FSCACHE	0x10000	/* keep local copies, see netcache.h */
+
 #endif
@@ -96,6 +96,51 @@ struct spi_local {
 };
 
 
+/*
+ * Servo status telemetry.  Every frame sent to a servo (each write(),
+ * and each asynchronous read()) appends one record to that axis' ring:
+ * the last word the servo shifted back, the Xilinx status read with it,
+ * a per-axis frame sequence number and a CLOCK_MONOTONIC stamp.
+ *
+ * The ring can be mmap()ed read-only from the axis' device (offset 0,
+ * spi_status_ring_size() bytes).  Record seq goes to rec[seq & (nr - 1)];
+ * head is the seq the next frame will get and is updated after the
+ * record is complete.  A reader copying rec[i & (nr - 1)] checks that
+ * its seq is still i afterwards to detect being overtaken.
+ *
+ * SPI_STATUS_READ copies records from seq 'from' on (or the oldest one
+ * still held, if 'from' was overwritten) and sets 'from' to the seq of
+ * the first record copied and 'next' to the seq to ask for next time.
+ */
+struct spi_servo_status {
+	__u32 seq;
+	__u16 status;		/* servo status word */
+	__u16 xil;		/* XIL_STATUS (or XIL_Z_STATUS) */
+	__u32 tv_sec;
+	__u32 tv_nsec;
+};
+
+struct spi_status_ring {
+	__u32 head;		/* seq of the next record */
+	__u32 nr;		/* records, a power of 2 */
+	__u32 reserved[2];
+	struct spi_servo_status rec[0];
+};
+
+struct spi_status_read {
+	struct spi_servo_status __user *buf;
+	__u32 count;		/* in: records buf holds, out: copied */
+	__u32 from;		/* in: first seq wanted, out: first copied */
+	__u32 next;		/* out: seq following the last copied */
+};
+
+#define SPI_STATUS_READ _IOWR(0xAF,14,struct spi_status_read)
+
+static inline unsigned long spi_status_ring_size(unsigned int nr)
+{
+	return sizeof(struct spi_status_ring) + nr * sizeof(struct spi_servo_status);
+}
+
 /* Exported functions */
 //extern void spi_access_bus(short device);
 //extern void spi_release_bus(short device);
@@ -652,7 +652,8 @@ asmlinkage void __init start_kernel(void)
 	rest_init();
 }
 
-static int __initdata initcall_debug;
+/* Not __initdata: async_synchronize_initcalls() may look at it later */
+static int initcall_debug;
 
 static int __init initcall_debug_setup(char *str)
 {
@@ -663,62 +664,131 @@ __setup("initcall_debug", initcall_debug_setup);
 
 extern initcall_t __initcall_start[], __initcall_end[];
 
-static void __init do_initcalls(void)
+static int __init do_one_initcall(initcall_t fn, const char *how)
 {
-	initcall_t *call;
 	int count = preempt_count();
+	ktime_t t0;
+	char *msg = NULL;
+	char msgbuf[40];
+	int result;
+
+	if (initcall_debug) {
+		printk("Calling %sinitcall 0x%p", how, fn);
+		print_fn_descriptor_symbol(": %s()", (unsigned long) fn);
+		printk("\n");
+		t0 = ktime_get();
+	}
 
-	for (call = __initcall_start; call < __initcall_end; call++) {
-		ktime_t t0, t1, delta;
-		char *msg = NULL;
-		char msgbuf[40];
-		int result;
-
-		if (initcall_debug) {
-			printk("Calling initcall 0x%p", *call);
-			print_fn_descriptor_symbol(": %s()",
-					(unsigned long) *call);
-			printk("\n");
-			t0 = ktime_get();
-		}
+	result = fn();
 
-		result = (*call)();
+	if (initcall_debug) {
+		printk("%sinitcall 0x%p", how, fn);
+		print_fn_descriptor_symbol(": %s()", (unsigned long) fn);
+		printk(" returned %d after %Ld usecs\n", result,
+			(unsigned long long) ktime_us_delta(ktime_get(), t0));
+	}
 
-		if (initcall_debug) {
-			t1 = ktime_get();
-			delta = ktime_sub(t1, t0);
+	/* nobody else sees an async initcall's result, so always report it */
+	if (result && result != -ENODEV && (initcall_debug || *how)) {
+		sprintf(msgbuf, "error code %d", result);
+		msg = msgbuf;
+	}
+	if (preempt_count() != count) {
+		msg = "preemption imbalance";
+		preempt_count() = count;
+	}
+	if (irqs_disabled()) {
+		msg = "disabled interrupts";
+		local_irq_enable();
+	}
+	if (msg) {
+		printk(KERN_WARNING "initcall at 0x%p", fn);
+		print_fn_descriptor_symbol(": %s()", (unsigned long) fn);
+		printk(": returned with %s\n", msg);
+	}
+	return result;
+}
 
-			printk("initcall 0x%p", *call);
-			print_fn_descriptor_symbol(": %s()",
-					(unsigned long) *call);
-			printk(" returned %d.\n", result);
+/*
+ * Async initcalls: each one gets a kernel thread, and the boot only waits
+ * for them at async_synchronize_initcalls(), which kernel_init() calls
+ * before mounting the root filesystem.  The thread function and the wait
+ * stay around after boot; the initcalls themselves are gone by then, but
+ * they are always finished.  An async initcall must not call
+ * async_synchronize_initcalls() itself: it would wait for itself.
+ */
+static atomic_t async_initcalls_pending = ATOMIC_INIT(0);
+static DECLARE_WAIT_QUEUE_HEAD(async_initcalls_wq);
 
-			printk("initcall 0x%p ran for %Ld msecs: ",
-				*call, (unsigned long long)delta.tv64 >> 20);
-			print_fn_descriptor_symbol("%s()\n",
-				(unsigned long) *call);
-		}
+static int __initdata noasyncinit;
 
-		if (result && result != -ENODEV && initcall_debug) {
-			sprintf(msgbuf, "error code %d", result);
-			msg = msgbuf;
-		}
-		if (preempt_count() != count) {
-			msg = "preemption imbalance";
-			preempt_count() = count;
-		}
-		if (irqs_disabled()) {
-			msg = "disabled interrupts";
-			local_irq_enable();
-		}
-		if (msg) {
-			printk(KERN_WARNING "initcall at 0x%p", *call);
-			print_fn_descriptor_symbol(": %s()",
-					(unsigned long) *call);
-			printk(": returned with %s\n", msg);
-		}
+static int __init noasyncinit_setup(char *str)
+{
+	noasyncinit = 1;
+	return 1;
+}
+__setup("noasyncinit", noasyncinit_setup);
+
+static int __init_refok async_initcall_thread(void *data)
+{
+	int result;
+
+	result = do_one_initcall((initcall_t) data, "async ");
+
+	if (atomic_dec_and_test(&async_initcalls_pending))
+		wake_up(&async_initcalls_wq);
+	return result;
+}
+
+int __init start_async_initcall(initcall_t fn)
+{
+	struct task_struct *task;
+
+	if (!noasyncinit) {
+		atomic_inc(&async_initcalls_pending);
+		task = kthread_run(async_initcall_thread, fn, "initcall");
+		if (!IS_ERR(task))
+			return 0;
+		atomic_dec(&async_initcalls_pending);
 	}
 
+	/* No thread: just run it here */
+	return fn();
+}
+
+/*
+ * Wait for all async initcalls to finish.  Anything that depends on a
+ * device set up by one, and that can run before the root filesystem is
+ * mounted, has to call this first.  Cheap once they are done.  Never
+ * call it from an async initcall, which would wait for itself forever.
+ */
+void async_synchronize_initcalls(void)
+{
+	ktime_t t0;
+
+	if (!atomic_read(&async_initcalls_pending))
+		return;
+
+	t0 = ktime_get();
+	wait_event(async_initcalls_wq, !atomic_read(&async_initcalls_pending));
+	if (initcall_debug)
+		printk("async initcalls waited for %Ld usecs\n",
+			(unsigned long long) ktime_us_delta(ktime_get(), t0));
+}
+EXPORT_SYMBOL(async_synchronize_initcalls);
+
+static void __init do_initcalls(void)
+{
+	initcall_t *call;
+	ktime_t t0 = ktime_get();
+
+	for (call = __initcall_start; call < __initcall_end; call++)
+		do_one_initcall(*call, "");
+
+	if (initcall_debug)
+		printk("initcalls took %Ld usecs\n",
+			(unsigned long long) ktime_us_delta(ktime_get(), t0));
+
 	/* Make sure there is no pending stuff from the initcall sequence */
 	flush_scheduled_work();
 }
@@ -838,6 +908,12 @@ static int __init kernel_init(void * unused)
 
 	do_basic_setup();
 
+	/*
+	 * Both the root filesystem and early userspace may need devices
+	 * which async initcalls are still setting up.
+	 */
+	async_synchronize_initcalls();
+
 	/*
 	 * check if there is an early userspace init.  If yes, let it do all
 	 * the work
@@ -34,6 +34,7 @@
 #include <linux/syscalls.h>
 #include <linux/jiffies.h>
 #include <linux/logbuff.h>
+#include <linux/kthread.h>
 
 #include <asm/uaccess.h>
 
@@ -624,8 +625,71 @@ static void call_console_drivers(unsigned long start, unsigned long end)
 	_call_console_drivers(start_print, end, msg_level);
 }
 
+#ifdef CONFIG_PRINTK_ASYNC
+/*
+ * In async mode printk() leaves the console output to kconsoled.
+ * Output falls back to the synchronous path until the thread runs, once
+ * the system starts going down, and whenever an oops is in progress.
+ */
+static int printk_async = 1;
+module_param_named(async, printk_async, bool, S_IRUGO | S_IWUSR);
+
+/* Lines overwritten in log_buf before they reached the consoles */
+static unsigned long console_lost_lines;
+module_param_named(lost_lines, console_lost_lines, ulong, S_IRUGO);
+
+static struct task_struct *console_task;
+static DECLARE_WAIT_QUEUE_HEAD(console_async_wait);
+
+static inline int printk_async_active(void)
+{
+	return printk_async && console_task && !oops_in_progress &&
+		system_state == SYSTEM_RUNNING;
+}
+
+/*
+ * printk() can be called with the runqueue lock held, so it must not
+ * wake kconsoled itself.  It only flags the CPU; the next timer tick
+ * does the wakeup from printk_tick().
+ */
+static DEFINE_PER_CPU(int, console_async_pending);
+
+static inline void wake_up_console_async(void)
+{
+	__get_cpu_var(console_async_pending) = 1;
+}
+
+void printk_tick(void)
+{
+	if (__get_cpu_var(console_async_pending)) {
+		__get_cpu_var(console_async_pending) = 0;
+		if (waitqueue_active(&console_async_wait))
+			wake_up(&console_async_wait);
+	}
+}
+
+/* Keep the tick running on a NOHZ CPU that still has a wakeup to do */
+int printk_needs_cpu(int cpu)
+{
+	return per_cpu(console_async_pending, cpu);
+}
+#else
+static inline int printk_async_active(void)
+{
+	return 0;
+}
+
+static inline void wake_up_console_async(void)
+{
+}
+#endif /* CONFIG_PRINTK_ASYNC */
+
 static void emit_log_char(char c)
 {
+#ifdef CONFIG_PRINTK_ASYNC
+	if (log_end - con_start >= log_buf_len && LOG_BUF(log_end) == '\n')
+		console_lost_lines++;
+#endif
 	LOG_BUF(log_end) = c;
 	log_end++;
 	if (log_end - log_start > log_buf_len)
@@ -814,7 +878,17 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 			log_level_unknown = 1;
 	}
 
-	if (!down_trylock(&console_sem)) {
+	if (printk_async_active()) {
+		/*
+		 * Leave the text in log_buf for kconsoled; the caller
+		 * doesn't wait for the consoles.
+		 */
+		wake_up_console_async();
+		printk_cpu = UINT_MAX;
+		spin_unlock(&logbuf_lock);
+		lockdep_on();
+		raw_local_irq_restore(flags);
+	} else if (!down_trylock(&console_sem)) {
 		/*
 		 * We own the drivers.  We can drop the spinlock and
 		 * let release_console_sem() print the text, maybe ...
@@ -857,6 +931,87 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 EXPORT_SYMBOL(printk);
 EXPORT_SYMBOL(vprintk);
 
+#ifdef CONFIG_PRINTK_ASYNC
+/*
+ * Characters written per interrupts-off stretch by kconsoled: 16 keep
+ * each stretch at about 1.4ms on a 115200 baud serial console.
+ */
+#define CONSOLE_ASYNC_CHUNK	16
+
+/*
+ * Copy log_buf to the consoles in small pieces, re-enabling interrupts
+ * and giving up the CPU between them, so that a slow serial console
+ * only costs the time of one chunk at a time.
+ *
+ * console_sem is dropped between chunks: kconsoled runs at nice 19, and
+ * an oops or panic that needs to print synchronously must not find the
+ * semaphore held by a thread that is waiting for the CPU.
+ */
+static void console_async_flush(void)
+{
+	unsigned long flags;
+	unsigned long start, end;
+
+	for (;;) {
+		acquire_console_sem();
+		if (console_suspended)
+			break;
+		spin_lock_irqsave(&logbuf_lock, flags);
+		if (con_start == log_end) {
+			spin_unlock_irqrestore(&logbuf_lock, flags);
+			break;
+		}
+		start = con_start;
+		end = log_end;
+		if (end - start > CONSOLE_ASYNC_CHUNK)
+			end = start + CONSOLE_ASYNC_CHUNK;
+		con_start = end;
+		spin_unlock(&logbuf_lock);
+		call_console_drivers(start, end);
+		local_irq_restore(flags);
+
+		/* Release by hand to avoid flushing the rest of the buffer. */
+		console_locked = 0;
+		up(&console_sem);
+		cond_resched();
+	}
+	release_console_sem();
+}
+
+static int console_thread(void *unused)
+{
+	unsigned long reported = 0;
+
+	set_user_nice(current, 19);
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(console_async_wait,
+				con_start != log_end || kthread_should_stop());
+		console_async_flush();
+		if (console_lost_lines != reported) {
+			printk(KERN_WARNING "printk: %lu console lines lost\n",
+					console_lost_lines - reported);
+			reported = console_lost_lines;
+		}
+	}
+	return 0;
+}
+
+static int __init console_async_init(void)
+{
+	struct task_struct *p;
+
+	p = kthread_run(console_thread, NULL, "kconsoled");
+	if (IS_ERR(p)) {
+		printk(KERN_ERR "printk: unable to start kconsoled, "
+				"console output stays synchronous\n");
+		return PTR_ERR(p);
+	}
+	console_task = p;
+	return 0;
+}
+late_initcall(console_async_init);
+#endif /* CONFIG_PRINTK_ASYNC */
+
 #else
 
 asmlinkage long sys_syslog(int type, char __user *buf, int len)
@@ -0,0 +1,114 @@
+/*
+ * printk() cost from interrupt context.
+ *
+ * Prints count lines of len characters at KERN_ERR, one per timer tick,
+ * from a timer callback with interrupts disabled, which is how a driver's
+ * interrupt handler reaches printk().  Each call is timed and the spread
+ * is reported when all are done.  Load it once with
+ * /sys/module/printk/parameters/async set to 0 and once with it set to 1
+ * to compare the synchronous console path with kconsoled.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/timer.h>
+#include <linux/hrtimer.h>
+#include <linux/completion.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+
+#include <asm/div64.h>
+
+#define BENCH_MAX_LEN	200
+
+static unsigned int count = 100;
+module_param(count, uint, 0444);
+MODULE_PARM_DESC(count, "number of lines to print");
+
+static unsigned int len = 100;
+module_param(len, uint, 0444);
+MODULE_PARM_DESC(len, "characters per line, at most 200");
+
+static struct timer_list bench_timer;
+static DECLARE_COMPLETION(bench_done);
+static char bench_line[BENCH_MAX_LEN + 1];
+static s64 *bench_ns;
+static unsigned int bench_n;
+
+static void bench_tick(unsigned long unused)
+{
+	unsigned long flags;
+	ktime_t t0;
+
+	local_irq_save(flags);
+	t0 = ktime_get();
+	printk(KERN_ERR "%s\n", bench_line);
+	bench_ns[bench_n++] = ktime_to_ns(ktime_sub(ktime_get(), t0));
+	local_irq_restore(flags);
+
+	if (bench_n < count)
+		mod_timer(&bench_timer, jiffies + 1);
+	else
+		complete(&bench_done);
+}
+
+static int cmp_s64(const void *a, const void *b)
+{
+	s64 x = *(const s64 *)a, y = *(const s64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static unsigned long ns_to_us(u64 ns)
+{
+	do_div(ns, 1000);
+	return ns;
+}
+
+static int __init printk_bench_init(void)
+{
+	unsigned long long total = 0;
+	unsigned int i;
+
+	if (!count || !len || len > BENCH_MAX_LEN)
+		return -EINVAL;
+	bench_ns = kmalloc(count * sizeof(*bench_ns), GFP_KERNEL);
+	if (!bench_ns)
+		return -ENOMEM;
+
+	memset(bench_line, '=', len);
+	bench_line[len] = '\0';
+	bench_n = 0;
+	setup_timer(&bench_timer, bench_tick, 0);
+	mod_timer(&bench_timer, jiffies + 1);
+	wait_for_completion(&bench_done);
+	del_timer_sync(&bench_timer);
+
+	for (i = 0; i < count; i++)
+		total += bench_ns[i];
+	sort(bench_ns, count, sizeof(*bench_ns), cmp_s64, NULL);
+	do_div(total, count);
+	printk(KERN_INFO "printk_bench: %u lines of %u chars, irqs off, us: "
+	       "min %lu median %lu avg %lu max %lu\n", count, len,
+	       ns_to_us(bench_ns[0]), ns_to_us(bench_ns[count / 2]),
+	       ns_to_us(total), ns_to_us(bench_ns[count - 1]));
+
+	kfree(bench_ns);
+	return 0;
+}
+
+static void __exit printk_bench_exit(void)
+{
+}
+
+module_init(printk_bench_init);
+module_exit(printk_bench_exit);
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("printk cost from interrupt context");
@@ -216,11 +216,11 @@ void tick_nohz_stop_sched_tick(void)
 	next_jiffies = get_next_timer_interrupt(last_jiffies);
 	delta_jiffies = next_jiffies - last_jiffies;
 
-	if (rcu_needs_cpu(cpu))
+	if (rcu_needs_cpu(cpu) || printk_needs_cpu(cpu))
 		delta_jiffies = 1;
 	/*
 	 * Do not stop the tick, if we are only one off
-	 * or if the cpu is required for rcu
+	 * or if the cpu is required for rcu or printk
 	 */
 	if (!ts->tick_stopped && delta_jiffies == 1)
 		goto out;
@@ -1,14 +1,21 @@
 #include <stdio.h>
+#include "../include/linux/autoconf.h"
 #include "crc32defs.h"
 #include <inttypes.h>
 
 #define ENTRIES_PER_LINE 4
 
-#define LE_TABLE_SIZE (1 << CRC_LE_BITS)
-#define BE_TABLE_SIZE (1 << CRC_BE_BITS)
+/*
+ * Up to 8 bits one table of 1 << bits entries, above that one
+ * 256 entry table per byte processed in parallel (slice-by-N).
+ */
+#define LE_TABLE_ROWS ((CRC_LE_BITS - 1) / 8 + 1)
+#define LE_TABLE_SIZE (1 << ((CRC_LE_BITS - 1) % 8 + 1))
+#define BE_TABLE_ROWS ((CRC_BE_BITS - 1) / 8 + 1)
+#define BE_TABLE_SIZE (1 << ((CRC_BE_BITS - 1) % 8 + 1))
 
-static uint32_t crc32table_le[LE_TABLE_SIZE];
-static uint32_t crc32table_be[BE_TABLE_SIZE];
+static uint32_t crc32table_le[LE_TABLE_ROWS][LE_TABLE_SIZE];
+static uint32_t crc32table_be[BE_TABLE_ROWS][BE_TABLE_SIZE];
 
 /**
  * crc32init_le() - allocate and initialize LE table data
@@ -16,18 +23,27 @@ static uint32_t crc32table_be[BE_TABLE_SIZE];
  * crc is the crc of the byte i; other entries are filled in based on the
  * fact that crctable[i^j] = crctable[i] ^ crctable[j].
  *
+ * Row n of a slice-by-N table is the crc of byte i followed by n zero
+ * bytes.
  */
 static void crc32init_le(void)
 {
 	unsigned i, j;
 	uint32_t crc = 1;
 
-	crc32table_le[0] = 0;
+	crc32table_le[0][0] = 0;
 
-	for (i = 1 << (CRC_LE_BITS - 1); i; i >>= 1) {
+	for (i = LE_TABLE_SIZE >> 1; i; i >>= 1) {
 		crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
 		for (j = 0; j < LE_TABLE_SIZE; j += 2 * i)
-			crc32table_le[i + j] = crc ^ crc32table_le[j];
+			crc32table_le[0][i + j] = crc ^ crc32table_le[0][j];
+	}
+	for (i = 0; i < LE_TABLE_SIZE; i++) {
+		crc = crc32table_le[0][i];
+		for (j = 1; j < LE_TABLE_ROWS; j++) {
+			crc = crc32table_le[0][crc & 0xff] ^ (crc >> 8);
+			crc32table_le[j][i] = crc;
+		}
 	}
 }
 
@@ -39,12 +55,19 @@ static void crc32init_be(void)
 	unsigned i, j;
 	uint32_t crc = 0x80000000;
 
-	crc32table_be[0] = 0;
+	crc32table_be[0][0] = 0;
 
 	for (i = 1; i < BE_TABLE_SIZE; i <<= 1) {
 		crc = (crc << 1) ^ ((crc & 0x80000000) ? CRCPOLY_BE : 0);
 		for (j = 0; j < i; j++)
-			crc32table_be[i + j] = crc ^ crc32table_be[j];
+			crc32table_be[0][i + j] = crc ^ crc32table_be[0][j];
+	}
+	for (i = 0; i < BE_TABLE_SIZE; i++) {
+		crc = crc32table_be[0][i];
+		for (j = 1; j < BE_TABLE_ROWS; j++) {
+			crc = crc32table_be[0][(crc >> 24) & 0xff] ^ (crc << 8);
+			crc32table_be[j][i] = crc;
+		}
 	}
 }
 
@@ -57,7 +80,18 @@ static void output_table(uint32_t table[], int len, char *trans)
 			printf("\n");
 		printf("%s(0x%8.8xL), ", trans, table[i]);
 	}
-	printf("%s(0x%8.8xL)\n", trans, table[len - 1]);
+	printf("%s(0x%8.8xL)", trans, table[len - 1]);
+}
+
+static void output_tables(uint32_t *table, int rows, int len, char *trans)
+{
+	int i;
+
+	for (i = 0; i < rows; i++) {
+		printf("{");
+		output_table(table + i * len, len, trans);
+		printf("}%s\n", i < rows - 1 ? "," : "");
+	}
 }
 
 int main(int argc, char** argv)
@@ -66,15 +100,21 @@ int main(int argc, char** argv)
 
 	if (CRC_LE_BITS > 1) {
 		crc32init_le();
-		printf("static const u32 crc32table_le[] = {");
-		output_table(crc32table_le, LE_TABLE_SIZE, "tole");
+		printf("static const u32 ____cacheline_aligned "
+		       "crc32table_le[%d][%d] = {",
+		       LE_TABLE_ROWS, LE_TABLE_SIZE);
+		output_tables(&crc32table_le[0][0], LE_TABLE_ROWS,
+			      LE_TABLE_SIZE, "tole");
 		printf("};\n");
 	}
 
 	if (CRC_BE_BITS > 1) {
 		crc32init_be();
-		printf("static const u32 crc32table_be[] = {");
-		output_table(crc32table_be, BE_TABLE_SIZE, "tobe");
+		printf("static const u32 ____cacheline_aligned "
+		       "crc32table_be[%d][%d] = {",
+		       BE_TABLE_ROWS, BE_TABLE_SIZE);
+		output_tables(&crc32table_be[0][0], BE_TABLE_ROWS,
+			      BE_TABLE_SIZE, "tobe");
 		printf("};\n");
 	}
 
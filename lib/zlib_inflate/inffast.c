@@ -4,6 +4,7 @@
  */
 
 #include <linux/zutil.h>
+#include <asm/unaligned.h>
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
@@ -29,6 +30,41 @@
 #  define PUP(a) *++(a)
 #endif
 
+/*
+   Copy len bytes of match data.  out and from are in PUP() form and the
+   updated out is returned.  When the source lies at least four bytes
+   behind the destination (or in the separate window buffer) each word
+   read only covers bytes that are already written, so the copy is done
+   a word at a time.  The words are usually unaligned; on PowerPC
+   get_unaligned()/put_unaligned() are plain loads and stores and the
+   440 handles the misalignment in hardware.  A distance of one is a
+   byte run, which is just a fill.
+ */
+static inline unsigned char *inflate_copy(unsigned char *out,
+                                          const unsigned char *from,
+                                          unsigned len)
+{
+    unsigned char *o = out + OFF;
+    const unsigned char *f = from + OFF;
+    unsigned long dist = (unsigned long)(o - f);
+
+    if (dist >= 4) {
+        while (len >= 4) {
+            put_unaligned(get_unaligned((const u32 *)f), (u32 *)o);
+            o += 4;
+            f += 4;
+            len -= 4;
+        }
+    }
+    else if (dist == 1) {
+        memset(o, *f, len);
+        return o + len - OFF;
+    }
+    while (len--)
+        *o++ = *f++;
+    return o - OFF;
+}
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -191,9 +227,7 @@ void inflate_fast(z_streamp strm, unsigned start)
                         from += wsize - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            out = inflate_copy(out, from, op);
                             from = out - dist;  /* rest from output */
                         }
                     }
@@ -202,16 +236,12 @@ void inflate_fast(z_streamp strm, unsigned start)
                         op -= write;
                         if (op < len) {         /* some from end of window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            out = inflate_copy(out, from, op);
                             from = window - OFF;
                             if (write < len) {  /* some from start of window */
                                 op = write;
                                 len -= op;
-                                do {
-                                    PUP(out) = PUP(from);
-                                } while (--op);
+                                out = inflate_copy(out, from, op);
                                 from = out - dist;      /* rest from output */
                             }
                         }
@@ -220,37 +250,15 @@ void inflate_fast(z_streamp strm, unsigned start)
                         from += write - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            out = inflate_copy(out, from, op);
                             from = out - dist;  /* rest from output */
                         }
                     }
-                    while (len > 2) {
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        len -= 3;
-                    }
-                    if (len) {
-                        PUP(out) = PUP(from);
-                        if (len > 1)
-                            PUP(out) = PUP(from);
-                    }
+                    out = inflate_copy(out, from, len);
                 }
                 else {
                     from = out - dist;          /* copy direct from output */
-                    do {                        /* minimum length is three */
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        len -= 3;
-                    } while (len > 2);
-                    if (len) {
-                        PUP(out) = PUP(from);
-                        if (len > 1)
-                            PUP(out) = PUP(from);
-                    }
+                    out = inflate_copy(out, from, len);
                 }
             }
             else if ((op & 64) == 0) {          /* 2nd level distance code */
@@ -307,6 +315,10 @@ void inflate_fast(z_streamp strm, unsigned start)
    - Swapping window/direct else
    - Larger unrolled copy loops (three is about right)
    - Moving len -= 3 statement into middle of loop
+
+   The byte copy loops were replaced by inflate_copy() above, which moves
+   a word at a time for all but the shortest distances; on a 440 that is
+   a clear win over three bytes per iteration.
  */
 
 #endif /* !ASMINF */
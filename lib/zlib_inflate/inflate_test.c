@@ -0,0 +1,348 @@
+/*
+ * Round-trip check and throughput of the kernel inflate code, in user
+ * space.
+ *
+ * Every input (the files given, or a built-in set of synthetic buffers
+ * with short, long and overlapping matches, runs and incompressible
+ * data) is compressed with gzip at levels 1, 6 and 9 and inflated again
+ * with zlib_inflate() from this directory, with the output handed out
+ * 300 bytes, 4 kB and all at once: small output chunks make
+ * inflate_fast() copy from the sliding window, large ones from the
+ * output itself.  The result must be identical to the input; otherwise
+ * the offset of the first difference is printed and the exit status is
+ * 1.  -n repeats each inflate to time it, and the output rate is
+ * printed for each chunk size.
+ *
+ * Build from the top of a configured tree (for include/asm) with
+ *	gcc -O2 -Wall -fno-strict-aliasing -Iinclude -Ilib/zlib_inflate \
+ *		-Du32=__UINT32_TYPE__ -o inflate_test \
+ *		lib/zlib_inflate/{inflate_test,inffast,inftrees,inflate}.c
+ * and run with gzip in $PATH.  To compare against another inffast.c,
+ * build a second binary with that one in its place.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <linux/zutil.h>
+
+static const unsigned int levels[] = { 1, 6, 9 };
+static const unsigned int chunks[] = { 300, 4096, 0 };
+#define NCHUNKS (sizeof(chunks) / sizeof(chunks[0]))
+
+static unsigned int reps = 1;		/* -n */
+static void *workspace;
+static int failed;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Run gzip -level on len bytes of in, return the compressed data */
+static unsigned char *gzip(const unsigned char *in, size_t len,
+			   unsigned int level, size_t *zlen)
+{
+	char name[] = "/tmp/inflate_test.XXXXXX", arg[4];
+	unsigned char *out = NULL;
+	size_t size = 0, n = 0;
+	ssize_t r;
+	int fd, pfd[2], status;
+	pid_t pid;
+
+	fd = mkstemp(name);
+	if (fd < 0 || write(fd, in, len) != (ssize_t)len ||
+	    lseek(fd, 0, SEEK_SET) || pipe(pfd)) {
+		perror(name);
+		exit(2);
+	}
+	unlink(name);
+	snprintf(arg, sizeof(arg), "-%u", level);
+
+	pid = fork();
+	if (!pid) {
+		dup2(fd, 0);
+		dup2(pfd[1], 1);
+		close(pfd[0]);
+		execlp("gzip", "gzip", "-c", "-n", arg, (char *)NULL);
+		perror("gzip");
+		_exit(127);
+	}
+	close(fd);
+	close(pfd[1]);
+	do {
+		if (n == size) {
+			size = size ? size * 2 : 65536;
+			out = realloc(out, size);
+			if (!out)
+				exit(2);
+		}
+		r = read(pfd[0], out + n, size - n);
+		if (r > 0)
+			n += r;
+	} while (r > 0);
+	close(pfd[0]);
+	waitpid(pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		fprintf(stderr, "gzip -%u failed\n", level);
+		exit(2);
+	}
+	*zlen = n;
+	return out;
+}
+
+/* Offset of the deflate data in a gzip member, or 0 if it is not one */
+static size_t gzip_header(const unsigned char *z, size_t zlen)
+{
+	size_t pos = 10;
+	unsigned char flags;
+
+	if (zlen < 18 || z[0] != 0x1f || z[1] != 0x8b || z[2] != 8)
+		return 0;
+	flags = z[3];
+	if (flags & 4)				/* FEXTRA */
+		pos += 2 + (z[10] | z[11] << 8);
+	if (flags & 8)				/* FNAME */
+		while (pos < zlen && z[pos++])
+			;
+	if (flags & 16)				/* FCOMMENT */
+		while (pos < zlen && z[pos++])
+			;
+	if (flags & 2)				/* FHCRC */
+		pos += 2;
+	return pos < zlen ? pos : 0;
+}
+
+/*
+ * Inflate the raw deflate data in z into out, handing out at most chunk
+ * bytes of output space per call (all of it for 0).  Returns the number
+ * of bytes produced, or -1 on a zlib error.
+ */
+static long inflate_raw(const unsigned char *z, size_t zlen,
+			unsigned char *out, size_t size, unsigned int chunk)
+{
+	z_stream strm;
+	int ret;
+
+	memset(&strm, 0, sizeof(strm));
+	strm.workspace = workspace;
+	strm.next_in = (unsigned char *)z;
+	strm.avail_in = zlen;
+	strm.next_out = out;
+	if (zlib_inflateInit2(&strm, -MAX_WBITS) != Z_OK)
+		return -1;
+	do {
+		strm.avail_out = size - strm.total_out;
+		if (chunk && strm.avail_out > chunk)
+			strm.avail_out = chunk;
+		ret = zlib_inflate(&strm, Z_SYNC_FLUSH);
+	} while (ret == Z_OK && strm.total_out < size);
+	zlib_inflateEnd(&strm);
+	if (ret != Z_STREAM_END && ret != Z_OK)
+		return -1;
+	return strm.total_out;
+}
+
+static void check(const char *name, const unsigned char *in, size_t len)
+{
+	unsigned char *z, *out;
+	size_t zlen, off, i;
+	unsigned int l, c, r;
+	double t, rate[NCHUNKS] = { 0 };
+	long got = -1;
+
+	/* one spare byte, so that output beyond len would show */
+	out = malloc(len + 1);
+	if (!out)
+		exit(2);
+
+	for (l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+		z = gzip(in, len, levels[l], &zlen);
+		off = gzip_header(z, zlen);
+		if (!off) {
+			fprintf(stderr, "%s: bad gzip header\n", name);
+			exit(2);
+		}
+		for (c = 0; c < NCHUNKS; c++) {
+			t = now();
+			for (r = 0; r < reps; r++)
+				got = inflate_raw(z + off, zlen - off, out,
+						  len + 1, chunks[c]);
+			t = now() - t;
+			rate[c] += len * reps / t / (1 << 20);
+
+			if (got == (long)len && !memcmp(in, out, len))
+				continue;
+			failed = 1;
+			for (i = 0; i < len && (long)i < got; i++)
+				if (in[i] != out[i])
+					break;
+			printf("%s: gzip -%u, %u byte chunks: FAILED, "
+			       "%ld of %zu bytes, first difference at %zu\n",
+			       name, levels[l], chunks[c], got, len, i);
+		}
+		free(z);
+	}
+	printf("%-24s %9zu", name, len);
+	for (c = 0; c < NCHUNKS; c++)
+		printf(" %9.1f", rate[c] / l);
+	printf("\n");
+	free(out);
+}
+
+/* Repeats of a period-byte pattern: matches at distance period */
+static void fill_period(unsigned char *p, size_t len, unsigned int period)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		p[i] = i < period ? 'a' + rand() % 26 : p[i - period];
+}
+
+/* Words from a small vocabulary: short matches at all distances */
+static void fill_text(unsigned char *p, size_t len)
+{
+	static const char *words[] = {
+		"the ", "laser ", "marking ", "job ", "vector ", "galvo ",
+		"power ", "speed ", "frequency ", "layer ", "of ", "and ",
+		"to ", "0.25 ", "100 ", "\n",
+	};
+	size_t i = 0, w;
+
+	while (i < len) {
+		const char *s = words[rand() % 16];
+
+		for (w = 0; s[w] && i < len; w++)
+			p[i++] = s[w];
+	}
+}
+
+/* Random bytes with runs and back-references up to 32 kB away */
+static void fill_mixed(unsigned char *p, size_t len)
+{
+	size_t i = 0, n, d;
+
+	while (i < len) {
+		n = 3 + rand() % 300;
+		if (n > len - i)
+			n = len - i;
+		switch (rand() % 4) {
+		case 0:
+			memset(p + i, rand(), n);
+			break;
+		case 1:
+			d = 1 + rand() % 32768;
+			if (d <= i) {
+				while (n--) {
+					p[i] = p[i - d];
+					i++;
+				}
+				continue;
+			}
+			/* fall through */
+		default:
+			for (d = 0; d < n; d++)
+				p[i + d] = rand();
+			break;
+		}
+		i += n;
+	}
+}
+
+static void builtin(void)
+{
+	static const unsigned int periods[] = { 1, 2, 3, 4, 5, 7, 258 };
+	size_t len = 1 << 20;
+	unsigned char *p = malloc(len);
+	char name[32];
+	unsigned int i;
+
+	if (!p)
+		exit(2);
+	srand(1);
+	for (i = 0; i < sizeof(periods) / sizeof(periods[0]); i++) {
+		fill_period(p, len, periods[i]);
+		snprintf(name, sizeof(name), "period %u", periods[i]);
+		check(name, p, len);
+	}
+	fill_text(p, len);
+	check("text", p, len);
+	fill_mixed(p, len);
+	check("mixed", p, len);
+	for (i = 0; i < len; i++)
+		p[i] = rand();
+	check("random", p, len);
+	fill_text(p, 1000);
+	check("text, 1000 bytes", p, 1000);
+	free(p);
+}
+
+static void file(const char *name)
+{
+	struct stat st;
+	unsigned char *p;
+	int fd;
+
+	fd = open(name, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st)) {
+		perror(name);
+		exit(2);
+	}
+	p = malloc(st.st_size + 1);
+	if (!p || read(fd, p, st.st_size) != st.st_size) {
+		perror(name);
+		exit(2);
+	}
+	close(fd);
+	check(name, p, st.st_size);
+	free(p);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int c;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt) {
+		case 'n':
+			reps = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: inflate_test [-n reps] "
+				"[file...]\n");
+			return 2;
+		}
+	}
+	if (!reps)
+		reps = 1;
+	workspace = malloc(zlib_inflate_workspacesize());
+	if (!workspace)
+		return 2;
+
+	printf("%-24s %9s", "input", "bytes");
+	for (c = 0; c < NCHUNKS; c++)
+		if (chunks[c])
+			printf(" %7u B", chunks[c]);
+		else
+			printf(" %9s", "all");
+	printf("   MB/s out\n");
+
+	if (optind == argc)
+		builtin();
+	for (; optind < argc; optind++)
+		file(argv[optind]);
+
+	printf(failed ? "FAILED\n" : "all identical\n");
+	return failed;
+}
@@ -0,0 +1,155 @@
+/*
+ *  linux/mm/mem_notify.c
+ *
+ *  Memory pressure notification for user space.
+ *
+ *  A process that keeps caches of its own (decoded fonts, rendered
+ *  vectors, ...) can poll /dev/mem_notify and give memory back before
+ *  the page allocator has to stall it in direct reclaim or call the OOM
+ *  killer.  The device becomes readable whenever the pressure level
+ *  changed since the file was last read; read() returns the current
+ *  level as text, e.g. "2 medium\n".
+ *
+ *  The level is raised from the reclaim paths in mm/vmscan.c:
+ *	LOW	 an allocation found a zone under its low watermark and
+ *		 woke kswapd
+ *	MEDIUM	 kswapd needed several passes and started throttling
+ *	CRITICAL an allocation entered direct reclaim
+ *  and recomputed from the zone watermarks whenever kswapd has finished
+ *  balancing, which is the only point where it goes down again.  Only
+ *  changes wake up pollers, so a system that sits between the low and
+ *  high watermarks does not keep the application busy.
+ */
+
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/vmstat.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/miscdevice.h>
+#include <linux/mem_notify.h>
+#include <asm/atomic.h>
+#include <asm/uaccess.h>
+
+static DECLARE_WAIT_QUEUE_HEAD(mem_notify_wait);
+static DEFINE_SPINLOCK(mem_notify_lock);
+static int mem_notify_level;
+static atomic_t mem_notify_seq = ATOMIC_INIT(0);
+
+static const char *mem_notify_names[] = {
+	[MEM_PRESSURE_NONE]	= "none",
+	[MEM_PRESSURE_LOW]	= "low",
+	[MEM_PRESSURE_MEDIUM]	= "medium",
+	[MEM_PRESSURE_CRITICAL]	= "critical",
+};
+
+static void mem_notify_set(int level, int lower)
+{
+	unsigned long flags;
+	int changed = 0;
+
+	spin_lock_irqsave(&mem_notify_lock, flags);
+	if (level > mem_notify_level || (lower && level < mem_notify_level)) {
+		mem_notify_level = level;
+		atomic_inc(&mem_notify_seq);
+		changed = 1;
+	}
+	spin_unlock_irqrestore(&mem_notify_lock, flags);
+
+	if (changed && waitqueue_active(&mem_notify_wait))
+		wake_up_interruptible(&mem_notify_wait);
+}
+
+/*
+ * Called from the reclaim paths; only ever raises the level.
+ */
+void mem_notify_raise(int level)
+{
+	if (level > mem_notify_level)
+		mem_notify_set(level, 0);
+}
+
+/*
+ * Work out the level from the zone watermarks alone.  Called by kswapd
+ * when it goes back to sleep, which normally drops the level to NONE.
+ */
+void mem_notify_recalc(void)
+{
+	struct zone *zone;
+	int level = MEM_PRESSURE_NONE;
+
+	for_each_zone(zone) {
+		unsigned long free;
+
+		if (!populated_zone(zone))
+			continue;
+		free = zone_page_state(zone, NR_FREE_PAGES);
+		if (free <= zone->pages_min) {
+			level = MEM_PRESSURE_CRITICAL;
+			break;
+		}
+		if (free <= (zone->pages_min + zone->pages_low) / 2)
+			level = max(level, MEM_PRESSURE_MEDIUM);
+		else if (free <= zone->pages_low)
+			level = max(level, MEM_PRESSURE_LOW);
+	}
+	mem_notify_set(level, 1);
+}
+
+/*
+ * file->private_data holds the sequence number the reader has seen.
+ * Start one behind so that the first poll() reports the current level.
+ */
+static int mem_notify_open(struct inode *inode, struct file *file)
+{
+	file->private_data = (void *)(long)(atomic_read(&mem_notify_seq) - 1);
+	return 0;
+}
+
+static ssize_t mem_notify_read(struct file *file, char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	char tmp[16];
+	int level, seq, len;
+
+	seq = atomic_read(&mem_notify_seq);
+	smp_rmb();
+	level = mem_notify_level;
+	len = sprintf(tmp, "%d %s\n", level, mem_notify_names[level]);
+	if (count < len)
+		return -EINVAL;
+	if (copy_to_user(buf, tmp, len))
+		return -EFAULT;
+	file->private_data = (void *)(long)seq;
+	return len;
+}
+
+static unsigned int mem_notify_poll(struct file *file, poll_table *wait)
+{
+	poll_wait(file, &mem_notify_wait, wait);
+	if ((long)file->private_data != atomic_read(&mem_notify_seq))
+		return POLLIN | POLLRDNORM;
+	return 0;
+}
+
+static const struct file_operations mem_notify_fops = {
+	.owner		= THIS_MODULE,
+	.open		= mem_notify_open,
+	.read		= mem_notify_read,
+	.poll		= mem_notify_poll,
+};
+
+static struct miscdevice mem_notify_device = {
+	.minor		= MISC_DYNAMIC_MINOR,
+	.name		= "mem_notify",
+	.fops		= &mem_notify_fops,
+};
+
+static int __init mem_notify_init(void)
+{
+	return misc_register(&mem_notify_device);
+}
+__initcall(mem_notify_init);
@@ -437,18 +437,21 @@ EXPORT_SYMBOL(__skb_checksum_complete);
  *	@hlen: hardware length
  *	@iov: io vector
  *
- *	Caller _must_ check that skb will fit to this iovec.
+ *	Caller _must_ check that skb will fit to this iovec.  The data
+ *	may span several iovec elements; it is checksummed as it is copied.
  *
  *	Returns: 0       - success.
- *		 -EINVAL - checksum failure.
+ *		 -EINVAL - checksum failure, iovec is left untouched.
  *		 -EFAULT - fault during copy. Beware, in this case iovec
  *			   can be modified!
  */
 int skb_copy_and_csum_datagram_iovec(struct sk_buff *skb,
 				     int hlen, struct iovec *iov)
 {
+	struct iovec *start;
 	__wsum csum;
 	int chunk = skb->len - hlen;
+	int pos = 0;
 
 	if (!chunk)
 		return 0;
@@ -459,22 +462,40 @@ int skb_copy_and_csum_datagram_iovec(struct sk_buff *skb,
 	while (!iov->iov_len)
 		iov++;
 
-	if (iov->iov_len < chunk) {
-		if (__skb_checksum_complete(skb))
-			goto csum_error;
-		if (skb_copy_datagram_iovec(skb, hlen, iov, chunk))
-			goto fault;
-	} else {
-		csum = csum_partial(skb->data, hlen, skb->csum);
-		if (skb_copy_and_csum_datagram(skb, hlen, iov->iov_base,
-					       chunk, &csum))
+	csum = csum_partial(skb->data, hlen, skb->csum);
+
+	/* Checksum while copying even when the data spans several iovec
+	 * elements; without checksum offload a separate verification pass
+	 * over the payload costs as much as the copy itself.
+	 */
+	start = iov;
+	while (chunk > 0) {
+		__wsum csum2 = 0;
+		int copy = min_t(int, chunk, iov->iov_len);
+
+		if (skb_copy_and_csum_datagram(skb, hlen + pos, iov->iov_base,
+					       copy, &csum2))
 			goto fault;
-		if (csum_fold(csum))
-			goto csum_error;
-		if (unlikely(skb->ip_summed == CHECKSUM_COMPLETE))
-			netdev_rx_csum_fault(skb->dev);
-		iov->iov_len -= chunk;
-		iov->iov_base += chunk;
+		/* csum covers the hlen header bytes too, so the byte
+		 * parity of this block is relative to skb->data
+		 */
+		csum = csum_block_add(csum, csum2, hlen + pos);
+		pos += copy;
+		chunk -= copy;
+		iov++;
+	}
+	if (csum_fold(csum))
+		goto csum_error;
+	if (unlikely(skb->ip_summed == CHECKSUM_COMPLETE))
+		netdev_rx_csum_fault(skb->dev);
+
+	/* Only consume the iovec once the data is known to be good. */
+	for (iov = start; pos > 0; iov++) {
+		int copy = min_t(int, pos, iov->iov_len);
+
+		iov->iov_len -= copy;
+		iov->iov_base += copy;
+		pos -= copy;
 	}
 	return 0;
 csum_error:
@@ -1270,6 +1270,9 @@ static int __init ip_auto_config(void)
 	if (!ic_enable)
 		return 0;
 
+	/* The network drivers may still be probing */
+	async_synchronize_initcalls();
+
 	DBG(("IP-Config: Entered.\n"));
 #ifdef IPCONFIG_DYNAMIC
  try_try_again:
@@ -162,7 +162,22 @@ struct packet_mreq_max
 };
 
 #ifdef CONFIG_PACKET_MMAP
-static int packet_set_ring(struct sock *sk, struct tpacket_req *req, int closing);
+static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
+			   int closing, int tx_ring);
+
+struct packet_ring_buffer {
+	char *			*pg_vec;
+	unsigned int		head;
+	unsigned int		frames_per_block;
+	unsigned int		frame_size;
+	unsigned int		frame_max;
+
+	unsigned int		pg_vec_order;
+	unsigned int		pg_vec_pages;
+	unsigned int		pg_vec_len;
+
+	atomic_t		pending;	/* tx frames owned by the stack */
+};
 #endif
 
 static void packet_flush_mclist(struct sock *sk);
@@ -172,11 +187,8 @@ struct packet_sock {
 	struct sock		sk;
 	struct tpacket_stats	stats;
 #ifdef CONFIG_PACKET_MMAP
-	char *			*pg_vec;
-	unsigned int		head;
-	unsigned int            frames_per_block;
-	unsigned int		frame_size;
-	unsigned int		frame_max;
+	struct packet_ring_buffer	rx_ring;
+	struct packet_ring_buffer	tx_ring;
 	int			copy_thresh;
 #endif
 	struct packet_type	prot_hook;
@@ -189,9 +201,6 @@ struct packet_sock {
 	struct packet_mclist	*mclist;
 #ifdef CONFIG_PACKET_MMAP
 	atomic_t		mapped;
-	unsigned int            pg_vec_order;
-	unsigned int		pg_vec_pages;
-	unsigned int		pg_vec_len;
 #endif
 };
 
@@ -207,14 +216,19 @@ struct packet_skb_cb {
 
 #ifdef CONFIG_PACKET_MMAP
 
-static inline struct tpacket_hdr *packet_lookup_frame(struct packet_sock *po, unsigned int position)
+static inline struct tpacket_hdr *packet_lookup_frame(struct packet_ring_buffer *rb, unsigned int position)
 {
 	unsigned int pg_vec_pos, frame_offset;
 
-	pg_vec_pos = position / po->frames_per_block;
-	frame_offset = position % po->frames_per_block;
+	pg_vec_pos = position / rb->frames_per_block;
+	frame_offset = position % rb->frames_per_block;
 
-	return (struct tpacket_hdr *)(po->pg_vec[pg_vec_pos] + (frame_offset * po->frame_size));
+	return (struct tpacket_hdr *)(rb->pg_vec[pg_vec_pos] + (frame_offset * rb->frame_size));
+}
+
+static inline void packet_increment_head(struct packet_ring_buffer *rb)
+{
+	rb->head = rb->head != rb->frame_max ? rb->head+1 : 0;
 }
 #endif
 
@@ -603,7 +617,7 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev, struct packe
 		macoff = netoff - maclen;
 	}
 
-	if (macoff + snaplen > po->frame_size) {
+	if (macoff + snaplen > po->rx_ring.frame_size) {
 		if (po->copy_thresh &&
 		    atomic_read(&sk->sk_rmem_alloc) + skb->truesize <
 		    (unsigned)sk->sk_rcvbuf) {
@@ -616,17 +630,17 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev, struct packe
 			if (copy_skb)
 				skb_set_owner_r(copy_skb, sk);
 		}
-		snaplen = po->frame_size - macoff;
+		snaplen = po->rx_ring.frame_size - macoff;
 		if ((int)snaplen < 0)
 			snaplen = 0;
 	}
 
 	spin_lock(&sk->sk_receive_queue.lock);
-	h = packet_lookup_frame(po, po->head);
+	h = packet_lookup_frame(&po->rx_ring, po->rx_ring.head);
 
 	if (h->tp_status)
 		goto ring_is_full;
-	po->head = po->head != po->frame_max ? po->head+1 : 0;
+	packet_increment_head(&po->rx_ring);
 	po->stats.tp_packets++;
 	if (copy_skb) {
 		status |= TP_STATUS_COPY;
@@ -696,10 +710,199 @@ ring_is_full:
 	goto drop_n_restore;
 }
 
-#endif
+/*
+ * PACKET_TX_RING: user space fills frames in the mmapped ring, marks
+ * them TP_STATUS_SEND_REQUEST and calls send().  Every pending frame is
+ * turned into an skb whose payload points straight at the ring pages;
+ * the frame stays TP_STATUS_SENDING until the driver frees the skb and
+ * is then handed back as TP_STATUS_AVAILABLE.  A frame that can't be
+ * sent is marked TP_STATUS_WRONG_FORMAT and stops the batch.
+ */
+static inline int __packet_get_status(struct tpacket_hdr *h)
+{
+	smp_rmb();
+	flush_dcache_page(virt_to_page(&h->tp_status));
+	return h->tp_status;
+}
+
+static inline void __packet_set_status(struct tpacket_hdr *h, int status)
+{
+	h->tp_status = status;
+	flush_dcache_page(virt_to_page(&h->tp_status));
+	smp_wmb();
+}
+
+static void tpacket_destruct_skb(struct sk_buff *skb)
+{
+	struct packet_sock *po = pkt_sk(skb->sk);
+	struct tpacket_hdr *h = skb_shinfo(skb)->destructor_arg;
 
+	if (likely(po->tx_ring.pg_vec)) {
+		BUG_ON(atomic_read(&po->tx_ring.pending) == 0);
+		atomic_dec(&po->tx_ring.pending);
+		__packet_set_status(h, TP_STATUS_AVAILABLE);
+	}
 
-static int packet_sendmsg(struct kiocb *iocb, struct socket *sock,
+	sock_wfree(skb);
+}
+
+static int tpacket_fill_skb(struct packet_sock *po, struct sk_buff *skb,
+			    struct tpacket_hdr *h, struct net_device *dev,
+			    int size_max, __be16 proto, unsigned char *addr)
+{
+	struct sock *sk = &po->sk;
+	unsigned char *data;
+	int to_write, len, tp_len;
+
+	tp_len = h->tp_len;
+	if (unlikely(tp_len > size_max))
+		return -EMSGSIZE;
+
+	skb->protocol = proto;
+	skb->dev = dev;
+	skb->priority = sk->sk_priority;
+	skb_shinfo(skb)->destructor_arg = h;
+
+	skb_reserve(skb, LL_RESERVED_SPACE(dev));
+	skb_reset_network_header(skb);
+
+	data = (unsigned char *)h + TPACKET_HDRLEN - sizeof(struct sockaddr_ll);
+	to_write = tp_len;
+
+	if (sk->sk_type == SOCK_DGRAM) {
+		if (dev_hard_header(skb, dev, ntohs(proto), addr, NULL,
+				    tp_len) < 0)
+			return -EINVAL;
+	} else if (dev->hard_header_len) {
+		/* the link level header goes into the linear part */
+		if (unlikely(tp_len <= dev->hard_header_len))
+			return -EINVAL;
+		memcpy(skb_push(skb, dev->hard_header_len), data,
+		       dev->hard_header_len);
+		data += dev->hard_header_len;
+		to_write -= dev->hard_header_len;
+	}
+
+	skb->data_len = to_write;
+	skb->len += to_write;
+	skb->truesize += to_write;
+	atomic_add(to_write, &sk->sk_wmem_alloc);
+
+	while (to_write) {
+		struct page *page = virt_to_page(data);
+		int offset = offset_in_page(data);
+		int nr_frags = skb_shinfo(skb)->nr_frags;
+
+		if (unlikely(nr_frags >= MAX_SKB_FRAGS))
+			return -EMSGSIZE;
+
+		len = min_t(int, to_write, PAGE_SIZE - offset);
+		flush_dcache_page(page);
+		get_page(page);
+		skb_fill_page_desc(skb, nr_frags, page, offset, len);
+		data += len;
+		to_write -= len;
+	}
+
+	return tp_len;
+}
+
+static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
+{
+	struct sock *sk = &po->sk;
+	struct sockaddr_ll *saddr = (struct sockaddr_ll *)msg->msg_name;
+	struct sk_buff *skb;
+	struct net_device *dev;
+	struct tpacket_hdr *h;
+	__be16 proto;
+	unsigned char *addr;
+	int ifindex, err, reserve = 0;
+	int tp_len, size_max, len_sum = 0;
+
+	lock_sock(sk);
+
+	err = -EBUSY;
+	if (unlikely(!po->tx_ring.pg_vec))
+		goto out;
+
+	if (saddr == NULL) {
+		ifindex	= po->ifindex;
+		proto	= po->num;
+		addr	= NULL;
+	} else {
+		err = -EINVAL;
+		if (msg->msg_namelen < sizeof(struct sockaddr_ll))
+			goto out;
+		if (msg->msg_namelen < (saddr->sll_halen + offsetof(struct sockaddr_ll, sll_addr)))
+			goto out;
+		ifindex	= saddr->sll_ifindex;
+		proto	= saddr->sll_protocol;
+		addr	= saddr->sll_addr;
+	}
+
+	dev = dev_get_by_index(&init_net, ifindex);
+	err = -ENXIO;
+	if (unlikely(dev == NULL))
+		goto out;
+	if (sk->sk_type == SOCK_RAW)
+		reserve = dev->hard_header_len;
+
+	err = -ENETDOWN;
+	if (unlikely(!(dev->flags & IFF_UP)))
+		goto out_put;
+
+	size_max = po->tx_ring.frame_size -
+		   (TPACKET_HDRLEN - sizeof(struct sockaddr_ll));
+	if (size_max > dev->mtu + reserve)
+		size_max = dev->mtu + reserve;
+
+	for (;;) {
+		h = packet_lookup_frame(&po->tx_ring, po->tx_ring.head);
+		if (__packet_get_status(h) != TP_STATUS_SEND_REQUEST)
+			break;
+
+		skb = sock_alloc_send_skb(sk, LL_RESERVED_SPACE(dev),
+					  msg->msg_flags & MSG_DONTWAIT, &err);
+		if (unlikely(skb == NULL))
+			goto out_sum;
+
+		tp_len = tpacket_fill_skb(po, skb, h, dev, size_max, proto, addr);
+		if (unlikely(tp_len < 0)) {
+			kfree_skb(skb);
+			__packet_set_status(h, TP_STATUS_WRONG_FORMAT);
+			err = tp_len;
+			goto out_sum;
+		}
+
+		skb->destructor = tpacket_destruct_skb;
+		__packet_set_status(h, TP_STATUS_SENDING);
+		atomic_inc(&po->tx_ring.pending);
+		packet_increment_head(&po->tx_ring);
+
+		/*
+		 * The skb is consumed either way; a dropped frame still goes
+		 * back to the ring through the destructor.
+		 */
+		err = dev_queue_xmit(skb);
+		if (err > 0 && (err = net_xmit_errno(err)) != 0)
+			goto out_sum;
+		len_sum += tp_len;
+	}
+	err = 0;
+
+out_sum:
+	/* report what went out; the error is only seen if nothing did */
+	if (len_sum)
+		err = len_sum;
+out_put:
+	dev_put(dev);
+out:
+	release_sock(sk);
+	return err;
+}
+#endif
+
+static int packet_snd(struct socket *sock,
 			  struct msghdr *msg, size_t len)
 {
 	struct sock *sk = sock->sk;
@@ -790,6 +993,18 @@ out:
 	return err;
 }
 
+static int packet_sendmsg(struct kiocb *iocb, struct socket *sock,
+		struct msghdr *msg, size_t len)
+{
+#ifdef CONFIG_PACKET_MMAP
+	struct packet_sock *po = pkt_sk(sock->sk);
+
+	if (po->tx_ring.pg_vec)
+		return tpacket_snd(po, msg);
+#endif
+	return packet_snd(sock, msg, len);
+}
+
 /*
  *	Close a PACKET socket. This is fairly simple. We immediately go
  *	to 'closed' state and remove our protocol entry in the device list.
@@ -826,10 +1041,15 @@ static int packet_release(struct socket *sock)
 	packet_flush_mclist(sk);
 
 #ifdef CONFIG_PACKET_MMAP
-	if (po->pg_vec) {
+	{
 		struct tpacket_req req;
 		memset(&req, 0, sizeof(req));
-		packet_set_ring(sk, &req, 1);
+
+		if (po->rx_ring.pg_vec)
+			packet_set_ring(sk, &req, 1, 0);
+
+		if (po->tx_ring.pg_vec)
+			packet_set_ring(sk, &req, 1, 1);
 	}
 #endif
 
@@ -1342,6 +1562,7 @@ packet_setsockopt(struct socket *sock, int level, int optname, char __user *optv
 
 #ifdef CONFIG_PACKET_MMAP
 	case PACKET_RX_RING:
+	case PACKET_TX_RING:
 	{
 		struct tpacket_req req;
 
@@ -1349,7 +1570,7 @@ packet_setsockopt(struct socket *sock, int level, int optname, char __user *optv
 			return -EINVAL;
 		if (copy_from_user(&req,optval,sizeof(req)))
 			return -EFAULT;
-		return packet_set_ring(sk, &req, 0);
+		return packet_set_ring(sk, &req, 0, optname == PACKET_TX_RING);
 	}
 	case PACKET_COPY_THRESH:
 	{
@@ -1568,17 +1789,26 @@ static unsigned int packet_poll(struct file * file, struct socket *sock,
 	struct packet_sock *po = pkt_sk(sk);
 	unsigned int mask = datagram_poll(file, sock, wait);
 
+	struct tpacket_hdr *h;
+
 	spin_lock_bh(&sk->sk_receive_queue.lock);
-	if (po->pg_vec) {
-		unsigned last = po->head ? po->head-1 : po->frame_max;
-		struct tpacket_hdr *h;
+	if (po->rx_ring.pg_vec) {
+		unsigned last = po->rx_ring.head ? po->rx_ring.head-1 : po->rx_ring.frame_max;
 
-		h = packet_lookup_frame(po, last);
+		h = packet_lookup_frame(&po->rx_ring, last);
 
 		if (h->tp_status)
 			mask |= POLLIN | POLLRDNORM;
 	}
 	spin_unlock_bh(&sk->sk_receive_queue.lock);
+	spin_lock_bh(&sk->sk_write_queue.lock);
+	if (po->tx_ring.pg_vec) {
+		h = packet_lookup_frame(&po->tx_ring, po->tx_ring.head);
+
+		if (__packet_get_status(h) == TP_STATUS_AVAILABLE)
+			mask |= POLLOUT | POLLWRNORM;
+	}
+	spin_unlock_bh(&sk->sk_write_queue.lock);
 	return mask;
 }
 
@@ -1654,20 +1884,26 @@ out_free_pgvec:
 	goto out;
 }
 
-static int packet_set_ring(struct sock *sk, struct tpacket_req *req, int closing)
+static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
+			   int closing, int tx_ring)
 {
 	char **pg_vec = NULL;
 	struct packet_sock *po = pkt_sk(sk);
+	struct packet_ring_buffer *rb;
+	struct sk_buff_head *rb_queue;
 	int was_running, order = 0;
 	__be16 num;
 	int err = 0;
 
+	rb = tx_ring ? &po->tx_ring : &po->rx_ring;
+	rb_queue = tx_ring ? &sk->sk_write_queue : &sk->sk_receive_queue;
+
 	if (req->tp_block_nr) {
 		int i, l;
 
 		/* Sanity tests and some calculations */
 
-		if (unlikely(po->pg_vec))
+		if (unlikely(rb->pg_vec))
 			return -EBUSY;
 
 		if (unlikely((int)req->tp_block_size <= 0))
@@ -1679,10 +1915,10 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req, int closing
 		if (unlikely(req->tp_frame_size & (TPACKET_ALIGNMENT - 1)))
 			return -EINVAL;
 
-		po->frames_per_block = req->tp_block_size/req->tp_frame_size;
-		if (unlikely(po->frames_per_block <= 0))
+		rb->frames_per_block = req->tp_block_size/req->tp_frame_size;
+		if (unlikely(rb->frames_per_block <= 0))
 			return -EINVAL;
-		if (unlikely((po->frames_per_block * req->tp_block_nr) !=
+		if (unlikely((rb->frames_per_block * req->tp_block_nr) !=
 			     req->tp_frame_nr))
 			return -EINVAL;
 
@@ -1698,9 +1934,10 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req, int closing
 			struct tpacket_hdr *header;
 			int k;
 
-			for (k = 0; k < po->frames_per_block; k++) {
+			for (k = 0; k < rb->frames_per_block; k++) {
 				header = (struct tpacket_hdr *) ptr;
-				header->tp_status = TP_STATUS_KERNEL;
+				header->tp_status = tx_ring ? TP_STATUS_AVAILABLE :
+							      TP_STATUS_KERNEL;
 				ptr += req->tp_frame_size;
 			}
 		}
@@ -1712,6 +1949,14 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req, int closing
 
 	lock_sock(sk);
 
+	/* Frames still queued to a device point into the old ring.  With
+	 * the socket locked tpacket_snd() can't add any, so the count can
+	 * only drop after this check.
+	 */
+	err = -EBUSY;
+	if (!closing && atomic_read(&rb->pending))
+		goto out_unlock;
+
 	/* Detach socket from network */
 	spin_lock(&po->bind_lock);
 	was_running = po->running;
@@ -1731,19 +1976,19 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req, int closing
 		err = 0;
 #define XC(a, b) ({ __typeof__ ((a)) __t; __t = (a); (a) = (b); __t; })
 
-		spin_lock_bh(&sk->sk_receive_queue.lock);
-		pg_vec = XC(po->pg_vec, pg_vec);
-		po->frame_max = (req->tp_frame_nr - 1);
-		po->head = 0;
-		po->frame_size = req->tp_frame_size;
-		spin_unlock_bh(&sk->sk_receive_queue.lock);
+		spin_lock_bh(&rb_queue->lock);
+		pg_vec = XC(rb->pg_vec, pg_vec);
+		rb->frame_max = (req->tp_frame_nr - 1);
+		rb->head = 0;
+		rb->frame_size = req->tp_frame_size;
+		spin_unlock_bh(&rb_queue->lock);
 
-		order = XC(po->pg_vec_order, order);
-		req->tp_block_nr = XC(po->pg_vec_len, req->tp_block_nr);
+		order = XC(rb->pg_vec_order, order);
+		req->tp_block_nr = XC(rb->pg_vec_len, req->tp_block_nr);
 
-		po->pg_vec_pages = req->tp_block_size/PAGE_SIZE;
-		po->prot_hook.func = po->pg_vec ? tpacket_rcv : packet_rcv;
-		skb_queue_purge(&sk->sk_receive_queue);
+		rb->pg_vec_pages = req->tp_block_size/PAGE_SIZE;
+		po->prot_hook.func = po->rx_ring.pg_vec ? tpacket_rcv : packet_rcv;
+		skb_queue_purge(rb_queue);
 #undef XC
 		if (atomic_read(&po->mapped))
 			printk(KERN_DEBUG "packet_mmap: vma is busy: %d\n", atomic_read(&po->mapped));
@@ -1758,6 +2003,7 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req, int closing
 	}
 	spin_unlock(&po->bind_lock);
 
+out_unlock:
 	release_sock(sk);
 
 	if (pg_vec)
@@ -1770,7 +2016,8 @@ static int packet_mmap(struct file *file, struct socket *sock, struct vm_area_st
 {
 	struct sock *sk = sock->sk;
 	struct packet_sock *po = pkt_sk(sk);
-	unsigned long size;
+	struct packet_ring_buffer *rb;
+	unsigned long size, expected_size;
 	unsigned long start;
 	int err = -EINVAL;
 	int i;
@@ -1780,22 +2027,35 @@ static int packet_mmap(struct file *file, struct socket *sock, struct vm_area_st
 
 	size = vma->vm_end - vma->vm_start;
 
+	/* the rx ring, if any, is mapped first, the tx ring right after it */
 	lock_sock(sk);
-	if (po->pg_vec == NULL)
+	expected_size = 0;
+	for (rb = &po->rx_ring; rb <= &po->tx_ring; rb++) {
+		if (rb->pg_vec)
+			expected_size += rb->pg_vec_len * rb->pg_vec_pages *
+					 PAGE_SIZE;
+	}
+	if (expected_size == 0)
 		goto out;
-	if (size != po->pg_vec_len*po->pg_vec_pages*PAGE_SIZE)
+	if (size != expected_size)
 		goto out;
 
 	start = vma->vm_start;
-	for (i = 0; i < po->pg_vec_len; i++) {
-		struct page *page = virt_to_page(po->pg_vec[i]);
-		int pg_num;
-
-		for (pg_num = 0; pg_num < po->pg_vec_pages; pg_num++, page++) {
-			err = vm_insert_page(vma, start, page);
-			if (unlikely(err))
-				goto out;
-			start += PAGE_SIZE;
+	for (rb = &po->rx_ring; rb <= &po->tx_ring; rb++) {
+		if (rb->pg_vec == NULL)
+			continue;
+
+		for (i = 0; i < rb->pg_vec_len; i++) {
+			struct page *page = virt_to_page(rb->pg_vec[i]);
+			int pg_num;
+
+			for (pg_num = 0; pg_num < rb->pg_vec_pages;
+			     pg_num++, page++) {
+				err = vm_insert_page(vma, start, page);
+				if (unlikely(err))
+					goto out;
+				start += PAGE_SIZE;
+			}
 		}
 	}
 	atomic_inc(&po->mapped);